@@ -50,6 +50,9 @@ class Sidebar : Gitg.Sidebar
 		Gitg.StageStatusItem d_item;
 		Type d_type;
 
+		internal weak Directory? parent;
+		internal string key;
+
 		public Item(Gitg.StageStatusItem item, Type type)
 		{
 			d_item = item;
@@ -63,7 +66,7 @@ class Sidebar : Gitg.Sidebar
 
 		public string text
 		{
-			owned get { return d_item.path; }
+			owned get { return Path.get_basename(d_item.path); }
 		}
 
 		public Type stage_type
@@ -77,8 +80,81 @@ class Sidebar : Gitg.Sidebar
 		}
 	}
 
+	/*
+	 * A directory grouping the items of a section. The rows of its children
+	 * are only created once the directory is expanded.
+	 */
+	public class Directory : Object, Gitg.SidebarItem
+	{
+		private string d_path;
+		private Item.Type d_type;
+
+		internal weak Directory? parent;
+		internal string key;
+		internal Gee.TreeMap<string, Directory> directories;
+		internal Gee.TreeMap<string, Item> files;
+		internal int count;
+		internal bool populated;
+
+		public Directory(string path, Item.Type type)
+		{
+			d_path = path;
+			d_type = type;
+
+			directories = new Gee.TreeMap<string, Directory>();
+			files = new Gee.TreeMap<string, Item>();
+		}
+
+		public string path
+		{
+			get { return d_path; }
+		}
+
+		public string text
+		{
+			owned get { return Path.get_basename(d_path) + "/"; }
+		}
+
+		public Item.Type stage_type
+		{
+			get { return d_type; }
+		}
+
+		public string? icon_name
+		{
+			owned get { return "folder-symbolic"; }
+		}
+
+		public void collect(ref Item[] items)
+		{
+			foreach (var directory in directories.values)
+			{
+				directory.collect(ref items);
+			}
+
+			foreach (var file in files.values)
+			{
+				items += file;
+			}
+		}
+	}
+
+	private class Section
+	{
+		public Gitg.SidebarStore.SidebarHeader header;
+		public Directory root;
+		public string empty_text;
+	}
+
+	// Sections with at most this many items have all directories expanded
+	private const int EXPAND_THRESHOLD = 200;
+
+	private Gee.HashMap<uint, Section> d_sections;
+
 	construct
 	{
+		d_sections = new Gee.HashMap<uint, Section>();
+
 		unowned Gtk.BindingSet binding_set = Gtk.BindingSet.by_class(get_class());
 
 		Gtk.BindingEntry.add_signal(binding_set,
@@ -125,9 +201,285 @@ class Sidebar : Gitg.Sidebar
 			return sitem.stage_type;
 		}
 
+		var directory = item as Directory;
+
+		if (directory != null)
+		{
+			return directory.stage_type;
+		}
+
 		return Item.Type.NONE;
 	}
 
+	private static string sort_key(string path)
+	{
+		var name = Path.get_basename(path);
+		return name.casefold().collate_key() + "\x01" + name;
+	}
+
+	public void clear_sections()
+	{
+		model.clear();
+		d_sections.clear();
+	}
+
+	/*
+	 * Add a header for a section of items, showing empty_text while the
+	 * section has no items.
+	 */
+	public Gitg.SidebarStore.SidebarHeader add_section(string    text,
+	                                                   Item.Type type,
+	                                                   string    empty_text)
+	{
+		var section = new Section();
+
+		section.header = model.begin_header(text, (uint)type);
+		model.append_dummy(empty_text);
+		model.end_header();
+
+		section.root = new Directory("", type);
+		section.root.populated = true;
+		section.empty_text = empty_text;
+
+		d_sections[(uint)type] = section;
+		return section.header;
+	}
+
+	public bool has_section(Item.Type type)
+	{
+		return d_sections.has_key((uint)type);
+	}
+
+	private Gitg.SidebarItem row_parent(Section section, Directory directory)
+	{
+		return directory == section.root ? (Gitg.SidebarItem)section.header : directory;
+	}
+
+	private Gitg.SidebarItem? first_file(Directory directory)
+	{
+		return directory.files.is_empty ? null : directory.files[directory.files.ascending_keys.first()];
+	}
+
+	private void insert_directory_row(Section section, Directory directory)
+	{
+		var parent = directory.parent;
+		var next = parent.directories.ascending_keys.higher(directory.key);
+
+		Gitg.SidebarItem? sibling = next != null ? parent.directories[next] : first_file(parent);
+
+		model.insert_item(directory, row_parent(section, parent), sibling);
+
+		// Children are added when expanded, until then a dummy child makes
+		// the directory expandable
+		model.append_dummy_if_empty(directory, "");
+	}
+
+	private void insert_file_row(Section section, Item item)
+	{
+		var parent = item.parent;
+		var next = parent.files.ascending_keys.higher(item.key);
+
+		model.insert_item(item, row_parent(section, parent), next != null ? parent.files[next] : null);
+	}
+
+	private void populate(Section section, Directory directory)
+	{
+		if (directory.populated)
+		{
+			return;
+		}
+
+		directory.populated = true;
+		model.remove_children(directory);
+
+		foreach (var child in directory.directories.values)
+		{
+			model.insert_item(child, directory, null);
+			model.append_dummy_if_empty(child, "");
+		}
+
+		foreach (var file in directory.files.values)
+		{
+			model.insert_item(file, directory, null);
+		}
+	}
+
+	private Directory ensure_directory(Section section, string path, bool expand)
+	{
+		if (path == "." || path == "")
+		{
+			return section.root;
+		}
+
+		var parent = ensure_directory(section, Path.get_dirname(path), expand);
+		var key = sort_key(path);
+		var directory = parent.directories[key];
+
+		if (directory != null)
+		{
+			return directory;
+		}
+
+		directory = new Directory(path, section.root.stage_type);
+		directory.parent = parent;
+		directory.key = key;
+
+		parent.directories[key] = directory;
+
+		if (parent.populated)
+		{
+			insert_directory_row(section, directory);
+
+			if (expand && section.root.count < EXPAND_THRESHOLD)
+			{
+				expand_item(directory);
+			}
+		}
+
+		return directory;
+	}
+
+	private void expand_item(Gitg.SidebarItem item)
+	{
+		Gtk.TreeIter iter;
+
+		if (model.find_item(item, out iter))
+		{
+			expand_to_path(model.get_path(iter));
+		}
+	}
+
+	/*
+	 * Add items to the section of the given type, grouped by directory.
+	 * When expand is set and the section is small, new directories are
+	 * expanded.
+	 */
+	public void add_items(Item.Type type, Item[] items, bool expand)
+	{
+		var section = d_sections[(uint)type];
+
+		if (section == null)
+		{
+			return;
+		}
+
+		foreach (var item in items)
+		{
+			var path = item.item.path;
+			var directory = ensure_directory(section, Path.get_dirname(path), expand);
+
+			item.parent = directory;
+			item.key = sort_key(path);
+
+			directory.files[item.key] = item;
+
+			for (var d = directory; d != null; d = d.parent)
+			{
+				d.count++;
+			}
+
+			if (directory.populated)
+			{
+				insert_file_row(section, item);
+			}
+		}
+	}
+
+	public void remove_item(Item item)
+	{
+		var section = d_sections[(uint)item.stage_type];
+		var directory = item.parent;
+
+		if (section == null || directory == null)
+		{
+			return;
+		}
+
+		directory.files.unset(item.key);
+		item.parent = null;
+
+		model.remove_item(item);
+
+		for (var d = directory; d != null; d = d.parent)
+		{
+			d.count--;
+		}
+
+		// Remove directories which became empty
+		while (directory.parent != null && directory.count == 0)
+		{
+			var parent = directory.parent;
+
+			parent.directories.unset(directory.key);
+			model.remove_item(directory);
+
+			directory = parent;
+		}
+
+		model.append_dummy_if_empty(section.header, section.empty_text);
+	}
+
+	/*
+	 * Expand the headers of all sections, and all directories of small
+	 * sections.
+	 */
+	public void expand_sections()
+	{
+		foreach (var section in d_sections.values)
+		{
+			Gtk.TreeIter iter;
+
+			if (model.find_item(section.header, out iter))
+			{
+				expand_row(model.get_path(iter), section.root.count <= EXPAND_THRESHOLD);
+			}
+		}
+	}
+
+	// Create the rows of all directories leading to item
+	private void reveal(Gitg.SidebarItem item)
+	{
+		var sitem = item as Item;
+
+		if (sitem == null || sitem.parent == null || sitem.parent.populated)
+		{
+			return;
+		}
+
+		var section = d_sections[(uint)sitem.stage_type];
+		var directories = new Directory[0];
+
+		for (var d = sitem.parent; d != null && !d.populated; d = d.parent)
+		{
+			directories += d;
+		}
+
+		for (var i = directories.length - 1; i >= 0; i--)
+		{
+			populate(section, directories[i]);
+		}
+
+		expand_item(sitem.parent);
+	}
+
+	public new void select(Gitg.SidebarItem item)
+	{
+		reveal(item);
+		base.select(item);
+	}
+
+	protected override bool test_expand_row(Gtk.TreeIter iter, Gtk.TreePath path)
+	{
+		var directory = model.item_for_iter(iter) as Directory;
+
+		if (directory != null)
+		{
+			populate(d_sections[(uint)directory.stage_type], directory);
+		}
+
+		return false;
+	}
+
 	private Item.Type selected_type()
 	{
 		foreach (var item in get_selected_items<Gitg.SidebarItem>())
@@ -220,24 +572,12 @@ class Sidebar : Gitg.Sidebar
 	public Item[] items_of_type(Item.Type type)
 	{
 		var ret = new Item[0];
+		var section = d_sections[(uint)type];
 
-		model.foreach((m, path, iter) => {
-			var item = model.item_for_iter(iter);
-
-			if (item == null)
-			{
-				return false;
-			}
-
-			var sitem = item as Item;
-
-			if (sitem != null && sitem.stage_type == type)
-			{
-				ret += sitem;
-			}
-
-			return false;
-		});
+		if (section != null)
+		{
+			section.root.collect(ref ret);
+		}
 
 		return ret;
 	}
@@ -0,0 +1,473 @@
+/*
+ * This file is part of gitg
+ *
+ * Copyright (C) 2026 - Alberto Fanjul
+ *
+ * gitg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gitg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gitg. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+namespace GitgCommit
+{
+
+/*
+ * Keeps the status of all files in the working directory of a repository.
+ * The status of the whole working directory is only computed on reload(),
+ * which is needed when the index or HEAD change. After that, only the
+ * paths reported by update_paths() or by the working directory monitor
+ * are checked again, and the difference with the previous status is
+ * emitted with the changed signal.
+ *
+ * When the working directory has too many directories to watch, only its
+ * top level is watched and rescan_needed is emitted instead. Changes
+ * deeper in the tree are then only seen by the next reload().
+ */
+class StatusTracker : Object
+{
+	private const Ggit.StatusOption OPTIONS = Ggit.StatusOption.INCLUDE_UNTRACKED |
+	                                          Ggit.StatusOption.RECURSE_UNTRACKED_DIRS |
+	                                          Ggit.StatusOption.SORT_CASE_INSENSITIVELY |
+	                                          Ggit.StatusOption.EXCLUDE_SUBMODULES |
+	                                          Ggit.StatusOption.DISABLE_PATHSPEC_MATCH;
+
+	private const uint BATCH_INTERVAL = 100;
+
+	private Gitg.Repository d_repository;
+	private Gitg.RecursiveMonitor? d_monitor;
+	private Gee.TreeMap<string, Gitg.StageStatusItem> d_files;
+	private Gitg.StageStatusItem[] d_submodules;
+	private Gee.HashSet<string> d_submodule_paths;
+	private Gee.HashSet<string> d_dirty;
+	private Gee.HashSet<string> d_dirty_submodules;
+	private uint d_generation;
+	private bool d_running;
+	private bool d_loaded;
+
+	public delegate void ItemsFunc(Gitg.StageStatusItem[] items);
+
+	public signal void changed(Gitg.StageStatusItem[] removed, Gitg.StageStatusItem[] added);
+	public signal void rescan_needed();
+
+	public StatusTracker(Gitg.Repository repository)
+	{
+		d_repository = repository;
+
+		d_files = new Gee.TreeMap<string, Gitg.StageStatusItem>();
+		d_submodules = new Gitg.StageStatusItem[0];
+		d_submodule_paths = new Gee.HashSet<string>();
+		d_dirty = new Gee.HashSet<string>();
+		d_dirty_submodules = new Gee.HashSet<string>();
+	}
+
+	public Gitg.Repository repository
+	{
+		get { return d_repository; }
+	}
+
+	public bool monitoring
+	{
+		get { return d_monitor != null; }
+		set
+		{
+			if (value == monitoring)
+			{
+				return;
+			}
+
+			if (value)
+			{
+				d_monitor = new Gitg.RecursiveMonitor(d_repository.get_workdir(), filter_workdir_changes);
+				d_monitor.changed.connect(on_workdir_changed);
+				d_monitor.overflow.connect(on_workdir_overflow);
+			}
+			else
+			{
+				d_monitor.cancel();
+				d_monitor = null;
+			}
+		}
+	}
+
+	public bool loaded
+	{
+		get { return d_loaded; }
+	}
+
+	public Gitg.StageStatusItem[] items
+	{
+		owned get
+		{
+			var ret = new Gitg.StageStatusItem[d_submodules.length + d_files.size];
+			ret.length = 0;
+
+			foreach (var item in d_submodules)
+			{
+				ret += item;
+			}
+
+			foreach (var item in d_files.values)
+			{
+				ret += item;
+			}
+
+			return ret;
+		}
+	}
+
+	public void stop()
+	{
+		monitoring = false;
+		d_generation++;
+	}
+
+	/*
+	 * Compute the status of the whole working directory. Items are passed
+	 * to func in batches while the working directory is being scanned.
+	 * Returns false when the tracker was stopped or reloaded again before
+	 * the status was known.
+	 */
+	public async bool reload(owned ItemsFunc? func = null)
+	{
+		var generation = ++d_generation;
+
+		// Everything is checked again, including paths that were dirty
+		d_dirty.clear();
+		d_dirty_submodules.clear();
+		d_running = true;
+
+		// The cached status of submodules relies on the monitor to notice
+		// edits of their files
+		if (d_monitor == null || d_monitor.overflowed)
+		{
+			d_repository.stage.invalidate_all_submodule_status();
+		}
+
+		var options = new Ggit.StatusOptions(OPTIONS, Ggit.StatusShow.INDEX_AND_WORKDIR, null);
+		var enumerator = d_repository.stage.file_status(options);
+
+		var files = new Gee.TreeMap<string, Gitg.StageStatusItem>();
+		var submodules = new Gitg.StageStatusItem[0];
+		var submodule_paths = new Gee.HashSet<string>();
+
+		while (true)
+		{
+			var items = yield enumerator.next_batch(-1, BATCH_INTERVAL);
+
+			if (generation != d_generation)
+			{
+				enumerator.cancel();
+				return false;
+			}
+
+			if (items.length == 0)
+			{
+				break;
+			}
+
+			foreach (var item in items)
+			{
+				if (item is Gitg.StageStatusSubmodule)
+				{
+					submodules += item;
+					submodule_paths.add(item.path);
+				}
+				else
+				{
+					files[item.path] = item;
+				}
+			}
+
+			if (func != null)
+			{
+				func(items);
+			}
+		}
+
+		d_files = files;
+		d_submodules = submodules;
+		d_submodule_paths = submodule_paths;
+
+		d_loaded = true;
+		finish_update();
+
+		return true;
+	}
+
+	/*
+	 * Check the status of the given paths, relative to the working
+	 * directory, again. Paths of directories include everything below them.
+	 */
+	public void update_paths(string[] paths)
+	{
+		foreach (var path in paths)
+		{
+			d_dirty.add(path);
+		}
+
+		if (!d_running && d_loaded)
+		{
+			update_dirty.begin((obj, res) => {
+				update_dirty.end(res);
+			});
+		}
+	}
+
+	private void finish_update()
+	{
+		d_running = false;
+
+		if (d_dirty.size != 0 || d_dirty_submodules.size != 0)
+		{
+			update_dirty.begin((obj, res) => {
+				update_dirty.end(res);
+			});
+		}
+	}
+
+	// Called from a thread by the monitor, ignored directories are not watched
+	private bool filter_workdir_changes(File location)
+	{
+		var location_dir = d_repository.get_location();
+
+		if (location.equal(location_dir) || location.has_prefix(location_dir))
+		{
+			return false;
+		}
+
+		var path = d_repository.get_workdir().get_relative_path(location);
+
+		if (path == null)
+		{
+			return false;
+		}
+
+		try
+		{
+			return !d_repository.path_is_ignored(path);
+		}
+		catch
+		{
+			return true;
+		}
+	}
+
+	private string? submodule_path(string path)
+	{
+		foreach (var sub in d_submodule_paths)
+		{
+			if (path == sub || path.has_prefix(sub + "/"))
+			{
+				return sub;
+			}
+		}
+
+		return null;
+	}
+
+	private void on_workdir_changed(File[] files)
+	{
+		if (d_monitor.overflowed)
+		{
+			rescan_needed();
+			return;
+		}
+
+		var wd = d_repository.get_workdir();
+		var paths = new string[0];
+
+		foreach (var f in files)
+		{
+			var path = wd.get_relative_path(f);
+
+			if (path == null)
+			{
+				continue;
+			}
+
+			var sub = submodule_path(path);
+
+			if (sub != null)
+			{
+				// Edits of files in a submodule do not change what its
+				// cached status depends on
+				d_repository.stage.invalidate_submodule_status(sub);
+				d_dirty_submodules.add(sub);
+				continue;
+			}
+
+			paths += path;
+		}
+
+		update_paths(paths);
+	}
+
+	private void on_workdir_overflow()
+	{
+		// Changes made while the directories were searched are not known
+		rescan_needed();
+	}
+
+	// Remove paths which are below other paths, they are covered already
+	private string[] collapse_dirty()
+	{
+		var sorted = new Gee.ArrayList<string>();
+		sorted.add_all(d_dirty);
+		sorted.sort();
+
+		d_dirty.clear();
+
+		var ret = new string[0];
+		string? parent = null;
+
+		foreach (var path in sorted)
+		{
+			if (parent != null && path.has_prefix(parent))
+			{
+				continue;
+			}
+
+			ret += path;
+			parent = path + "/";
+		}
+
+		return ret;
+	}
+
+	private async void update_dirty()
+	{
+		var generation = d_generation;
+		var paths = collapse_dirty();
+		var submodule_paths = d_dirty_submodules.to_array();
+
+		d_dirty_submodules.clear();
+		d_running = true;
+
+		var status = new Gee.HashMap<string, Ggit.StatusFlags>();
+		var submodules = new Gee.HashMap<string, Gitg.StageStatusSubmodule>();
+
+		yield Gitg.Async.thread_try(() => {
+			// Without paths, the status of everything would be computed
+			if (paths.length != 0)
+			{
+				var options = new Ggit.StatusOptions(OPTIONS, Ggit.StatusShow.INDEX_AND_WORKDIR, paths);
+
+				try
+				{
+					d_repository.file_status_foreach(options, (path, flags) => {
+						status[path] = flags;
+						return 0;
+					});
+				}
+				catch (Error e)
+				{
+					stderr.printf("Failed to update file status: %s\n", e.message);
+				}
+			}
+
+			foreach (var path in submodule_paths)
+			{
+				try
+				{
+					submodules[path] = d_repository.stage.submodule_status(path);
+				}
+				catch (Error e)
+				{
+					stderr.printf("Failed to update submodule status: %s\n", e.message);
+				}
+			}
+		});
+
+		if (generation != d_generation)
+		{
+			// A full reload took over
+			return;
+		}
+
+		var removed = new Gitg.StageStatusItem[0];
+		var added = new Gitg.StageStatusItem[0];
+
+		foreach (var path in paths)
+		{
+			var known = new string[0];
+
+			if (d_files.has_key(path))
+			{
+				known += path;
+			}
+
+			var prefix = path + "/";
+
+			foreach (var key in d_files.ascending_keys.tail_set(prefix))
+			{
+				if (!key.has_prefix(prefix))
+				{
+					break;
+				}
+
+				known += key;
+			}
+
+			foreach (var key in known)
+			{
+				var item = (Gitg.StageStatusFile)d_files[key];
+
+				Ggit.StatusFlags flags;
+
+				if (status.unset(key, out flags) && flags == item.flags)
+				{
+					continue;
+				}
+
+				removed += item;
+				d_files.unset(key);
+			}
+		}
+
+		foreach (var entry in status.entries)
+		{
+			if (d_submodule_paths.contains(entry.key))
+			{
+				continue;
+			}
+
+			var item = new Gitg.StageStatusFile(entry.key, entry.value);
+
+			added += item;
+			d_files[entry.key] = item;
+		}
+
+		for (var i = 0; i < d_submodules.length; i++)
+		{
+			var item = (Gitg.StageStatusSubmodule)d_submodules[i];
+			var sub = submodules[item.path];
+
+			if (sub != null && sub.flags != item.flags)
+			{
+				removed += item;
+				added += sub;
+				d_submodules[i] = sub;
+			}
+		}
+
+		if (removed.length != 0 || added.length != 0)
+		{
+			changed(removed, added);
+		}
+
+		finish_update();
+	}
+}
+
+}
+
+// ex: ts=4 noet
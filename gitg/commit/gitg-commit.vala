@@ -23,11 +23,20 @@ namespace GitgCommit
 	{
 		// Do this to pull in config.h before glib.h (for gettext...)
 		private const string version = Gitg.Config.VERSION;
+		private const int BATCH_NOTIFICATION_THRESHOLD = 200;
+		private const int MAX_SIDEBAR_CHANGES = 1000;
+
 		private Paned? d_main;
 		private bool d_reloading;
 		private bool d_has_staged;
 		private ulong d_externally_changed_id;
 		private bool d_ignore_external_changes;
+		private StatusTracker? d_tracker;
+		private Settings d_interface_settings;
+		private Gee.HashMultiMap<string, Sidebar.Item> d_sidebar_items;
+		private Gitg.SidebarStore.SidebarHeader? d_staged_header;
+		private Gitg.SidebarStore.SidebarHeader? d_unstaged_header;
+		private Gitg.SidebarStore.SidebarHeader? d_untracked_header;
 		private Gitg.WhenMapped? d_reload_when_mapped;
 
 		private enum UiType
@@ -70,6 +79,9 @@ namespace GitgCommit
 			                          "repository", BindingFlags.DEFAULT);
 
 			d_externally_changed_id = application.repository_changed_externally.connect(repository_changed_externally);
+
+			d_interface_settings = new Settings(Gitg.Config.APPLICATION_ID + ".preferences.interface");
+			d_sidebar_items = new Gee.HashMultiMap<string, Sidebar.Item>();
 		}
 
 		public bool enabled
@@ -88,26 +100,50 @@ namespace GitgCommit
 				d_externally_changed_id = 0;
 			}
 
+			if (d_tracker != null)
+			{
+				d_tracker.changed.disconnect(on_status_changed);
+				d_tracker.rescan_needed.disconnect(reload_when_mapped);
+				d_tracker.stop();
+				d_tracker = null;
+			}
+
 			base.dispose();
 		}
 
 		private void repository_changed_externally(GitgExt.ExternalChangeHint hint)
 		{
+			// Nothing is tracked until the view is built
+			if (d_main == null)
+			{
+				d_ignore_external_changes = false;
+				return;
+			}
+
 			if (!d_ignore_external_changes)
 			{
-				if (d_main != null && (hint & GitgExt.ExternalChangeHint.INDEX) != 0)
+				// The status of everything can change when the index or HEAD
+				// change, other changes in the working directory are picked
+				// up by the status tracker
+				if (d_main != null && (hint & (GitgExt.ExternalChangeHint.INDEX |
+				                               GitgExt.ExternalChangeHint.HEAD)) != 0)
 				{
-					d_reload_when_mapped = new Gitg.WhenMapped(d_main);
-
-					d_reload_when_mapped.update(() => {
-						reload();
-					}, this);
+					reload_when_mapped();
 				}
 			}
 
 			d_ignore_external_changes = false;
 		}
 
+		private void reload_when_mapped()
+		{
+			d_reload_when_mapped = new Gitg.WhenMapped(d_main);
+
+			d_reload_when_mapped.update(() => {
+				reload();
+			}, this);
+		}
+
 		public string display_name
 		{
 			owned get { return C_("Activity", "Commit"); }
@@ -155,7 +191,6 @@ namespace GitgCommit
 			return false;
 		}
 
-		private delegate void StageUnstageCallback(Sidebar.Item item);
 		private delegate void StageUnstageSubmoduleCommitCallback(Gitg.Commit commit);
 
 		private delegate void UpdateDiffCallback();
@@ -297,70 +332,148 @@ namespace GitgCommit
 			return true;
 		}
 
-		private async bool stage_file(Gitg.StageStatusFile file)
+		private async bool stage_unstage_paths(bool     staging,
+		                                       string[] paths,
+		                                       string[] removed_paths)
 		{
 			var stage = application.repository.stage;
+			var total = paths.length + removed_paths.length;
 
-			if ((file.flags & Ggit.StatusFlags.WORKING_TREE_DELETED) != 0)
+			if (total == 0)
 			{
-				try
+				return true;
+			}
+
+			Cancellable? cancellable = null;
+			Gitg.SimpleNotification? notification = null;
+			Gitg.StageProgressFunc? progress = null;
+
+			// Only large batches take long enough to be worth reporting
+			if (total >= BATCH_NOTIFICATION_THRESHOLD)
+			{
+				cancellable = new Cancellable();
+
+				notification = new Gitg.SimpleNotification(staging ? _("Staging files") : _("Unstaging files"));
+				notification.cancel.connect(() => { cancellable.cancel(); });
+
+				application.notifications.add(notification);
+
+				progress = (done, count) => {
+					notification.message = _("%u of %u files").printf(done, count);
+				};
+			}
+
+			var ok = true;
+
+			try
+			{
+				if (staging)
 				{
-					yield stage.delete_path(file.path);
+					yield stage.stage_paths(paths, removed_paths, cancellable, (owned)progress);
 				}
-				catch (Error e)
+				else
 				{
-					var msg = _("Failed to stage the removal of file “%s”").printf(file.path);
-					application.show_infobar(msg, e.message, Gtk.MessageType.ERROR);
-
-					return false;
+					yield stage.unstage_paths(paths, removed_paths, cancellable, (owned)progress);
 				}
 			}
-			else
+			catch (IOError.CANCELLED e)
 			{
-				try
+				ok = false;
+			}
+			catch (Error e)
+			{
+				string msg;
+
+				if (total == 1)
 				{
-					yield stage.stage_path(file.path);
+					var path = paths.length == 1 ? paths[0] : removed_paths[0];
+
+					if (staging)
+					{
+						msg = paths.length == 1 ? _("Failed to stage the file “%s”").printf(path)
+						                        : _("Failed to stage the removal of file “%s”").printf(path);
+					}
+					else
+					{
+						msg = paths.length == 1 ? _("Failed to unstage the file “%s”").printf(path)
+						                        : _("Failed to unstage the removal of file “%s”").printf(path);
+					}
 				}
-				catch (Error e)
+				else
 				{
-					var msg = _("Failed to stage the file “%s”").printf(file.path);
-					application.show_infobar(msg, e.message, Gtk.MessageType.ERROR);
-
-					return false;
+					msg = staging ? _("Failed to stage files") : _("Failed to unstage files");
 				}
+
+				application.show_infobar(msg, e.message, Gtk.MessageType.ERROR);
+				ok = false;
 			}
 
-			return true;
+			if (notification != null)
+			{
+				notification.close();
+			}
+
+			return ok;
 		}
 
 		private async void stage_items(owned Gitg.StageStatusItem[] items)
 		{
+			var paths = new string[0];
+			var removed_paths = new string[0];
+			var submodules = new Gitg.StageStatusSubmodule[0];
+
 			foreach (var item in items)
 			{
-				var ok = true;
-
 				if (item is Gitg.StageStatusFile)
 				{
-					d_ignore_external_changes = true;
-					ok = yield stage_file((Gitg.StageStatusFile)item);
+					if ((((Gitg.StageStatusFile)item).flags & Ggit.StatusFlags.WORKING_TREE_DELETED) != 0)
+					{
+						removed_paths += item.path;
+					}
+					else
+					{
+						paths += item.path;
+					}
 				}
 				else if (item is Gitg.StageStatusSubmodule)
 				{
-					d_ignore_external_changes = true;
-					ok = yield stage_submodule((Gitg.StageStatusSubmodule)item, null);
+					submodules += (Gitg.StageStatusSubmodule)item;
 				}
 				else
 				{
 					assert_not_reached();
 				}
+			}
+
+			d_ignore_external_changes = true;
 
-				if (!ok)
+			// All files are written to the index at once, submodules need
+			// their own repository opened and are done one by one
+			if (yield stage_unstage_paths(true, paths, removed_paths))
+			{
+				foreach (var sub in submodules)
 				{
-					break;
+					if (!(yield stage_submodule(sub, null)))
+					{
+						break;
+					}
 				}
 			}
 
-			reload();
+			if (submodules.length == 0)
+			{
+				// Only the status of these files changed
+				foreach (var path in removed_paths)
+				{
+					paths += path;
+				}
+
+				update_paths(paths);
+			}
+			else
+			{
+				reload();
+			}
 		}
 
 		private void show_ui(UiType type)
@@ -658,14 +771,6 @@ namespace GitgCommit
 			return true;
 		}
 
-		private async bool unstage_file(Gitg.StageStatusFile file)
-		{
-			return yield unstage_item(file,
-			                          (file.flags & Ggit.StatusFlags.INDEX_NEW) != 0,
-			                          _("Failed to unstage the removal of file “%s”").printf(file.path),
-			                          _("Failed to unstage the file “%s”").printf(file.path));
-		}
-
 		private async bool unstage_submodule(Gitg.StageStatusSubmodule sub)
 		{
 			return yield unstage_item(sub,
@@ -695,32 +800,60 @@ namespace GitgCommit
 
 		private async void unstage_items(owned Gitg.StageStatusItem[] items)
 		{
+			var paths = new string[0];
+			var removed_paths = new string[0];
+			var submodules = new Gitg.StageStatusSubmodule[0];
+
 			foreach (var item in items)
 			{
-				var ok = true;
-
 				if (item is Gitg.StageStatusFile)
 				{
-					d_ignore_external_changes = true;
-					ok = yield unstage_file((Gitg.StageStatusFile)item);
+					if ((((Gitg.StageStatusFile)item).flags & Ggit.StatusFlags.INDEX_NEW) != 0)
+					{
+						removed_paths += item.path;
+					}
+					else
+					{
+						paths += item.path;
+					}
 				}
 				else if (item is Gitg.StageStatusSubmodule)
 				{
-					d_ignore_external_changes = true;
-					ok = yield unstage_submodule((Gitg.StageStatusSubmodule)item);
+					submodules += (Gitg.StageStatusSubmodule)item;
 				}
 				else
 				{
 					assert_not_reached();
 				}
+			}
+
+			d_ignore_external_changes = true;
 
-				if (!ok)
+			if (yield stage_unstage_paths(false, paths, removed_paths))
+			{
+				foreach (var sub in submodules)
 				{
-					break;
+					if (!(yield unstage_submodule(sub)))
+					{
+						break;
+					}
 				}
 			}
 
-			reload();
+			if (submodules.length == 0)
+			{
+				// Only the status of these files changed
+				foreach (var path in removed_paths)
+				{
+					paths += path;
+				}
+
+				update_paths(paths);
+			}
+			else
+			{
+				reload();
+			}
 		}
 
 		private void on_staged_activated(Gitg.StageStatusItem[] items)
@@ -730,347 +863,475 @@ namespace GitgCommit
 			});
 		}
 
-		private Sidebar.Item[] append_items(Gitg.SidebarStore      model,
-		                                    Gitg.StageStatusItem[] items,
-		                                    Sidebar.Item.Type      type,
-		                                    Gee.HashSet<string>?   selected_paths,
-		                                    StageUnstageCallback?  callback)
+		private void on_item_activated(Sidebar.Item item)
 		{
-			var ret = new Sidebar.Item[0];
+			var selected = d_main.sidebar.is_selected(item);
 
-			var sorted = new Gee.ArrayList<Gitg.StageStatusItem>.wrap(items);
+			if (item.stage_type == Sidebar.Item.Type.STAGED)
+			{
+				if (selected)
+				{
+					on_unstage_selected_items();
+				}
+				else
+				{
+					on_staged_activated(new Gitg.StageStatusItem[] {item.item});
+				}
+			}
+			else
+			{
+				if (selected)
+				{
+					on_stage_selected_items();
+				}
+				else
+				{
+					on_unstaged_activated(new Gitg.StageStatusItem[] {item.item});
+				}
+			}
+		}
 
-			sorted.sort((a, b) => {
-				return a.path.casefold().collate(b.path.casefold());
-			});
+		private Sidebar.Item[] create_items(Gitg.StageStatusItem[] items,
+		                                    Sidebar.Item.Type      type)
+		{
+			var ret = new Sidebar.Item[items.length];
+			ret.length = 0;
 
 			string filter_filename_text = d_main.commit_files_search_entry.text;
 
-			foreach (var item in sorted)
+			foreach (var item in items)
 			{
-				var sitem = new Sidebar.Item(item, type);
-
-				bool filter_passed = filter_filename_text in item.path;
-
-				if (selected_paths != null && selected_paths.contains(item.path) && filter_passed)
+				if (!(filter_filename_text in item.path))
 				{
-					ret += sitem;
+					continue;
 				}
 
+				var sitem = new Sidebar.Item(item, type);
+
 				sitem.activated.connect((numclick) => {
-					callback(sitem);
+					on_item_activated(sitem);
 				});
 
-				if (filter_passed) model.append(sitem);
+				d_sidebar_items[item.path] = sitem;
+				ret += sitem;
 			}
 
 			return ret;
 		}
 
-		private void reload()
+		private void append_items(ref Sidebar.Item[]      ret,
+		                          Gitg.StageStatusItem[]  items,
+		                          Sidebar.Item.Type       type,
+		                          bool                    expand)
 		{
-			d_reload_when_mapped = null;
-
-			var repository = application.repository;
-
-			if (repository == null || d_reloading)
+			if (items.length == 0)
 			{
 				return;
 			}
 
-			d_reloading = true;
+			var sitems = create_items(items, type);
+			d_main.sidebar.add_items(type, sitems, expand);
 
+			foreach (var sitem in sitems)
+			{
+				ret += sitem;
+			}
+		}
+
+		// Add status items to the sections they belong to
+		private Sidebar.Item[] add_status_items(Gitg.StageStatusItem[] items, bool expand)
+		{
 			var sb = d_main.sidebar;
-			var model = sb.model;
 
-			Sidebar.Item.Type selected_type;
-			Gitg.StageStatusItem[] selected_items;
+			var staged = new Gitg.StageStatusItem[0];
+			var unstaged = new Gitg.StageStatusItem[0];
+			var untracked = new Gitg.StageStatusItem[0];
+			var dirty = new Gitg.StageStatusItem[0];
 
-			selected_items = items_for_items(sb.get_selected_items<Gitg.SidebarItem>(),
-			                                 out selected_type);
+			foreach (var item in items)
+			{
+				if (item.is_staged)
+				{
+					staged += item;
+				}
 
-			var selected_paths = new Gee.HashSet<string>();
+				if (item.is_unstaged)
+				{
+					unstaged += item;
+				}
 
-			foreach (var item in selected_items)
-			{
-				selected_paths.add(item.path);
-			}
+				if (item.is_untracked)
+				{
+					untracked += item;
+				}
 
-			if (d_main.diff_view.use_gravatar)
-			{
-				// Preload author avatar
-				try
+				var sub = item as Gitg.StageStatusSubmodule;
+
+				if (sub != null)
 				{
-					var author = get_signature("AUTHOR");
-					var ac = Gitg.AvatarCache.default();
+					if (!sb.has_section(Sidebar.Item.Type.SUBMODULE))
+					{
+						sb.add_section(_("Submodule"), Sidebar.Item.Type.SUBMODULE, _("No dirty submodules"));
+						sb.expand_sections();
+					}
 
-					ac.load.begin(author.get_email(), 50, null, (obj, res) => {
-						ac.load.end(res);
-					});
-				} catch {}
+					if (sub.is_dirty)
+					{
+						dirty += item;
+					}
+				}
 			}
 
-			var stage = repository.stage;
+			var ret = new Sidebar.Item[0];
+
+			append_items(ref ret, staged, Sidebar.Item.Type.STAGED, expand);
+			append_items(ref ret, unstaged, Sidebar.Item.Type.UNSTAGED, expand);
+			append_items(ref ret, untracked, Sidebar.Item.Type.UNTRACKED, expand);
+			append_items(ref ret, dirty, Sidebar.Item.Type.SUBMODULE, expand);
+
+			d_has_staged = sb.model.has_items(d_staged_header);
+			return ret;
+		}
+
+		private Gee.HashSet<string> get_selected_paths(out Sidebar.Item.Type selected_type)
+		{
+			var selected_items = items_for_items(d_main.sidebar.get_selected_items<Gitg.SidebarItem>(),
+			                                     out selected_type);
+
+			var selected_paths = new Gee.HashSet<string>();
 
-			var opts = Ggit.StatusOption.INCLUDE_UNTRACKED |
-			           Ggit.StatusOption.RECURSE_UNTRACKED_DIRS |
-			           Ggit.StatusOption.SORT_CASE_INSENSITIVELY |
-			           Ggit.StatusOption.EXCLUDE_SUBMODULES |
-			           Ggit.StatusOption.DISABLE_PATHSPEC_MATCH;
+			foreach (var item in selected_items)
+			{
+				selected_paths.add(item.path);
+			}
 
-			var show = Ggit.StatusShow.INDEX_AND_WORKDIR;
+			return selected_paths;
+		}
 
-			var options = new Ggit.StatusOptions(opts, show, null);
-			var enumerator = stage.file_status(options);
+		private Gitg.SidebarStore.SidebarHeader? get_selected_header()
+		{
+			foreach (var item in d_main.sidebar.get_selected_items<Gitg.SidebarItem>())
+			{
+				var header = item as Gitg.SidebarStore.SidebarHeader;
 
-			enumerator.next_items.begin(-1, (obj, res) => {
-				var items = enumerator.next_items.end(res);
+				if (header != null)
+				{
+					return header;
+				}
+			}
 
-				var staged = new Gitg.StageStatusItem[items.length];
-				staged.length = 0;
+			return null;
+		}
 
-				var unstaged = new Gitg.StageStatusItem[items.length];
-				unstaged.length = 0;
+		/*
+		 * Select the items which were selected before, preferring items of
+		 * the type that was selected. Items of other types are only
+		 * considered when any_type is set.
+		 */
+		private bool restore_selection(Sidebar.Item[]      items,
+		                               Sidebar.Item.Type   selected_type,
+		                               Gee.HashSet<string> selected_paths,
+		                               bool                any_type)
+		{
+			if (selected_paths.size == 0)
+			{
+				return false;
+			}
 
-				var untracked = new Gitg.StageStatusItem[items.length];
-				untracked.length = 0;
+			Sidebar.Item.Type[] types = { selected_type };
 
-				var dirty = new Gitg.StageStatusItem[items.length];
-				dirty.length = 0;
+			if (any_type)
+			{
+				types += Sidebar.Item.Type.STAGED;
+				types += Sidebar.Item.Type.UNSTAGED;
+				types += Sidebar.Item.Type.UNTRACKED;
+				types += Sidebar.Item.Type.SUBMODULE;
+			}
 
-				bool hassub = false;
+			foreach (var type in types)
+			{
+				var found = false;
 
 				foreach (var item in items)
 				{
-					if (item.is_staged)
+					if (item.stage_type == type && selected_paths.contains(item.item.path))
 					{
-						staged += item;
+						d_main.sidebar.select(item);
+						found = true;
 					}
+				}
 
-					if (item.is_unstaged)
-					{
-						unstaged += item;
-					}
+				if (found)
+				{
+					return true;
+				}
+			}
 
-					if (item.is_untracked)
-					{
-						untracked += item;
-					}
+			return false;
+		}
 
-					var sub = item as Gitg.StageStatusSubmodule;
+		private void select_default_header()
+		{
+			var sb = d_main.sidebar;
 
-					if (sub != null)
-					{
-						hassub = true;
+			// Select staged/unstaged header
+			if (sb.model.has_items(d_unstaged_header))
+			{
+				sb.select(d_unstaged_header);
+			}
+			else
+			{
+				sb.select(d_staged_header);
+			}
+		}
 
-						if (sub.is_dirty)
-						{
-							dirty += item;
-						}
-					}
-				}
+		private void update_tracker()
+		{
+			if (d_tracker != null)
+			{
+				d_tracker.changed.disconnect(on_status_changed);
+				d_tracker.rescan_needed.disconnect(reload_when_mapped);
+				d_tracker.stop();
+				d_tracker = null;
+			}
 
-				model.clear();
-				d_main.diff_view.diff = null;
+			var repository = application.repository;
 
-				var current_staged = new Sidebar.Item[0];
-				var current_unstaged = new Sidebar.Item[0];
-				var current_untracked = new Sidebar.Item[0];
-				var current_submodules = new Sidebar.Item[0];
+			if (repository != null && !repository.is_bare)
+			{
+				d_tracker = new StatusTracker(repository);
+				d_tracker.changed.connect(on_status_changed);
+				d_tracker.rescan_needed.connect(reload_when_mapped);
 
-				// Populate staged items
-				var staged_header = model.begin_header(_("Staged"), (uint)Sidebar.Item.Type.STAGED);
+				d_interface_settings.bind("enable-monitoring",
+				                          d_tracker,
+				                          "monitoring",
+				                          SettingsBindFlags.GET);
+			}
+		}
 
-				staged_header.activated.connect((numclick) => {
-					on_unstage_selected_items();
-				});
+		// Check the status of the given paths again instead of the whole
+		// working directory, when nothing else could have changed
+		private void update_paths(string[] paths)
+		{
+			if (d_tracker != null && d_tracker.repository == application.repository)
+			{
+				d_tracker.update_paths(paths);
+			}
+			else
+			{
+				reload();
+			}
+		}
 
-				if (staged.length == 0)
-				{
-					model.append_dummy(_("No staged files"));
-				}
-				else
-				{
-					current_staged = append_items(model,
-					                              staged,
-					                              Sidebar.Item.Type.STAGED,
-					                              selected_paths,
-					                              (item) => {
-						if (d_main.sidebar.is_selected(item))
-						{
-							on_unstage_selected_items();
-						}
-						else
-						{
-							on_staged_activated(new Gitg.StageStatusItem[] {item.item});
-						}
-					});
-				}
+		private void reload()
+		{
+			d_reload_when_mapped = null;
 
-				model.end_header();
+			var repository = application.repository;
 
-				// Populate unstaged items
-				var unstaged_header = model.begin_header(_("Unstaged"), (uint)Sidebar.Item.Type.UNSTAGED);
+			// The status is only tracked once the view is shown, it is
+			// loaded when the activity is activated
+			if (d_main == null || repository == null || d_reloading)
+			{
+				return;
+			}
 
-				unstaged_header.activated.connect((numclick) => {
-					on_stage_selected_items();
-				});
+			if (d_tracker == null || d_tracker.repository != repository)
+			{
+				update_tracker();
 
-				if (unstaged.length == 0)
+				if (d_tracker == null)
 				{
-					model.append_dummy(_("No unstaged files"));
-				}
-				else
-				{
-					current_unstaged = append_items(model,
-					                                unstaged,
-					                                Sidebar.Item.Type.UNSTAGED,
-					                                selected_paths,
-					                                (item) => {
-						if (d_main.sidebar.is_selected(item))
-						{
-							on_stage_selected_items();
-						}
-						else
-						{
-							on_unstaged_activated(new Gitg.StageStatusItem[] {item.item});
-						}
-					});
+					return;
 				}
+			}
 
-				model.end_header();
-
-				// Populate untracked items
-				model.begin_header(_("Untracked"), (uint)Sidebar.Item.Type.UNTRACKED);
+			d_reloading = true;
 
-				if (untracked.length == 0)
-				{
-					model.append_dummy(_("No untracked files"));
-				}
-				else
+			if (d_main.diff_view.use_gravatar)
+			{
+				// Preload author avatar
+				try
 				{
-					current_untracked = append_items(model,
-					                                 untracked,
-					                                 Sidebar.Item.Type.UNTRACKED,
-					                                 selected_paths,
-					                                 (item) => {
-						if (d_main.sidebar.is_selected(item))
-						{
-							on_stage_selected_items();
-						}
-						else
-						{
-							on_unstaged_activated(new Gitg.StageStatusItem[] {item.item});
-						}
+					var author = get_signature("AUTHOR");
+					var ac = Gitg.AvatarCache.default();
+
+					ac.load.begin(author.get_email(), 50, null, (obj, res) => {
+						ac.load.end(res);
 					});
-				}
+				} catch {}
+			}
 
-				model.end_header();
+			var tracker = d_tracker;
 
-				// Populate submodule items
-				if (hassub)
-				{
-					model.begin_header(_("Submodule"), (uint)Sidebar.Item.Type.SUBMODULE);
+			if (tracker.loaded)
+			{
+				// Keep showing the previous status until the new one is known
+				tracker.reload.begin(null, (obj, res) => {
+					var loaded = tracker.reload.end(res);
 
-					if (dirty.length == 0)
-					{
-						model.append_dummy(_("No dirty submodules"));
-					}
-					else
+					d_reloading = false;
+
+					if (loaded)
 					{
-						current_submodules = append_items(model,
-						                                  dirty,
-						                                  Sidebar.Item.Type.SUBMODULE,
-						                                  selected_paths,
-						                                  (item) => {
-						    if (d_main.sidebar.is_selected(item))
-						    {
-						    	on_stage_selected_items();
-						    }
-						    else
-						    {
-								on_unstaged_activated(new Gitg.StageStatusItem[] {item.item});
-							}
-						});
+						populate();
 					}
+				});
 
-					model.end_header();
-				}
+				return;
+			}
 
-				d_main.sidebar.expand_all();
-				d_has_staged = staged.length != 0;
+			// Show items as they are found while the working directory is
+			// scanned for the first time
+			d_main.diff_view.diff = null;
+			create_sections();
+
+			tracker.reload.begin((items) => {
+				add_status_items(items, false);
+			}, (obj, res) => {
+				var loaded = tracker.reload.end(res);
 
 				d_reloading = false;
 
-				if (selected_paths.size != 0)
+				if (loaded)
 				{
-					Sidebar.Item[] sel = null;
+					d_main.sidebar.expand_sections();
 
-					switch (selected_type)
+					if (d_main.sidebar.get_selected_items<Gitg.SidebarItem>().length == 0)
 					{
-					case Sidebar.Item.Type.STAGED:
-						sel = current_staged;
-						break;
-					case Sidebar.Item.Type.UNSTAGED:
-						sel = current_unstaged;
-						break;
-					case Sidebar.Item.Type.UNTRACKED:
-						sel = current_untracked;
-						break;
-					case Sidebar.Item.Type.SUBMODULE:
-						sel = current_submodules;
-						break;
+						select_default_header();
 					}
+				}
+			});
+		}
 
-					if (sel == null || sel.length == 0)
-					{
-						sel = current_staged;
-					}
+		private void create_sections()
+		{
+			var sb = d_main.sidebar;
 
-					if (sel == null || sel.length == 0)
-					{
-						sel = current_unstaged;
-					}
+			sb.clear_sections();
+			d_sidebar_items.clear();
 
-					if (sel == null || sel.length == 0)
-					{
-						sel = current_untracked;
-					}
+			d_staged_header = sb.add_section(_("Staged"),
+			                                 Sidebar.Item.Type.STAGED,
+			                                 _("No staged files"));
 
-					if (sel == null || sel.length == 0)
-					{
-						sel = current_submodules;
-					}
+			d_staged_header.activated.connect((numclick) => {
+				on_unstage_selected_items();
+			});
 
-					if (sel != null && sel.length != 0)
-					{
-						foreach (var item in sel)
-						{
-							d_main.sidebar.select(item);
-						}
-					}
-					else if (selected_type == Sidebar.Item.Type.STAGED)
-					{
-						d_main.sidebar.select(staged_header);
-					}
-					else
-					{
-						d_main.sidebar.select(unstaged_header);
-					}
+			d_unstaged_header = sb.add_section(_("Unstaged"),
+			                                   Sidebar.Item.Type.UNSTAGED,
+			                                   _("No unstaged files"));
+
+			d_unstaged_header.activated.connect((numclick) => {
+				on_stage_selected_items();
+			});
+
+			d_untracked_header = sb.add_section(_("Untracked"),
+			                                    Sidebar.Item.Type.UNTRACKED,
+			                                    _("No untracked files"));
+
+			d_has_staged = false;
+			sb.expand_sections();
+		}
+
+		// Fill the sidebar from the last known status of the working directory
+		private void populate()
+		{
+			var sb = d_main.sidebar;
+
+			Sidebar.Item.Type selected_type = Sidebar.Item.Type.NONE;
+			Gee.HashSet<string> selected_paths;
+
+			// A selected header is selected again as a whole, instead of
+			// selecting each of its items
+			var selected_header = get_selected_header();
+			var selected_header_type = Sidebar.Item.Type.NONE;
+
+			if (selected_header != null)
+			{
+				selected_header_type = (Sidebar.Item.Type)selected_header.id;
+				selected_paths = new Gee.HashSet<string>();
+			}
+			else
+			{
+				selected_paths = get_selected_paths(out selected_type);
+			}
+
+			d_main.diff_view.diff = null;
+			create_sections();
+
+			var current = add_status_items(d_tracker.items, false);
+
+			sb.expand_sections();
+
+			if (selected_header_type == Sidebar.Item.Type.STAGED)
+			{
+				sb.select(d_staged_header);
+			}
+			else if (selected_header_type == Sidebar.Item.Type.UNSTAGED)
+			{
+				sb.select(d_unstaged_header);
+			}
+			else if (selected_paths.size != 0)
+			{
+				if (restore_selection(current, selected_type, selected_paths, true))
+				{
+					return;
+				}
+
+				if (selected_type == Sidebar.Item.Type.STAGED)
+				{
+					sb.select(d_staged_header);
 				}
 				else
 				{
-					// Select staged/unstaged header
-					if (unstaged.length == 0)
-					{
-						d_main.sidebar.select(staged_header);
-					}
-					else
-					{
-						d_main.sidebar.select(unstaged_header);
-					}
+					sb.select(d_unstaged_header);
 				}
-			});
+			}
+			else
+			{
+				select_default_header();
+			}
+		}
+
+		// Apply the changes found by the status tracker to the sidebar,
+		// without rebuilding it
+		private void on_status_changed(Gitg.StageStatusItem[] removed,
+		                               Gitg.StageStatusItem[] added)
+		{
+			if (d_main == null || d_reloading || d_staged_header == null)
+			{
+				return;
+			}
+
+			if (removed.length + added.length > MAX_SIDEBAR_CHANGES)
+			{
+				populate();
+				return;
+			}
+
+			var sb = d_main.sidebar;
+
+			Sidebar.Item.Type selected_type;
+			var selected_paths = get_selected_paths(out selected_type);
+
+			foreach (var item in removed)
+			{
+				foreach (var sitem in d_sidebar_items[item.path])
+				{
+					sb.remove_item(sitem);
+				}
+
+				d_sidebar_items.remove_all(item.path);
+			}
+
+			var current = add_status_items(added, true);
+
+			// Keep rows that were replaced selected
+			restore_selection(current, selected_type, selected_paths, false);
 		}
 
 		public void activate()
@@ -1283,19 +1544,15 @@ namespace GitgCommit
 			var selection = d_main.diff_view.get_selection();
 			var stage = application.repository.stage;
 
-			foreach (var pset in selection)
+			if (staging)
 			{
-				if (pset.patches.length == 0)
-					continue;
-				if (staging)
-				{
-					yield stage.stage_patch(pset);
-				}
-				else
-				{
-					yield stage.unstage_patch(pset);
-				}
+				yield stage.stage_patches(selection);
 			}
+			else
+			{
+				yield stage.unstage_patches(selection);
+			}
+
 			d_main.diff_view.clear_selection();
 		}
 
@@ -1304,10 +1561,7 @@ namespace GitgCommit
 			var selection = d_main.diff_view.get_selection();
 			var stage = application.repository.stage;
 
-			foreach (var pset in selection)
-			{
-				yield stage.revert_patch(pset);
-			}
+			yield stage.revert_patches(selection);
 		}
 
 		private void on_discard_clicked()
@@ -1738,6 +1992,9 @@ namespace GitgCommit
 
 			type = Sidebar.Item.Type.NONE;
 
+			// A directory and items below it can be selected together
+			var seen = new Gee.HashSet<string>();
+
 			foreach (var item in items)
 			{
 				var header = item as Gitg.SidebarStore.SidebarHeader;
@@ -1748,11 +2005,34 @@ namespace GitgCommit
 					return stage_status_items_of_type(type);
 				}
 
+				var directory = item as Sidebar.Directory;
+
+				if (directory != null)
+				{
+					var files = new Sidebar.Item[0];
+					directory.collect(ref files);
+
+					foreach (var file in files)
+					{
+						if (seen.add(file.item.path))
+						{
+							ret += file.item;
+						}
+					}
+
+					type = directory.stage_type;
+					continue;
+				}
+
 				var sitem = item as Sidebar.Item;
 
 				if (sitem != null)
 				{
-					ret += sitem.item;
+					if (seen.add(sitem.item.path))
+					{
+						ret += sitem.item;
+					}
+
 					type = sitem.stage_type;
 				}
 			}
@@ -1890,7 +2170,10 @@ namespace GitgCommit
 
 			d_main.commit_files_search_bar.connect_entry(d_main.commit_files_search_entry);
 			d_main.commit_files_search_entry.search_changed.connect((entry) => {
-				reload();
+				if (d_tracker != null && !d_reloading)
+				{
+					populate();
+				}
 			});
 			d_main.commit_files_search_entry.stop_search.connect((entry) => {
 				d_main.commit_files_search_bar.search_mode_enabled = true;
@@ -1969,6 +2252,8 @@ namespace GitgCommit
 			                          d_main.diff_view,
 			                          "repository",
 			                          BindingFlags.SYNC_CREATE);
+
+			update_tracker();
 		}
 	}
 }
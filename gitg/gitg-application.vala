@@ -111,6 +111,11 @@ public class Application : Gtk.Application
 		{
 			if (info.get_external_data("CommandLine") != null)
 			{
+				if (!info.is_loaded())
+				{
+					engine.load_plugin(info);
+				}
+
 				var ext = engine.create_extension(info, typeof(GitgExt.CommandLine)) as GitgExt.CommandLine;
 
 				if (ext != null)
@@ -136,11 +141,13 @@ public class Application : Gtk.Application
 		unowned string[] argv = cp;
 
 		PluginsEngine.initialize();
+		StartupTiming.mark("plugins engine");
 
 		try
 		{
 			// This is just for local things, like showing help
 			parse_command_line(ref argv);
+			StartupTiming.mark("command line");
 		}
 		catch (Error e)
 		{
@@ -452,6 +459,8 @@ public class Application : Gtk.Application
 
 		var theme = Gtk.IconTheme.get_default();
 		theme.prepend_search_path(Path.build_filename(PlatformSupport.get_data_dir(), "icons"));
+
+		StartupTiming.mark("application startup");
 	}
 
 	private void add_css(string path)
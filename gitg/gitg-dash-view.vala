@@ -509,42 +509,9 @@ class DashView : Gtk.Grid, GitgExt.UIElement, GitgExt.Activity, GitgExt.Selectab
 		       location.get_child("refs").query_exists();
 	}
 
-	private async bool file_exists_async(File file, Cancellable? cancellable)
+	protected void scan_visit_repository(File location)
 	{
-		try
-		{
-			return (yield file.query_info_async(FileAttribute.STANDARD_TYPE, FileQueryInfoFlags.NONE, Priority.DEFAULT, cancellable)) != null;
-		}
-		catch
-		{
-			return false;
-		}
-	}
-
-	protected async bool scan_visit_directory(File file, Cancellable? cancellable)
-	{
-		if (cancellable != null && cancellable.is_cancelled())
-		{
-			return false;
-		}
-
-		// Check for .git
-		if ((yield file_exists_async(file.get_child(".git"), cancellable)))
-		{
-			do_add_repository(file, false);
-			return false;
-		}
-
-		// Check for bare
-		if ((yield file_exists_async(file.get_child("objects"), cancellable)) &&
-		    (yield file_exists_async(file.get_child("HEAD"), cancellable)) &&
-		    (yield file_exists_async(file.get_child("refs"), cancellable)))
-		{
-			do_add_repository(file, false);
-			return false;
-		}
-
-		return scan_visit_directory_default(file);
+		do_add_repository(location, false);
 	}
 
 	private void add_repositories_scan(File location)
@@ -576,7 +543,10 @@ class DashView : Gtk.Grid, GitgExt.UIElement, GitgExt.Activity, GitgExt.Selectab
 			return false;
 		});
 
-		scan.begin(location, cancellable, () => {
+		var settings = new Settings(Gitg.Config.APPLICATION_ID + ".preferences.main");
+		var skip = settings.get_strv("scan-skip-directories");
+
+		scan.begin(location, skip, cancellable, () => {
 			if (timeout_id != 0)
 			{
 				timeout_id = 0;
@@ -0,0 +1,309 @@
+/*
+ * This file is part of gitg
+ *
+ * Copyright (C) 2026 - Alberto Fanjul
+ *
+ * gitg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gitg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gitg. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+namespace Gitg
+{
+
+/*
+ * Fetches a set of remotes, with at most fetch-concurrency fetches running
+ * at once. Remotes added with priority are fetched first. The progress of
+ * all fetches is shown in a single notification, which is updated at a
+ * fixed interval instead of for every packet received.
+ */
+class FetchScheduler : Object
+{
+	// Do this to pull in config.h before glib.h (for gettext...)
+	private const string version = Gitg.Config.VERSION;
+
+	private const uint PROGRESS_INTERVAL = 200;
+
+	private class Job
+	{
+		public Gitg.Remote remote;
+		public string name;
+		public bool done;
+		public string? error;
+		public Gee.ArrayList<string> updates;
+	}
+
+	private GitgExt.Application d_application;
+	private Ggit.RemoteDownloadTagsType? d_download_tags;
+	private uint d_max_running;
+
+	private Gee.ArrayList<Job> d_jobs;
+	private Gee.LinkedList<Job> d_queue;
+	private Gee.HashSet<string> d_names;
+	private Gee.HashSet<Job> d_running;
+	private int d_finished;
+	private bool d_cancelled;
+
+	private RemoteNotification? d_notification;
+	private uint d_progress_id;
+
+	public FetchScheduler(GitgExt.Application application, Ggit.RemoteDownloadTagsType? download_tags = null)
+	{
+		d_application = application;
+		d_download_tags = download_tags;
+
+		var settings = new Settings(Gitg.Config.APPLICATION_ID + ".preferences.general");
+		d_max_running = uint.max(settings.get_uint("fetch-concurrency"), 1);
+
+		d_jobs = new Gee.ArrayList<Job>();
+		d_queue = new Gee.LinkedList<Job>();
+		d_names = new Gee.HashSet<string>();
+		d_running = new Gee.HashSet<Job>();
+	}
+
+	/*
+	 * Schedule fetching the remote called name. Remotes are only fetched
+	 * once, adding a remote with priority moves it to the front.
+	 */
+	public void add(string name, bool priority = false)
+	{
+		if (d_names.contains(name))
+		{
+			if (priority)
+			{
+				foreach (var job in d_queue)
+				{
+					if (job.name == name)
+					{
+						d_queue.remove(job);
+						d_queue.offer_head(job);
+						break;
+					}
+				}
+			}
+
+			return;
+		}
+
+		var remote = d_application.remote_lookup.lookup(name);
+
+		if (remote == null)
+		{
+			return;
+		}
+
+		var job = new Job();
+
+		job.remote = remote;
+		job.name = name;
+		job.updates = new Gee.ArrayList<string>();
+
+		d_names.add(name);
+		d_jobs.add(job);
+
+		if (priority)
+		{
+			d_queue.offer_head(job);
+		}
+		else
+		{
+			d_queue.offer_tail(job);
+		}
+	}
+
+	private void update_text()
+	{
+		var names = new string[0];
+
+		foreach (var job in d_running)
+		{
+			names += Markup.escape_text(job.name);
+		}
+
+		if (d_cancelled)
+		{
+			/* Translators: %s is the list of remotes still being fetched from */
+			d_notification.text = _("Cancelling, waiting for %s").printf(string.joinv(", ", names));
+		}
+		else
+		{
+			/* Translators: %s is the list of remotes being fetched from, followed
+			 * by the number of remotes done and the total number of remotes */
+			d_notification.text = _("Fetching from %s (%d of %d)").printf(string.joinv(", ", names),
+			                                                              d_finished,
+			                                                              d_jobs.size);
+		}
+	}
+
+	private bool update_progress()
+	{
+		double progress = 0;
+
+		foreach (var job in d_jobs)
+		{
+			progress += job.done ? 1.0 : job.remote.transfer_progress;
+		}
+
+		var fraction = progress / d_jobs.size;
+
+		if (fraction != d_notification.fraction)
+		{
+			d_notification.fraction = fraction;
+		}
+
+		return true;
+	}
+
+	private async void fetch(Job job)
+	{
+		var tip_updated_id = job.remote.tip_updated.connect((remote, name, a, b) => {
+			if (a.is_zero())
+			{
+				/* Translators: new refers to a new remote reference having been fetched, */
+				job.updates.add(@"%s (%s)".printf(name, _("new")));
+			}
+			else
+			{
+				/* Translators: updated refers to a remote reference having been updated, */
+				job.updates.add(@"%s (%s)".printf(name, _("updated")));
+			}
+		});
+
+		try
+		{
+			yield job.remote.fetch(null, null, d_download_tags);
+		}
+		catch (Error e)
+		{
+			job.error = e.message;
+			stderr.printf("Failed to fetch from %s: %s\n", job.name, e.message);
+		}
+		finally
+		{
+			((Object)job.remote).disconnect(tip_updated_id);
+		}
+
+		job.done = true;
+	}
+
+	private async void work()
+	{
+		Job? job;
+
+		while (!d_cancelled && (job = d_queue.poll_head()) != null)
+		{
+			d_running.add(job);
+			update_text();
+
+			yield fetch(job);
+
+			d_running.remove(job);
+			d_finished++;
+		}
+	}
+
+	private void finish()
+	{
+		var failed = new string[0];
+		var updates = new string[0];
+
+		foreach (var job in d_jobs)
+		{
+			if (job.error != null)
+			{
+				failed += "<a href='%s'>%s</a>: <b>%s</b>".printf(job.remote.get_url(),
+				                                                  Markup.escape_text(job.name),
+				                                                  Markup.escape_text(job.error));
+			}
+			else if (job.done)
+			{
+				foreach (var update in job.updates)
+				{
+					updates += Markup.escape_text(update);
+				}
+			}
+		}
+
+		if (failed.length != 0)
+		{
+			/* Translators: %s is the list of remotes which failed, with the error */
+			d_notification.error(_("Failed to fetch from %s").printf(string.joinv(", ", failed)));
+		}
+		else if (d_cancelled)
+		{
+			/* Translators: the first %d is the number of remotes fetched from,
+			 * the second the number of remotes which were scheduled */
+			d_notification.error(_("Fetching cancelled after %d of %d remotes").printf(d_finished, d_jobs.size));
+		}
+		else if (updates.length == 0)
+		{
+			d_notification.success(_("Fetched from all remotes: <b>everything is up to date</b>"));
+		}
+		else
+		{
+			/* Translators: %s is a list of references that got updated. */
+			d_notification.success(_("Fetched from all remotes: %s").printf(string.joinv(", ", updates)));
+		}
+	}
+
+	/*
+	 * Fetch all scheduled remotes. Cancelling the notification stops
+	 * starting new fetches, the running fetches are finished.
+	 */
+	public async void run()
+	{
+		if (d_jobs.size == 0)
+		{
+			return;
+		}
+
+		d_notification = new RemoteNotification(null);
+		d_notification.remote_state = RemoteState.TRANSFERRING;
+
+		d_notification.cancel.connect(() => {
+			d_cancelled = true;
+			update_text();
+		});
+
+		d_application.notifications.add(d_notification);
+
+		d_progress_id = Timeout.add(PROGRESS_INTERVAL, update_progress);
+
+		SourceFunc callback = run.callback;
+		var workers = (int)uint.min(d_max_running, d_queue.size);
+		var running = workers;
+
+		for (var i = 0; i < workers; i++)
+		{
+			work.begin((obj, res) => {
+				work.end(res);
+
+				if (--running == 0)
+				{
+					callback();
+				}
+			});
+		}
+
+		yield;
+
+		Source.remove(d_progress_id);
+		d_progress_id = 0;
+
+		update_progress();
+		finish();
+	}
+}
+
+}
+
+// ex:set ts=4 noet
@@ -24,28 +24,110 @@ public class PluginsEngine : Peas.Engine
 {
 	private static PluginsEngine s_instance;
 
+	private bool d_builtins_loaded;
+
 	construct
 	{
-		enable_loader("python");
+		add_search_path(Dirs.user_plugins_dir,
+		                Dirs.user_plugins_data_dir);
 
-		var repo = Introspection.Repository.get_default();
+		add_search_path(Dirs.plugins_dir,
+		                Dirs.plugins_data_dir);
+
+		// The python loader and the introspection data it needs are only
+		// set up when there are python plugins
+		if (has_python_plugins())
+		{
+			enable_loader("python");
+
+			var repo = Introspection.Repository.get_default();
+
+			try
+			{
+				repo.require("Peas", "1.0", 0);
+				repo.require("PeasGtk", "1.0", 0);
+			}
+			catch (Error e)
+			{
+				warning("Could not load repository: %s", e.message);
+			}
+		}
+	}
+
+	private static bool is_python_plugin(string filename)
+	{
+		var keyfile = new KeyFile();
 
 		try
 		{
-			repo.require("Peas", "1.0", 0);
-			repo.require("PeasGtk", "1.0", 0);
+			keyfile.load_from_file(filename, KeyFileFlags.NONE);
+			return keyfile.get_string("Plugin", "Loader").has_prefix("python");
 		}
-		catch (Error e)
+		catch
 		{
-			warning("Could not load repository: %s", e.message);
-			return;
+			return false;
 		}
+	}
 
-		add_search_path(Dirs.user_plugins_dir,
-		                Dirs.user_plugins_data_dir);
+	// Like libpeas, look for .plugin files in the plugin directories and
+	// in their direct subdirectories
+	private static bool has_python_plugins_in(string dir, bool recurse)
+	{
+		Dir d;
 
-		add_search_path(Dirs.plugins_dir,
-		                Dirs.plugins_data_dir);
+		try
+		{
+			d = Dir.open(dir);
+		}
+		catch
+		{
+			return false;
+		}
+
+		string? name;
+
+		while ((name = d.read_name()) != null)
+		{
+			var filename = Path.build_filename(dir, name);
+
+			if (name.has_suffix(".plugin"))
+			{
+				if (is_python_plugin(filename))
+				{
+					return true;
+				}
+			}
+			else if (recurse && FileUtils.test(filename, FileTest.IS_DIR))
+			{
+				if (has_python_plugins_in(filename, false))
+				{
+					return true;
+				}
+			}
+		}
+
+		return false;
+	}
+
+	private static bool has_python_plugins()
+	{
+		return has_python_plugins_in(Dirs.user_plugins_dir, true) ||
+		       has_python_plugins_in(Dirs.plugins_dir, true);
+	}
+
+	/*
+	 * Load the builtin plugins, if they were not loaded yet. Extension sets
+	 * pick up plugins loaded after they were created, this only needs to
+	 * be called when the extensions are needed right away.
+	 */
+	public void load_builtins()
+	{
+		if (d_builtins_loaded)
+		{
+			return;
+		}
+
+		d_builtins_loaded = true;
 
 		Peas.PluginInfo[] builtins = new Peas.PluginInfo[20];
 		builtins.length = 0;
@@ -62,6 +144,8 @@ public class PluginsEngine : Peas.Engine
 		{
 			load_plugin(info);
 		}
+
+		StartupTiming.mark("builtin plugins");
 	}
 
 	public new static PluginsEngine get_default()
@@ -19,179 +19,355 @@
 namespace Gitg
 {
 
+/*
+ * Watches a directory and all directories below it. Directories rejected by
+ * the filter are not watched, and neither is anything below them. The filter
+ * is only called from threads, for directories before they are watched and
+ * for changed files before they are reported, and never for two files at
+ * once.
+ *
+ * Directories are searched for on a single thread at a time. Files created
+ * meanwhile are queued, and the ones which are directories are searched
+ * once the running search is done.
+ *
+ * Changes are collected and reported with the changed signal at most once
+ * per second. Each watched directory takes a watch from the system (an
+ * inotify watch on Linux), so at most max_watches directories are watched.
+ * By default that is half of the inotify watches available to the user,
+ * leaving the rest to other applications, or MAX_WATCHES when that is not
+ * known. When more directories are found, the directories below the
+ * location stop being watched and the overflow signal is emitted. From
+ * then on only changes directly in the location are reported, and users
+ * should check everything again instead of the reported files.
+ */
 class RecursiveMonitor : Object
 {
-	class Monitor : Object
-	{
-		public File location;
-		public RecursiveMonitor monitor;
+	public const uint MAX_WATCHES = 4096;
 
-		public Monitor(File location, RecursiveMonitor monitor)
-		{
-			this.location = location;
-			this.monitor = monitor;
-		}
-	}
+	private const string MAX_USER_WATCHES = "/proc/sys/fs/inotify/max_user_watches";
+
+	private const string ATTRIBUTES = FileAttribute.STANDARD_NAME + "," + FileAttribute.STANDARD_TYPE;
 
 	public delegate bool FilterFunc(File file);
 
-	private FileMonitor? d_monitor;
-	private Gee.List<Monitor> d_sub_monitors;
+	private File d_location;
+	private Gee.HashMap<File, FileMonitor> d_monitors;
+	private uint d_max_watches;
 	private uint d_monitor_changed_timeout_id;
 	private FilterFunc? d_filter_func;
+	private Mutex d_filter_mutex;
 	private Cancellable d_cancellable;
 	private File[] d_changed_files;
+	private Gee.HashSet<File> d_pending;
+	private bool d_searching;
+	private bool d_overflowed;
 
 	public signal void changed(File[] files);
+	public signal void overflow();
 
-	public RecursiveMonitor(File location, owned FilterFunc? filter_func = null)
+	public RecursiveMonitor(File location, owned FilterFunc? filter_func = null, uint max_watches = 0)
 	{
+		d_location = location;
 		d_filter_func = (owned)filter_func;
-		d_sub_monitors = new Gee.LinkedList<Monitor>();
+		d_max_watches = max_watches != 0 ? max_watches : default_max_watches();
+		d_monitors = new Gee.HashMap<File, FileMonitor>(File.hash, File.equal);
+		d_changed_files = new File[0];
+		d_pending = new Gee.HashSet<File>(File.hash, File.equal);
+		d_cancellable = new Cancellable();
+
+		watch(location);
+		add_directory(location);
+	}
+
+	private static uint default_max_watches()
+	{
+		string contents;
 
 		try
 		{
-			d_monitor = location.monitor_directory(FileMonitorFlags.NONE);
+			FileUtils.get_contents(MAX_USER_WATCHES, out contents);
 		}
-		catch {}
+		catch
+		{
+			return MAX_WATCHES;
+		}
+
+		var n = uint64.parse(contents.strip());
 
-		if (d_monitor != null)
+		if (n < 2)
 		{
-			d_monitor.changed.connect(monitor_changed_timeout);
+			return MAX_WATCHES;
 		}
 
-		d_cancellable = new Cancellable();
+		return (uint)uint64.min(n / 2, uint.MAX);
+	}
 
-		enumerate.begin(location, (obj, res) => {
-			try
-			{
-				enumerate.end(res);
-			} catch {}
-		});
+	public bool overflowed
+	{
+		get { return d_overflowed; }
 	}
 
-	private async void enumerate(File location) throws Error
+	private bool filter(File location)
 	{
-		var e = yield location.enumerate_children_async(FileAttribute.STANDARD_NAME + "," + FileAttribute.STANDARD_TYPE, FileQueryInfoFlags.NONE, Priority.DEFAULT, d_cancellable);
-		File[] allfiles = new File[0];
+		if (d_filter_func == null)
+		{
+			return true;
+		}
 
-		while (true)
+		d_filter_mutex.lock();
+		var ret = d_filter_func(location);
+		d_filter_mutex.unlock();
+
+		return ret;
+	}
+
+	/*
+	 * Find the directories to watch below location, and location itself when
+	 * include_location is set. Runs in a thread. Returns false when more than
+	 * limit directories were found.
+	 */
+	private bool find_directories(File location, bool include_location, int limit, Gee.ArrayList<File> directories)
+	{
+		if (include_location)
 		{
-			var files = yield e.next_files_async(10, Priority.DEFAULT);
+			try
+			{
+				var info = location.query_info(FileAttribute.STANDARD_TYPE, FileQueryInfoFlags.NOFOLLOW_SYMLINKS, d_cancellable);
 
-			if (files == null)
+				if (info.get_file_type() != FileType.DIRECTORY || !filter(location))
+				{
+					return true;
+				}
+			}
+			catch
 			{
-				break;
+				return true;
 			}
 
-			foreach (var f in files)
+			if (limit <= 0)
 			{
-				if (f.get_file_type() == FileType.DIRECTORY)
-				{
-					allfiles += location.get_child(f.get_name());
-				}
+				return false;
 			}
+
+			directories.add(location);
 		}
 
-		yield e.close_async(Priority.DEFAULT, d_cancellable);
+		var queue = new Gee.LinkedList<File>();
+		queue.offer_tail(location);
+
+		File? dir;
 
-		foreach (var f in allfiles)
+		while ((dir = queue.poll_head()) != null)
 		{
-			add_submonitor(f);
+			if (d_cancellable.is_cancelled())
+			{
+				break;
+			}
+
+			try
+			{
+				var e = dir.enumerate_children(ATTRIBUTES, FileQueryInfoFlags.NOFOLLOW_SYMLINKS, d_cancellable);
+				FileInfo? info;
+
+				while ((info = e.next_file(d_cancellable)) != null)
+				{
+					if (info.get_file_type() != FileType.DIRECTORY)
+					{
+						continue;
+					}
+
+					var child = dir.get_child(info.get_name());
+
+					if (!filter(child))
+					{
+						continue;
+					}
+
+					if (directories.size >= limit)
+					{
+						return false;
+					}
+
+					directories.add(child);
+					queue.offer_tail(child);
+				}
+
+				e.close(d_cancellable);
+			} catch {}
 		}
+
+		return true;
 	}
 
-	private void add_submonitor(File location)
+	// Watch location and the directories below it, if it is a directory
+	private void add_directory(File location)
 	{
-		if (d_filter_func != null && !d_filter_func(location))
+		if (d_overflowed)
 		{
 			return;
 		}
 
-		var mon = new RecursiveMonitor(location, (l) => {
-			return d_filter_func(l);
-		});
+		d_pending.add(location);
 
-		d_sub_monitors.add(new Monitor(location, mon));
-		mon.changed.connect((files) => { changed_timeout(files); });
+		if (!d_searching)
+		{
+			search_directories.begin((obj, res) => {
+				search_directories.end(res);
+			});
+		}
 	}
 
-	private void add_submonitor_if_directory(File location)
+	private async void search_directories()
 	{
-		try
+		d_searching = true;
+
+		while (d_pending.size != 0 && !d_overflowed && !d_cancellable.is_cancelled())
 		{
-			var info = location.query_info(FileAttribute.STANDARD_TYPE, FileQueryInfoFlags.NONE);
+			var locations = d_pending.to_array();
+			d_pending.clear();
+
+			var limit = (int)d_max_watches - d_monitors.size;
+			var directories = new Gee.ArrayList<File>(File.equal);
+			var found = true;
+
+			yield Async.thread_try(() => {
+				foreach (var location in locations)
+				{
+					// The location itself is watched already
+					var include_location = !location.equal(d_location);
+
+					if (!find_directories(location, include_location, limit, directories))
+					{
+						found = false;
+						break;
+					}
+				}
+			});
 
-			if (info.get_file_type() == FileType.DIRECTORY)
+			if (d_cancellable.is_cancelled())
 			{
-				add_submonitor(location);
+				break;
 			}
+
+			if (!found)
+			{
+				overflow_watches();
+				break;
+			}
+
+			foreach (var dir in directories)
+			{
+				watch(dir);
+			}
+		}
+
+		d_pending.clear();
+		d_searching = false;
+	}
+
+	private void watch(File location)
+	{
+		if (d_overflowed || d_monitors.has_key(location))
+		{
+			return;
+		}
+
+		// Other directories can be found while a directory is searched
+		if (d_monitors.size >= d_max_watches)
+		{
+			overflow_watches();
+			return;
+		}
+
+		try
+		{
+			var monitor = location.monitor_directory(FileMonitorFlags.NONE, d_cancellable);
+
+			monitor.changed.connect(monitor_changed);
+			d_monitors[location] = monitor;
 		}
 		catch {}
 	}
 
-	public override void dispose()
+	// Stop watching location and everything below it
+	private void unwatch(File location)
 	{
-		cancel();
-		base.dispose();
+		var it = d_monitors.map_iterator();
+
+		while (it.next())
+		{
+			var key = it.get_key();
+
+			if (!key.equal(d_location) && (key.equal(location) || key.has_prefix(location)))
+			{
+				it.get_value().cancel();
+				it.unset();
+			}
+		}
 	}
 
-	private void remove_submonitor(File location)
+	private void overflow_watches()
 	{
-		foreach (var monitor in d_sub_monitors)
+		if (d_overflowed)
+		{
+			return;
+		}
+
+		d_overflowed = true;
+
+		var it = d_monitors.map_iterator();
+
+		while (it.next())
 		{
-			if (location.equal(monitor.location))
+			if (!it.get_key().equal(d_location))
 			{
-				d_sub_monitors.remove(monitor);
-				return;
+				it.get_value().cancel();
+				it.unset();
 			}
 		}
+
+		overflow();
+	}
+
+	public override void dispose()
+	{
+		cancel();
+		base.dispose();
 	}
 
-	private void monitor_changed_timeout(File file, File? other_file, FileMonitorEvent event)
+	private void monitor_changed(File file, File? other_file, FileMonitorEvent event)
 	{
 		if (event == FileMonitorEvent.CREATED)
 		{
-			add_submonitor_if_directory(file);
+			add_directory(file);
 		}
 		else if (event == FileMonitorEvent.DELETED)
 		{
-			remove_submonitor(file);
+			unwatch(file);
 		}
 		else if (event == FileMonitorEvent.MOVED)
 		{
-			remove_submonitor(file);
+			unwatch(file);
 
 			if (other_file != null)
 			{
-				add_submonitor_if_directory(other_file);
+				add_directory(other_file);
 			}
 		}
 
-		changed_timeout(new File[] { file, other_file });
-	}
+		d_changed_files += file;
 
-	private void changed_timeout(File?[] files)
-	{
-		foreach (var f in files)
+		if (other_file != null)
 		{
-			if (f != null && (d_filter_func == null || d_filter_func(f)))
-			{
-				d_changed_files += f;
-			}
+			d_changed_files += other_file;
 		}
 
-		if (d_monitor_changed_timeout_id != 0)
-		{
-			return;
-		}
-
-		if (d_changed_files.length > 0)
+		if (d_monitor_changed_timeout_id == 0)
 		{
 			d_monitor_changed_timeout_id = Timeout.add_seconds(1, () => {
 				d_monitor_changed_timeout_id = 0;
 
-				changed(d_changed_files);
+				emit_changed((owned)d_changed_files);
 				d_changed_files = new File[0];
 
 				return false;
@@ -199,9 +375,32 @@ class RecursiveMonitor : Object
 		}
 	}
 
+	private void emit_changed(owned File[] files)
+	{
+		var accepted = new Gee.HashSet<File>(File.hash, File.equal);
+
+		Async.thread_try.begin(() => {
+			foreach (var f in files)
+			{
+				if (!accepted.contains(f) && filter(f))
+				{
+					accepted.add(f);
+				}
+			}
+		}, (obj, res) => {
+			Async.thread_try.end(res);
+
+			if (!d_cancellable.is_cancelled() && accepted.size != 0)
+			{
+				changed(accepted.to_array());
+			}
+		});
+	}
+
 	public void cancel()
 	{
 		d_cancellable.cancel();
+		d_pending.clear();
 
 		if (d_monitor_changed_timeout_id != 0)
 		{
@@ -209,18 +408,12 @@ class RecursiveMonitor : Object
 			d_monitor_changed_timeout_id = 0;
 		}
 
-		foreach (var monitor in d_sub_monitors)
+		foreach (var monitor in d_monitors.values)
 		{
-			monitor.monitor.cancel();
+			monitor.cancel();
 		}
 
-		d_sub_monitors.clear();
-
-		if (d_monitor != null)
-		{
-			d_monitor.cancel();
-			d_monitor = null;
-		}
+		d_monitors.clear();
 	}
 }
 
@@ -21,83 +21,443 @@ namespace Gitg
 
 interface RecursiveScanner : Object
 {
-	protected async virtual void scan_visit_file(File file, Cancellable? cancellable)
+	protected virtual void scan_visit_repository(File location)
 	{
 	}
 
-	protected bool scan_visit_directory_default(File file)
+	/*
+	 * Scan location for repositories, not descending into hidden
+	 * directories, repositories and directories named in skip.
+	 */
+	public async void scan(File location, string[]? skip = null, Cancellable? cancellable = null)
 	{
-		return !file.get_basename().has_prefix(".");
+		var scan = new RecursiveScan(location, skip, cancellable);
+
+		scan.found.connect((repository) => {
+			scan_visit_repository(repository);
+		});
+
+		yield scan.run();
+	}
+}
+
+/*
+ * A single scan of a directory tree. Directories are enumerated on a
+ * bounded number of threads, taking them from a shared queue. A directory
+ * with .git, or with objects, HEAD and refs, is a repository.
+ *
+ * Every directory seen is cached on disk with its modification time, its
+ * subdirectories and whether it is a repository. When the modification
+ * time of a directory did not change since the last scan, it is not
+ * enumerated again and the cached subdirectories are visited instead.
+ */
+class RecursiveScan : Object
+{
+	private const int MAX_THREADS = 4;
+	private const uint FOUND_FLUSH_INTERVAL = 100;
+
+	private class Entry
+	{
+		public uint64 mtime;
+		public bool repository;
+		public string[] children;
 	}
 
-	protected async virtual bool scan_visit_directory(File file, Cancellable? cancellable)
+	private File d_location;
+	private string? d_root;
+	private Gee.HashSet<string> d_skip;
+	private Cancellable? d_cancellable;
+
+	// Entries of the previous scans, only read while scanning
+	private Gee.HashMap<string, Entry> d_cache;
+
+	// Shared between the scanning threads, protected by d_mutex
+	private Mutex d_mutex;
+	private Cond d_cond;
+	private Gee.ArrayQueue<string> d_queue;
+	private int d_active;
+	private Gee.HashMap<string, Entry> d_entries;
+	private string[] d_found;
+
+	public signal void found(File repository);
+
+	public RecursiveScan(File location, string[]? skip, Cancellable? cancellable)
 	{
-		return scan_visit_directory_default(file);
+		d_location = location;
+		d_cancellable = cancellable;
+
+		d_skip = new Gee.HashSet<string>();
+
+		if (skip != null)
+		{
+			foreach (var name in skip)
+			{
+				d_skip.add(name);
+			}
+		}
+
+		d_queue = new Gee.ArrayQueue<string>();
+		d_entries = new Gee.HashMap<string, Entry>();
+		d_found = new string[0];
 	}
 
-	public async void scan(File location, Cancellable? cancellable = null)
+	private bool is_cancelled()
 	{
-		yield scan_real(location, cancellable, new Gee.HashSet<File>((file) => { return file.hash(); }, (file, other) => { return file.equal(other); }));
+		return d_cancellable != null && d_cancellable.is_cancelled();
 	}
 
-	private async void scan_real(File location, Cancellable? cancellable, Gee.HashSet<File> seen)
+	private static File cache_file()
 	{
-		if (cancellable != null && cancellable.is_cancelled())
+		return File.new_for_path(Path.build_filename(Environment.get_user_cache_dir(),
+		                                             "gitg",
+		                                             "repository-scan"));
+	}
+
+	private static Gee.HashMap<string, Entry> load_cache()
+	{
+		var ret = new Gee.HashMap<string, Entry>();
+		string contents;
+
+		try
 		{
-			return;
+			FileUtils.get_contents(cache_file().get_path(), out contents);
+		}
+		catch
+		{
+			return ret;
+		}
+
+		foreach (var line in contents.split("\n"))
+		{
+			var parts = line.split("\t");
+
+			if (parts.length != 4)
+			{
+				continue;
+			}
+
+			var entry = new Entry();
+
+			entry.mtime = uint64.parse(parts[0]);
+			entry.repository = parts[1] == "1";
+
+			var children = parts[3].compress();
+			entry.children = children != "" ? children.split("/") : new string[0];
+
+			ret[parts[2].compress()] = entry;
+		}
+
+		return ret;
+	}
+
+	private void save_cache(string root)
+	{
+		var builder = new StringBuilder();
+		var prefix = root + Path.DIR_SEPARATOR_S;
+
+		// Keep what was found below other locations
+		foreach (var item in d_cache.entries)
+		{
+			if (!item.key.has_prefix(prefix))
+			{
+				append_entry(builder, item.key, item.value);
+			}
 		}
 
-		FileEnumerator? e;
+		foreach (var item in d_entries.entries)
+		{
+			append_entry(builder, item.key, item.value);
+		}
+
+		var file = cache_file();
 
 		try
 		{
-			e = yield location.enumerate_children_async(FileAttribute.STANDARD_NAME + "," + FileAttribute.STANDARD_TYPE,
-		                                                FileQueryInfoFlags.NOFOLLOW_SYMLINKS,
-		                                                Priority.DEFAULT,
-		                                                cancellable);
-		} catch { return; }
+			DirUtils.create_with_parents(file.get_parent().get_path(), 0755);
+			FileUtils.set_contents(file.get_path(), builder.str);
+		}
+		catch (Error e)
+		{
+			stderr.printf("Failed to save repository scan cache: %s\n", e.message);
+		}
+	}
+
+	private static void append_entry(StringBuilder builder, string path, Entry entry)
+	{
+		builder.append_printf("%s\t%d\t%s\t%s\n",
+		                      entry.mtime.to_string(),
+		                      entry.repository ? 1 : 0,
+		                      path.escape(""),
+		                      string.joinv("/", entry.children).escape(""));
+	}
 
-		while (cancellable == null || !cancellable.is_cancelled())
+	/*
+	 * Read the entry of dir. With root set, dir is the directory being
+	 * scanned, which is not reported as a repository: its children are
+	 * always visited, even when it has a .git, like a home directory with
+	 * its dotfiles in a repository.
+	 */
+	private Entry? read_directory(File dir, uint64 mtime, bool root)
+	{
+		var entry = new Entry();
+		var children = new string[0];
+		bool objects = false;
+		bool head = false;
+		bool refs = false;
+
+		entry.mtime = mtime;
+
+		try
 		{
-			List<FileInfo>? files = null;
+			var e = dir.enumerate_children(FileAttribute.STANDARD_NAME + "," + FileAttribute.STANDARD_TYPE,
+			                               FileQueryInfoFlags.NOFOLLOW_SYMLINKS,
+			                               d_cancellable);
 
-			try
+			FileInfo? info;
+
+			while ((info = e.next_file(d_cancellable)) != null)
 			{
-				files = yield e.next_files_async(10, Priority.DEFAULT);
-			} catch {}
+				var name = info.get_name();
 
-			if (files == null) {
+				switch (name)
+				{
+				case ".git":
+					entry.repository = true;
+					break;
+				case "objects":
+					objects = true;
+					break;
+				case "HEAD":
+					head = true;
+					break;
+				case "refs":
+					refs = true;
+					break;
+				}
+
+				if (info.get_file_type() == FileType.DIRECTORY && !name.has_prefix("."))
+				{
+					children += name;
+				}
+			}
+		}
+		catch
+		{
+			return null;
+		}
+
+		if (objects && head && refs)
+		{
+			entry.repository = true;
+		}
+
+		if (root)
+		{
+			entry.repository = false;
+		}
+
+		// Repositories are not descended into
+		entry.children = entry.repository ? new string[0] : (owned)children;
+		return entry;
+	}
+
+	// Visit the directory at path, returns the subdirectories to visit
+	private string[] visit_directory(string path)
+	{
+		var dir = File.new_for_path(path);
+		uint64 mtime;
+
+		try
+		{
+			var info = dir.query_info(FileAttribute.TIME_MODIFIED + "," + FileAttribute.TIME_MODIFIED_USEC,
+			                          FileQueryInfoFlags.NOFOLLOW_SYMLINKS,
+			                          d_cancellable);
+
+			mtime = info.get_attribute_uint64(FileAttribute.TIME_MODIFIED) * 1000000 +
+			        info.get_attribute_uint32(FileAttribute.TIME_MODIFIED_USEC);
+		}
+		catch
+		{
+			return new string[0];
+		}
+
+		var root = path == d_root;
+
+		// The root is always read, its entry differs from the one it has
+		// when scanned below another location and is not cached
+		var entry = root ? null : d_cache[path];
+
+		if (entry == null || entry.mtime != mtime)
+		{
+			entry = read_directory(dir, mtime, root);
+
+			if (entry == null)
+			{
+				return new string[0];
+			}
+		}
+
+		var ret = new string[0];
+
+		foreach (var child in entry.children)
+		{
+			if (!d_skip.contains(child))
+			{
+				ret += Path.build_filename(path, child);
+			}
+		}
+
+		d_mutex.lock();
+
+		if (!root)
+		{
+			d_entries[path] = entry;
+		}
+
+		if (entry.repository)
+		{
+			d_found += path;
+		}
+
+		d_mutex.unlock();
+
+		return ret;
+	}
+
+	private void work()
+	{
+		d_mutex.lock();
+
+		while (true)
+		{
+			while (d_queue.is_empty && d_active != 0 && !is_cancelled())
+			{
+				d_cond.wait(d_mutex);
+			}
+
+			if (d_queue.is_empty || is_cancelled())
+			{
 				break;
 			}
 
-			foreach (var f in files)
+			var path = d_queue.poll();
+			d_active++;
+
+			d_mutex.unlock();
+			var children = visit_directory(path);
+			d_mutex.lock();
+
+			foreach (var child in children)
 			{
-				var file = location.get_child(f.get_name());
+				d_queue.offer(child);
+			}
 
-				if (seen.contains(file))
-				{
-					continue;
-				}
+			d_active--;
+			d_cond.broadcast();
+		}
 
-				seen.add(file);
+		// Wake up the other threads so they can finish too
+		d_cond.broadcast();
+		d_mutex.unlock();
+	}
 
-				yield scan_visit_file(file, cancellable);
+	private void flush_found()
+	{
+		d_mutex.lock();
 
-				if (f.get_file_type() == FileType.DIRECTORY)
-				{
-					if (!(yield scan_visit_directory(file, cancellable)))
+		var found = (owned)d_found;
+		d_found = new string[0];
+
+		d_mutex.unlock();
+
+		foreach (var path in found)
+		{
+			this.found(File.new_for_path(path));
+		}
+	}
+
+	public async void run()
+	{
+		var root = d_location.get_path();
+
+		if (root == null)
+		{
+			return;
+		}
+
+		d_root = root;
+
+		yield Async.thread_try(() => {
+			d_cache = load_cache();
+		});
+
+		SourceFunc callback = run.callback;
+		var running = MAX_THREADS;
+
+		d_queue.offer(root);
+
+		for (var t = 0; t < MAX_THREADS; t++)
+		{
+			try
+			{
+				new Thread<void *>.try("gitg-scan", () => {
+					work();
+
+					if (AtomicInt.dec_and_test(ref running))
 					{
-						continue;
+						Idle.add((owned)callback);
 					}
 
-					yield scan_real(file, cancellable, seen);
+					return null;
+				});
+			}
+			catch (Error e)
+			{
+				stderr.printf("Failed to start repository scan: %s\n", e.message);
+
+				if (AtomicInt.dec_and_test(ref running))
+				{
+					Idle.add((owned)callback);
 				}
 			}
 		}
 
-		try {
-			yield e.close_async(Priority.DEFAULT, cancellable);
-		} catch {}
+		// Cancelling wakes up threads waiting for work
+		ulong cancel_id = 0;
+
+		if (d_cancellable != null)
+		{
+			cancel_id = d_cancellable.connect(() => {
+				d_mutex.lock();
+				d_cond.broadcast();
+				d_mutex.unlock();
+			});
+		}
+
+		var flush_id = Timeout.add(FOUND_FLUSH_INTERVAL, () => {
+			flush_found();
+			return true;
+		});
+
+		yield;
+
+		Source.remove(flush_id);
+
+		if (d_cancellable != null)
+		{
+			d_cancellable.disconnect(cancel_id);
+		}
+
+		if (is_cancelled())
+		{
+			return;
+		}
+
+		flush_found();
+
+		yield Async.thread_try(() => {
+			save_cache(root);
+		});
 	}
 }
 
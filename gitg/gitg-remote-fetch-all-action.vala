@@ -55,18 +55,57 @@ class FetchAllRemotesAction : GitgExt.UIElement, GitgExt.Action, GitgExt.FetchAv
 		}
 	}
 
+	// Name of the remote of the upstream of the current branch
+	private string? upstream_remote_name()
+	{
+		try
+		{
+			var branch = application.repository.get_head() as Ggit.Branch;
+
+			if (branch != null)
+			{
+				var upstream = branch.get_upstream() as Gitg.Ref;
+
+				if (upstream != null)
+				{
+					return upstream.parsed_name.remote_name;
+				}
+			}
+		} catch {}
+
+		return null;
+	}
+
 	public void activate()
 	{
-		refs_list.references.foreach((r) => {
-			var remote_name = r.parsed_name.remote_name;
-			var remote = application.remote_lookup.lookup(remote_name);
-			Ggit.RemoteDownloadTagsType? download_tags = null;
-			if (no_tags)
-				download_tags = Ggit.RemoteDownloadTagsType.NONE;
-			remote.fetch.begin(null, null, download_tags, (obj, res) => {
-				remote.fetch.end(res);
-			});
-			return true;
+		Ggit.RemoteDownloadTagsType? download_tags = null;
+
+		if (no_tags)
+			download_tags = Ggit.RemoteDownloadTagsType.NONE;
+
+		var scheduler = new FetchScheduler(application, download_tags);
+		var upstream = upstream_remote_name();
+
+		if (upstream != null)
+		{
+			scheduler.add(upstream, true);
+		}
+
+		try
+		{
+			foreach (var name in application.repository.list_remotes())
+			{
+				scheduler.add(name);
+			}
+		}
+		catch (Error e)
+		{
+			stderr.printf("Failed to list remotes: %s\n", e.message);
+			return;
+		}
+
+		scheduler.run.begin((obj, res) => {
+			scheduler.run.end(res);
 		});
 	}
 }
@@ -43,12 +43,19 @@ public class RemoteNotification : ProgressBin, GitgExt.Notification
 
 	private string d_text;
 
-	public RemoteNotification(Remote remote)
+	/*
+	 * Without a remote, the state and the progress are set by the owner of
+	 * the notification.
+	 */
+	public RemoteNotification(Remote? remote)
 	{
 		d_remote = remote;
 
-		d_remote.bind_property("state", this, "remote_state");
-		d_remote.bind_property("transfer-progress", this, "fraction");
+		if (d_remote != null)
+		{
+			d_remote.bind_property("state", this, "remote_state");
+			d_remote.bind_property("transfer-progress", this, "fraction");
+		}
 	}
 
 	public Gtk.Widget? widget
@@ -0,0 +1,384 @@
+/*
+ * This file is part of gitg
+ *
+ * Copyright (C) 2026 - Alberto Fanjul
+ *
+ * gitg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gitg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gitg. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+namespace Gitg
+{
+
+/*
+ * Watches the git directory of a repository for changes to references,
+ * HEAD and the index. Only the git directory itself, logs/ and the
+ * directories below refs/ are watched, with one directory monitor each,
+ * kept in a table by path. Changes are collected for a while and emitted
+ * at once, with the names of the references which changed. Changes to
+ * packed-refs are resolved to the references whose entries changed.
+ */
+class RepositoryMonitor : Object
+{
+	private const uint COALESCE_INTERVAL = 1000;
+
+	private File d_location;
+	private Gee.TreeMap<string, FileMonitor> d_monitors;
+	private Cancellable d_cancellable;
+	private uint d_timeout_id;
+
+	private GitgExt.ExternalChangeHint d_hint;
+	private Gee.HashSet<string> d_refs;
+	private Gee.HashMap<string, File> d_files;
+	private bool d_packed_refs_changed;
+
+	// Target of each reference in packed-refs, only used on threads
+	private Gee.HashMap<string, string> d_packed_refs;
+
+	public signal void changed(GitgExt.ExternalChangeHint hint, string[] refs, File[] files);
+
+	public RepositoryMonitor(File location)
+	{
+		d_location = location;
+		d_monitors = new Gee.TreeMap<string, FileMonitor>();
+		d_cancellable = new Cancellable();
+
+		d_refs = new Gee.HashSet<string>();
+		d_files = new Gee.HashMap<string, File>();
+		d_packed_refs = new Gee.HashMap<string, string>();
+
+		add_watch("");
+		add_watch("logs");
+
+		start.begin((obj, res) => {
+			start.end(res);
+		});
+	}
+
+	private async void start()
+	{
+		yield Async.thread_try(() => {
+			lock (d_packed_refs)
+			{
+				read_packed_refs();
+			}
+		});
+
+		yield watch_tree("refs", false);
+	}
+
+	public void cancel()
+	{
+		d_cancellable.cancel();
+
+		if (d_timeout_id != 0)
+		{
+			Source.remove(d_timeout_id);
+			d_timeout_id = 0;
+		}
+
+		foreach (var monitor in d_monitors.values)
+		{
+			monitor.cancel();
+		}
+
+		d_monitors.clear();
+	}
+
+	private void add_watch(string path)
+	{
+		if (d_monitors.has_key(path))
+		{
+			return;
+		}
+
+		var location = path == "" ? d_location : d_location.resolve_relative_path(path);
+
+		try
+		{
+			var monitor = location.monitor_directory(FileMonitorFlags.NONE, d_cancellable);
+
+			monitor.changed.connect(on_monitor_changed);
+			d_monitors[path] = monitor;
+		} catch {}
+	}
+
+	private void remove_watches(string path)
+	{
+		var remove = new string[0];
+
+		if (d_monitors.has_key(path))
+		{
+			remove += path;
+		}
+
+		var prefix = path + "/";
+
+		foreach (var key in d_monitors.ascending_keys.tail_set(prefix))
+		{
+			if (!key.has_prefix(prefix))
+			{
+				break;
+			}
+
+			remove += key;
+		}
+
+		foreach (var key in remove)
+		{
+			FileMonitor monitor;
+
+			d_monitors.unset(key, out monitor);
+			monitor.cancel();
+		}
+	}
+
+	private static void collect(File location, string path, ref string[] directories, ref string[] files) throws Error
+	{
+		directories += path;
+
+		var e = location.enumerate_children(FileAttribute.STANDARD_NAME + "," + FileAttribute.STANDARD_TYPE,
+		                                    FileQueryInfoFlags.NOFOLLOW_SYMLINKS);
+
+		FileInfo? info;
+
+		while ((info = e.next_file()) != null)
+		{
+			var name = info.get_name();
+
+			if (info.get_file_type() == FileType.DIRECTORY)
+			{
+				collect(location.get_child(name), @"$path/$name", ref directories, ref files);
+			}
+			else
+			{
+				files += @"$path/$name";
+			}
+		}
+	}
+
+	/*
+	 * Watch the directory at path and all directories below it. With report
+	 * set, the references already in there are reported as changed, they
+	 * may have been written before the directory was watched.
+	 */
+	private async void watch_tree(string path, bool report)
+	{
+		var directories = new string[0];
+		var files = new string[0];
+
+		yield Async.thread_try(() => {
+			collect(d_location.resolve_relative_path(path), path, ref directories, ref files);
+		});
+
+		if (d_cancellable.is_cancelled())
+		{
+			return;
+		}
+
+		foreach (var directory in directories)
+		{
+			add_watch(directory);
+		}
+
+		if (report)
+		{
+			foreach (var file in files)
+			{
+				add_change(d_location.resolve_relative_path(file));
+			}
+		}
+	}
+
+	private void on_monitor_changed(File file, File? other_file, FileMonitorEvent event)
+	{
+		if (event == FileMonitorEvent.ATTRIBUTE_CHANGED)
+		{
+			return;
+		}
+
+		var path = d_location.get_relative_path(file);
+
+		if (path == null)
+		{
+			return;
+		}
+
+		if (event == FileMonitorEvent.CREATED && path.has_prefix("refs/") &&
+		    file.query_file_type(FileQueryInfoFlags.NOFOLLOW_SYMLINKS) == FileType.DIRECTORY)
+		{
+			watch_tree.begin(path, true, (obj, res) => {
+				watch_tree.end(res);
+			});
+
+			return;
+		}
+
+		if (event == FileMonitorEvent.DELETED || event == FileMonitorEvent.MOVED)
+		{
+			remove_watches(path);
+		}
+
+		add_change(file);
+
+		if (other_file != null)
+		{
+			add_change(other_file);
+		}
+	}
+
+	private void add_change(File file)
+	{
+		var path = d_location.get_relative_path(file);
+
+		if (path == null || path.has_suffix(".lock"))
+		{
+			return;
+		}
+
+		switch (path)
+		{
+		case "HEAD":
+		case "logs/HEAD":
+			d_hint |= GitgExt.ExternalChangeHint.REFS | GitgExt.ExternalChangeHint.HEAD;
+			d_refs.add("HEAD");
+			break;
+		case "index":
+			d_hint |= GitgExt.ExternalChangeHint.INDEX;
+			break;
+		case "packed-refs":
+			d_hint |= GitgExt.ExternalChangeHint.REFS;
+			d_packed_refs_changed = true;
+			break;
+		case "FETCH_HEAD":
+			d_refs.add("FETCH_HEAD");
+			break;
+		default:
+			if (!path.has_prefix("refs/"))
+			{
+				return;
+			}
+
+			d_hint |= GitgExt.ExternalChangeHint.REFS;
+
+			// A deleted directory can't be told apart from a deleted
+			// reference, so its name may be reported as well
+			if (file.query_file_type(FileQueryInfoFlags.NOFOLLOW_SYMLINKS) != FileType.DIRECTORY)
+			{
+				d_refs.add(path);
+			}
+
+			break;
+		}
+
+		d_files[path] = file;
+
+		if (d_timeout_id == 0)
+		{
+			d_timeout_id = Timeout.add(COALESCE_INTERVAL, () => {
+				d_timeout_id = 0;
+
+				emit_changes.begin((obj, res) => {
+					emit_changes.end(res);
+				});
+
+				return false;
+			});
+		}
+	}
+
+	private async void emit_changes()
+	{
+		var hint = d_hint;
+		var refs = d_refs;
+		var files = d_files.values.to_array();
+		var packed_refs_changed = d_packed_refs_changed;
+
+		d_hint = GitgExt.ExternalChangeHint.NONE;
+		d_refs = new Gee.HashSet<string>();
+		d_files = new Gee.HashMap<string, File>();
+		d_packed_refs_changed = false;
+
+		if (packed_refs_changed)
+		{
+			yield Async.thread_try(() => {
+				lock (d_packed_refs)
+				{
+					refs.add_all(read_packed_refs());
+				}
+			});
+
+			if (d_cancellable.is_cancelled())
+			{
+				return;
+			}
+		}
+
+		changed(hint, refs.to_array(), files);
+	}
+
+	/*
+	 * Read packed-refs, and return the names of the references which were
+	 * added, removed or changed since it was last read.
+	 */
+	private string[] read_packed_refs()
+	{
+		var packed_refs = new Gee.HashMap<string, string>();
+		var ret = new string[0];
+
+		try
+		{
+			var stream = new DataInputStream(d_location.get_child("packed-refs").read());
+			string? line;
+
+			while ((line = stream.read_line()) != null)
+			{
+				// Skip the header and peeled tags
+				if (line.has_prefix("#") || line.has_prefix("^"))
+				{
+					continue;
+				}
+
+				var parts = line.split(" ", 2);
+
+				if (parts.length == 2)
+				{
+					packed_refs[parts[1]] = parts[0];
+				}
+			}
+		} catch {}
+
+		foreach (var entry in packed_refs.entries)
+		{
+			if (d_packed_refs[entry.key] != entry.value)
+			{
+				ret += entry.key;
+			}
+		}
+
+		foreach (var name in d_packed_refs.keys)
+		{
+			if (!packed_refs.has_key(name))
+			{
+				ret += name;
+			}
+		}
+
+		d_packed_refs = packed_refs;
+		return ret;
+	}
+}
+
+}
+
+// ex:ts=4 noet
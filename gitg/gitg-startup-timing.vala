@@ -0,0 +1,116 @@
+/*
+ * This file is part of gitg
+ *
+ * Copyright (C) 2026 - Alberto Fanjul
+ *
+ * gitg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gitg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gitg. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+namespace Gitg
+{
+
+/*
+ * Measures the phases of starting up, until the first window is drawn.
+ * Each mark attributes the time since the previous mark to the named
+ * phase. The report is printed on stderr when GITG_STARTUP_TIMING is set.
+ */
+class StartupTiming
+{
+	private class Phase
+	{
+		public string name;
+		public double elapsed;
+	}
+
+	private static Timer? s_timer;
+	private static double s_last;
+	private static Phase[] s_phases;
+	private static bool s_finished;
+
+	public static void start()
+	{
+		s_timer = new Timer();
+		s_last = 0;
+		s_phases = new Phase[0];
+	}
+
+	public static void mark(string name)
+	{
+		if (s_timer == null || s_finished)
+		{
+			return;
+		}
+
+		var now = s_timer.elapsed();
+
+		var phase = new Phase();
+		phase.name = name;
+		phase.elapsed = now - s_last;
+
+		s_phases += phase;
+		s_last = now;
+	}
+
+	// Marks the first frame of window, and reports when it is drawn
+	public static void finish_on_draw(Gtk.Widget window)
+	{
+		if (s_timer == null || s_finished)
+		{
+			return;
+		}
+
+		ulong id = 0;
+
+		id = window.draw.connect_after((w, cr) => {
+			window.disconnect(id);
+
+			Idle.add(() => {
+				mark("first frame");
+				finish();
+				return false;
+			});
+
+			return false;
+		});
+	}
+
+	private static void finish()
+	{
+		if (s_finished)
+		{
+			return;
+		}
+
+		s_finished = true;
+		s_timer.stop();
+
+		if (Environment.get_variable("GITG_STARTUP_TIMING") == null)
+		{
+			return;
+		}
+
+		stderr.printf("Startup timing:\n");
+
+		foreach (var phase in s_phases)
+		{
+			stderr.printf("  %-24s %8.1f ms\n", phase.name, phase.elapsed * 1000);
+		}
+
+		stderr.printf("  %-24s %8.1f ms\n", "total", s_last * 1000);
+	}
+}
+
+}
+
+// ex:set ts=4 noet
@@ -29,6 +29,11 @@ public class UIElements<T> : Object
 	private Gtk.Stack d_stack;
 	private Gee.HashMap<string, int> d_builtin_elements;
 
+	// With lazy set, the stack holds a placeholder for each element, its
+	// widget is only created when it is shown for the first time
+	private bool d_lazy;
+	private Gee.HashMap<string, Gtk.Box> d_placeholders;
+
 	public T? current
 	{
 		get
@@ -137,7 +142,8 @@ public class UIElements<T> : Object
 
 		if (d_stack != null)
 		{
-			d_stack.set_visible_child(element.widget);
+			d_stack.set_visible_child(stack_child(element));
+			build_widget(element);
 		}
 
 		notify_property("current");
@@ -156,7 +162,8 @@ public class UIElements<T> : Object
 			d_current = null;
 		}
 
-		d_stack.remove(e.widget);
+		d_stack.remove(stack_child(e));
+		d_placeholders.unset(e.id);
 		d_available_elements.remove(e);
 	}
 
@@ -181,6 +188,44 @@ public class UIElements<T> : Object
 		return a.negotiate_order(b) > 0;
 	}
 
+	private Gtk.Widget stack_child(GitgExt.UIElement e)
+	{
+		if (!d_lazy)
+		{
+			return e.widget;
+		}
+
+		var placeholder = d_placeholders[e.id];
+
+		if (placeholder == null)
+		{
+			placeholder = new Gtk.Box(Gtk.Orientation.VERTICAL, 0);
+			placeholder.sensitive = e.enabled;
+			placeholder.show();
+
+			d_placeholders[e.id] = placeholder;
+		}
+
+		return placeholder;
+	}
+
+	private void build_widget(GitgExt.UIElement e)
+	{
+		var placeholder = d_placeholders[e.id];
+
+		if (placeholder == null || placeholder.get_children() != null)
+		{
+			return;
+		}
+
+		var widget = e.widget;
+
+		if (widget != null)
+		{
+			placeholder.pack_start(widget, true, true, 0);
+		}
+	}
+
 	private void add_available(GitgExt.UIElement e)
 	{
 		int insert_position = 0;
@@ -194,7 +239,7 @@ public class UIElements<T> : Object
 
 		d_available_elements.insert(e, insert_position);
 
-		d_stack.add_with_properties(e.widget,
+		d_stack.add_with_properties(stack_child(e),
 		                            "name", e.id,
 		                            "title", e.description,
 		                            "icon-name", e.icon,
@@ -209,7 +254,7 @@ public class UIElements<T> : Object
 	private void enabled_changed(Object o, ParamSpec spec)
 	{
 		var e = o as GitgExt.UIElement;
-		e.widget.sensitive = e.enabled;
+		stack_child(e).sensitive = e.enabled;
 	}
 
 	private void on_element_activate(GitgExt.UIElement e)
@@ -291,11 +336,14 @@ public class UIElements<T> : Object
 
 	public UIElements.with_builtin(T[] builtin,
 	                               Peas.ExtensionSet extensions,
-	                               Gtk.Stack? stack = null)
+	                               Gtk.Stack? stack = null,
+	                               bool lazy = false)
 	{
 		d_extensions = extensions;
 		d_stack = stack;
+		d_lazy = lazy && stack != null;
 		d_builtin_elements = new Gee.HashMap<string, int>();
+		d_placeholders = new Gee.HashMap<string, Gtk.Box>();
 
 		d_elements = new Gee.HashMap<string, GitgExt.UIElement>();
 
@@ -29,7 +29,7 @@ public class Window : Gtk.ApplicationWindow, GitgExt.Application, Initable
 	private Settings d_state_settings;
 	private Settings d_interface_settings;
 	private Repository? d_repository;
-	private RecursiveMonitor? d_repository_monitor;
+	private RepositoryMonitor? d_repository_monitor;
 	private GitgExt.MessageBus d_message_bus;
 	private string? d_action;
 	private Gee.HashMap<string, string> d_environment;
@@ -719,34 +719,6 @@ public class Window : Gtk.ApplicationWindow, GitgExt.Application, Initable
 		return base.configure_event(event);
 	}
 
-	private GitgExt.ExternalChangeHint external_change_hint_from_file(File location)
-	{
-		var l = d_repository.get_location();
-
-		var refs = l.get_child("refs");
-		var index = l.get_child("index");
-		var head = l.get_child("HEAD");
-
-		if (location.equal(refs) || location.has_prefix(refs) || location.equal(head))
-		{
-			return GitgExt.ExternalChangeHint.REFS;
-		}
-		else if (location.equal(index))
-		{
-			return GitgExt.ExternalChangeHint.INDEX;
-		}
-		else
-		{
-			return GitgExt.ExternalChangeHint.NONE;
-		}
-
-	}
-
-	private bool filter_repository_changes(File location)
-	{
-		return external_change_hint_from_file(location) != GitgExt.ExternalChangeHint.NONE;
-	}
-
 	private void set_repository_internal(Repository? repository)
 	{
 		if (d_repository_monitor != null)
@@ -792,16 +764,17 @@ public class Window : Gtk.ApplicationWindow, GitgExt.Application, Initable
 
 		if (enable_monitoring && d_repository != null)
 		{
-			d_repository_monitor = new RecursiveMonitor(d_repository.get_location(), filter_repository_changes);
-			d_repository_monitor.changed.connect((files) => {
-				var hint = GitgExt.ExternalChangeHint.NONE;
-
-				foreach (var f in files)
+			d_repository_monitor = new RepositoryMonitor(d_repository.get_location());
+			d_repository_monitor.changed.connect((hint, refs, files) => {
+				if (hint != GitgExt.ExternalChangeHint.NONE)
 				{
-					hint |= external_change_hint_from_file(f);
+					repository_changed_externally(hint);
 				}
 
-				repository_changed_externally(hint);
+				if (refs.length != 0)
+				{
+					repository_refs_changed_externally(refs);
+				}
 			});
 		}
 	}
@@ -1037,6 +1010,8 @@ public class Window : Gtk.ApplicationWindow, GitgExt.Application, Initable
 
 	private bool init(Cancellable? cancellable)
 	{
+		StartupTiming.mark("open repository");
+
 		// Settings
 		var app = application as Gitg.Application;
 		d_state_settings = app.state_settings;
@@ -1058,9 +1033,11 @@ public class Window : Gtk.ApplicationWindow, GitgExt.Application, Initable
 		                                   "application",
 		                                   this);
 
+		// Activities which are not shown are only built when first shown
 		d_activities = new UIElements<GitgExt.Activity>.with_builtin(builtins,
 		                                                             extset,
-		                                                             d_stack_activities);
+		                                                             d_stack_activities,
+		                                                             true);
 
 		var history_panels = ((GitgHistory.Activity) builtins[0]).d_panels;
 
@@ -1089,6 +1066,7 @@ public class Window : Gtk.ApplicationWindow, GitgExt.Application, Initable
 			this.get_style_context().add_class("devel");
 		}
 
+		StartupTiming.mark("activities");
 		return true;
 	}
 
@@ -1384,6 +1362,7 @@ public class Window : Gtk.ApplicationWindow, GitgExt.Application, Initable
 			command_lines.apply(this);
 		}
 
+		StartupTiming.finish_on_draw(this);
 		base.present();
 	}
 
@@ -26,6 +26,8 @@ public class Main
 {
 	public static int main(string[] args)
 	{
+		StartupTiming.start();
+
 		Gtk.disable_setlocale();
 
 		Intl.setlocale(LocaleCategory.ALL, "");
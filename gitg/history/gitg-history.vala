@@ -616,7 +616,11 @@ namespace GitgHistory
 
 			d_main.refs_list.row_activated.connect(on_ref_list_row_activated);
 
+			Gitg.StartupTiming.mark("history view");
+
+			// The panels need to be there for the first selected commit
 			var engine = Gitg.PluginsEngine.get_default();
+			engine.load_builtins();
 
 			var extset = new Peas.ExtensionSet(engine,
 			                                   typeof(GitgExt.HistoryPanel),
@@ -628,6 +632,8 @@ namespace GitgHistory
 			_d_panels = new Gitg.UIElements<GitgExt.HistoryPanel>(extset,
 			                                                     d_main.stack_panel);
 
+			Gitg.StartupTiming.mark("history panels");
+
 			d_refs_list_popup = new Gitg.PopupMenu(d_main.refs_list);
 			d_refs_list_popup.populate_menu.connect(on_refs_list_populate_menu);
 
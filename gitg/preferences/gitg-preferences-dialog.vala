@@ -56,6 +56,8 @@ class PreferencesDialog : Gtk.Dialog, Gtk.Buildable
 	public void populate(Gitg.CommitListView commit_list_view = null)
 	{
 		var engine = PluginsEngine.get_default();
+		engine.load_builtins();
+
 		var ext = new Peas.ExtensionSet(engine, typeof(GitgExt.Preferences));
 
 		var pages = new HashTable<string, Gtk.Box>(str_hash, str_equal);
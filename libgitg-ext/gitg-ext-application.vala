@@ -36,6 +36,13 @@ public interface Application : Object
 	public abstract Gitg.Repository? repository { owned get; set; }
 
 	public signal void repository_changed_externally(ExternalChangeHint hint);
+
+	/**
+	 * Emitted when references of the current repository were changed
+	 * outside of gitg, with their full names (e.g. refs/heads/main, HEAD
+	 * or FETCH_HEAD). Names of references which were deleted are included.
+	 */
+	public signal void repository_refs_changed_externally(string[] refs);
 	public signal void repository_commits_changed();
 
 	/**
@@ -98,7 +105,8 @@ public enum ExternalChangeHint
 	NONE = 0,
 
 	REFS  = 1 << 0,
-	INDEX = 1 << 1
+	INDEX = 1 << 1,
+	HEAD  = 1 << 2
 }
 
 }
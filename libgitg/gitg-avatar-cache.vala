@@ -17,19 +17,86 @@
  * along with gitg. If not, see <http://www.gnu.org/licenses/>.
  */
 
+/*
+ * Avatars by email address, from gravatar. Avatars are kept on disk in the
+ * user cache directory for a week, and the addresses without an avatar
+ * for a day. Decoded avatars are kept in memory up to MAX_MEMORY bytes,
+ * dropping the least recently used ones first. Requests for an avatar
+ * which is already being loaded wait for that load, and at most
+ * MAX_DOWNLOADS avatars are downloaded at the same time.
+ */
 public class Gitg.AvatarCache : Object
 {
-	private Gee.HashMap<string, Gdk.Pixbuf?> d_cache;
+	private const string GRAVATAR_URI = "https://www.gravatar.com/avatar/{id}?d=404&s={size}";
+
+	private const int MAX_DOWNLOADS = 4;
+	private const size_t MAX_MEMORY = 16 * 1024 * 1024;
+	private const int64 EXPIRE_FOUND = 7 * 24 * 3600;
+	private const int64 EXPIRE_MISSING = 24 * 3600;
+
+	// Memory accounted for an address without an avatar
+	private const size_t MISSING_SIZE = 64;
+
+	private class Item
+	{
+		public Gdk.Pixbuf? pixbuf;
+		public size_t size;
+		public uint64 used;
+	}
+
+	private class Waiter
+	{
+		public SourceFunc callback;
+	}
+
+	private class Request
+	{
+		public Gdk.Pixbuf? pixbuf;
+		public Gee.ArrayList<Waiter> waiters = new Gee.ArrayList<Waiter>();
+	}
+
+	private string d_uri_template;
+	private File d_cache_dir;
+
+	private Gee.HashMap<string, Item> d_cache;
+	private size_t d_memory;
+	private uint64 d_tick;
+
+	private Gee.HashMap<string, Request> d_requests;
+	private int d_downloads;
+	private Gee.ArrayQueue<Waiter> d_waiting;
+
 	private static AvatarCache? s_instance;
 
 	construct
 	{
-		d_cache = new Gee.HashMap<string, Gdk.Pixbuf>();
+		d_cache = new Gee.HashMap<string, Item>();
+		d_requests = new Gee.HashMap<string, Request>();
+		d_waiting = new Gee.ArrayQueue<Waiter>();
 	}
 
 	private AvatarCache()
 	{
 		Object();
+
+		d_uri_template = GRAVATAR_URI;
+		d_cache_dir = File.new_for_path(Path.build_filename(Environment.get_user_cache_dir(),
+		                                                    "gitg",
+		                                                    "avatars"));
+	}
+
+	/**
+	 * Create a cache downloading avatars from uri_template, in which {id}
+	 * and {size} are replaced by the gravatar id and the size of the
+	 * avatar, and keeping them in cache_dir. The default cache should be
+	 * used instead, this is meant for testing.
+	 */
+	public AvatarCache.with_locations(string uri_template, File cache_dir)
+	{
+		Object();
+
+		d_uri_template = uri_template;
+		d_cache_dir = cache_dir;
 	}
 
 	public static AvatarCache @default()
@@ -47,80 +114,270 @@ public class Gitg.AvatarCache : Object
 		var id = Checksum.compute_for_string(ChecksumType.MD5, email.down());
 
 		var ckey = @"$id $size";
+		var entry = d_cache[ckey];
 
-		if (d_cache.has_key(ckey))
+		if (entry != null)
 		{
-			return d_cache[ckey];
+			entry.used = ++d_tick;
+			return entry.pixbuf;
 		}
 
-		var gravatar = @"https://www.gravatar.com/avatar/$(id)?d=404&s=$(size)";
-		var gfile = File.new_for_uri(gravatar);
+		var request = d_requests[ckey];
 
-		var pixbuf = yield read_avatar_from_file(id, gfile, size, cancellable);
+		if (request != null)
+		{
+			// Already being loaded, wait for it
+			var waiter = new Waiter();
+			waiter.callback = load.callback;
 
-		d_cache[ckey] = pixbuf;
-		return pixbuf;
+			request.waiters.add(waiter);
+			yield;
+		}
+		else
+		{
+			request = new Request();
+			d_requests[ckey] = request;
+
+			request.pixbuf = yield fetch(id, size);
+
+			d_requests.unset(ckey);
+			remember(ckey, request.pixbuf);
+
+			foreach (var waiter in request.waiters)
+			{
+				Idle.add((owned)waiter.callback);
+			}
+		}
+
+		if (cancellable != null && cancellable.is_cancelled())
+		{
+			return null;
+		}
+
+		return request.pixbuf;
 	}
 
-	private async Gdk.Pixbuf? read_avatar_from_file(string       id,
-	                                                File         file,
-	                                                int          size,
-	                                                Cancellable? cancellable)
+	private void remember(string ckey, Gdk.Pixbuf? pixbuf)
 	{
-		InputStream stream;
+		var entry = new Item();
+
+		entry.pixbuf = pixbuf;
+		entry.size = pixbuf != null ? (size_t)pixbuf.get_byte_length() : MISSING_SIZE;
+		entry.used = ++d_tick;
+
+		d_cache[ckey] = entry;
+		d_memory += entry.size;
+
+		if (d_memory > MAX_MEMORY)
+		{
+			evict();
+		}
+	}
+
+	// Drop the least recently used avatars, leaving some room
+	private void evict()
+	{
+		var entries = new Gee.ArrayList<Gee.Map.Entry<string, Item>>();
+		entries.add_all(d_cache.entries);
+
+		entries.sort((a, b) => {
+			return a.value.used < b.value.used ? -1 : (a.value.used > b.value.used ? 1 : 0);
+		});
+
+		var keys = new string[0];
+
+		foreach (var e in entries)
+		{
+			if (d_memory <= MAX_MEMORY / 4 * 3)
+			{
+				break;
+			}
 
+			d_memory -= e.value.size;
+			keys += e.key;
+		}
+
+		foreach (var key in keys)
+		{
+			d_cache.unset(key);
+		}
+	}
+
+	private async bool is_fresh(File file, int64 max_age)
+	{
 		try
 		{
-			stream = yield Gitg.PlatformSupport.http_get(file, cancellable);
+			var info = yield file.query_info_async(FileAttribute.TIME_MODIFIED,
+			                                       FileQueryInfoFlags.NONE,
+			                                       Priority.LOW);
+
+			var mtime = (int64)info.get_attribute_uint64(FileAttribute.TIME_MODIFIED);
+			return new DateTime.now_utc().to_unix() - mtime < max_age;
 		}
-		catch(Error e)
+		catch
 		{
-			debug("Can not retrieve avatar from %s: %s", file.get_path(), e.message);
-			return null;
+			return false;
 		}
+	}
+
+	private async void store(File file, uint8[] contents)
+	{
+		try
+		{
+			d_cache_dir.make_directory_with_parents();
+		} catch {}
 
-		uint8[] buffer = new uint8[4096];
+		try
+		{
+			yield file.replace_contents_async(contents, null, false, FileCreateFlags.REPLACE_DESTINATION, null, null);
+		}
+		catch (Error e)
+		{
+			debug("Can not store avatar in %s: %s", file.get_path(), e.message);
+		}
+	}
+
+	private Gdk.Pixbuf? decode(uint8[] contents, int size)
+	{
 		var loader = new Gdk.PixbufLoader();
 
 		loader.set_size(size, size);
 
-		return yield read_avatar(id, stream, buffer, loader, cancellable);
+		try
+		{
+			loader.write(contents);
+			loader.close();
+		}
+		catch
+		{
+			return null;
+		}
+
+		return loader.get_pixbuf();
 	}
 
-	private async Gdk.Pixbuf? read_avatar(string           id,
-	                                      InputStream      stream,
-	                                      uint8[]          buffer,
-	                                      Gdk.PixbufLoader loader,
-	                                      Cancellable?     cancellable)
+	private async Gdk.Pixbuf? fetch(string id, int size)
 	{
-		ssize_t n;
+		var name = @"$id-$size";
+		var file = d_cache_dir.get_child(name);
+		var missing = d_cache_dir.get_child(name + ".missing");
 
-		try
+		if (yield is_fresh(missing, EXPIRE_MISSING))
 		{
-			n = yield stream.read_async(buffer, Priority.LOW, cancellable);
+			return null;
 		}
-		catch { return null; }
 
-		if (n != 0)
+		if (yield is_fresh(file, EXPIRE_FOUND))
 		{
 			try
 			{
-				loader.write(buffer[0:n]);
-			}
-			catch { return null; }
+				uint8[] contents;
+
+				yield file.load_contents_async(null, out contents, null);
+
+				var pixbuf = decode(contents, size);
+
+				if (pixbuf != null)
+				{
+					return pixbuf;
+				}
+			} catch {}
+		}
+
+		yield acquire();
+		var pixbuf = yield download(id, size, file, missing);
+		release();
+
+		return pixbuf;
+	}
+
+	private async void acquire()
+	{
+		if (d_downloads < MAX_DOWNLOADS)
+		{
+			d_downloads++;
+			return;
+		}
+
+		var waiter = new Waiter();
+		waiter.callback = acquire.callback;
+
+		d_waiting.offer(waiter);
+		yield;
+	}
+
+	private void release()
+	{
+		var waiter = d_waiting.poll();
 
-			return yield read_avatar(id, stream, buffer, loader, cancellable);
+		if (waiter != null)
+		{
+			// The download slot is handed over
+			Idle.add((owned)waiter.callback);
 		}
 		else
 		{
-			// Finished reading
+			d_downloads--;
+		}
+	}
+
+	private async Gdk.Pixbuf? download(string id, int size, File file, File missing)
+	{
+		var uri = d_uri_template.replace("{id}", id).replace("{size}", size.to_string());
+		var remote = File.new_for_uri(uri);
+
+		InputStream stream;
+
+		try
+		{
+			stream = yield Gitg.PlatformSupport.http_get(remote, null);
+		}
+		catch (Error e)
+		{
+			debug("Can not retrieve avatar from %s: %s", uri, e.message);
+
+			// Only remember that there is no avatar when that is known for
+			// sure, not on network errors
+			if (e is IOError.NOT_FOUND)
+			{
+				yield store(missing, new uint8[0]);
+			}
+
+			return null;
+		}
+
+		var contents = new ByteArray();
+		var buffer = new uint8[4096];
+
+		while (true)
+		{
+			ssize_t n;
+
 			try
 			{
-				loader.close();
-			} catch { return null; }
+				n = yield stream.read_async(buffer, Priority.LOW);
+			}
+			catch
+			{
+				return null;
+			}
 
-			return loader.get_pixbuf();
+			if (n == 0)
+			{
+				break;
+			}
+
+			contents.append(buffer[0:n]);
+		}
+
+		var pixbuf = decode(contents.data, size);
+
+		if (pixbuf != null)
+		{
+			yield store(file, contents.data);
 		}
+
+		return pixbuf;
 	}
 }
 
@@ -111,7 +111,25 @@ public class Commit : Ggit.Commit
 		}
 	}
 
-	public Ggit.Diff get_diff(Ggit.DiffOptions? options, int parent)
+	private Ggit.Tree? get_parent_tree(int parent) throws Error
+	{
+		var parents = get_parents();
+
+		if (parents.size == 0)
+		{
+			// No parents, initial commit?
+			return null;
+		}
+
+		if (parent >= parents.size)
+		{
+			parent = (int)parents.size - 1;
+		}
+
+		return parents[parent].get_tree();
+	}
+
+	public Ggit.Diff get_diff(Ggit.DiffOptions? options, int parent, bool find_similar = true)
 	{
 		Ggit.Diff? diff = null;
 
@@ -119,43 +137,386 @@ public class Commit : Ggit.Commit
 
 		try
 		{
-			var parents = get_parents();
+			diff = new Ggit.Diff.tree_to_tree(repo,
+			                                  get_parent_tree(parent),
+			                                  get_tree(),
+			                                  options);
+		}
+		catch (Error e)
+		{
+			stderr.printf("Error when getting diff: %s\n", e.message);
+		}
 
-			if (parents.size == 0)
+		if (diff != null && find_similar)
+		{
+			try
 			{
-				// No parents, initial commit?
-				diff = new Ggit.Diff.tree_to_tree(repo,
-				                                  null,
-				                                  get_tree(),
-				                                  options);
+				diff.find_similar(null);
+			} catch {}
+		}
+
+		return diff;
+	}
+
+	/*
+	 * The number of (deleted, added) file pairs that rename detection
+	 * would have to compare for the given diff.
+	 */
+	public static int64 get_similarity_pairs(Ggit.Diff diff)
+	{
+		int64 added = 0;
+		int64 deleted = 0;
+
+		for (var i = 0; i < diff.get_num_deltas(); i++)
+		{
+			var status = diff.get_delta(i).get_status();
+
+			if (status == Ggit.DeltaType.ADDED)
+			{
+				added++;
 			}
-			else
+			else if (status == Ggit.DeltaType.DELETED)
 			{
-				if (parent >= parents.size)
+				deleted++;
+			}
+		}
+
+		return added * deleted;
+	}
+
+	private class SimilarRequest
+	{
+		public SourceFunc callback;
+		public bool dropped;
+	}
+
+	// libgit2 can not interrupt finding similar files once it started, so
+	// only one detection runs at a time. Of the requests made meanwhile,
+	// only the latest one waits for its turn, the others are dropped.
+	private static bool s_similar_running;
+	private static SimilarRequest? s_similar_pending;
+
+	private static async bool acquire_similar()
+	{
+		if (!s_similar_running)
+		{
+			s_similar_running = true;
+			return true;
+		}
+
+		if (s_similar_pending != null)
+		{
+			s_similar_pending.dropped = true;
+			Idle.add((owned)s_similar_pending.callback);
+		}
+
+		var request = new SimilarRequest();
+		request.callback = acquire_similar.callback;
+
+		s_similar_pending = request;
+		yield;
+
+		return !request.dropped;
+	}
+
+	private static void release_similar()
+	{
+		var pending = s_similar_pending;
+		s_similar_pending = null;
+
+		if (pending != null)
+		{
+			// The slot is handed over
+			Idle.add((owned)pending.callback);
+		}
+		else
+		{
+			s_similar_running = false;
+		}
+	}
+
+	/*
+	 * Compute the diff with rename and copy detection on a worker thread.
+	 * When there are more than pair_limit candidate pairs, only exact
+	 * renames are detected and similarity is LIMITED. When detection takes
+	 * longer than timeout milliseconds, null is returned and similarity is
+	 * TIMED_OUT. Timing out or cancelling stops the thread before it starts
+	 * finding similar files, a detection already running can not be
+	 * stopped, but no other one is started until it finished.
+	 */
+	public async Ggit.Diff? get_diff_similar(Ggit.DiffOptions? options,
+	                                         int parent,
+	                                         uint timeout,
+	                                         int64 pair_limit,
+	                                         Cancellable? cancellable,
+	                                         out DiffSimilarity similarity)
+	{
+		Ggit.Tree? old_tree;
+		Ggit.Tree new_tree;
+
+		similarity = DiffSimilarity.NONE;
+
+		try
+		{
+			old_tree = get_parent_tree(parent);
+			new_tree = get_tree();
+		}
+		catch (Error e)
+		{
+			stderr.printf("Error when getting diff: %s\n", e.message);
+			return null;
+		}
+
+		if (!(yield acquire_similar()))
+		{
+			return null;
+		}
+
+		if (cancellable != null && cancellable.is_cancelled())
+		{
+			release_similar();
+			return null;
+		}
+
+		var repo = get_owner();
+		var stop = new Cancellable();
+
+		Ggit.Diff? diff = null;
+		var exact_only = false;
+
+		SourceFunc callback = get_diff_similar.callback;
+		var resumed = false;
+		var timed_out = false;
+		uint timeout_id = 0;
+		ulong cancel_id = 0;
+
+		try
+		{
+			new Thread<void *>.try("gitg-find-similar", () => {
+				try
+				{
+					if (!stop.is_cancelled())
+					{
+						var d = new Ggit.Diff.tree_to_tree(repo, old_tree, new_tree, options);
+						var find_options = new Ggit.DiffFindOptions();
+
+						exact_only = get_similarity_pairs(d) > pair_limit;
+
+						if (exact_only)
+						{
+							find_options.flags = Ggit.DiffFindFlags.EXACT_MATCH_ONLY;
+						}
+
+						if (!stop.is_cancelled())
+						{
+							d.find_similar(find_options);
+							diff = d;
+						}
+					}
+				}
+				catch (Error e)
 				{
-					parent = (int)parents.size - 1;
+					stderr.printf("Error when finding similar files: %s\n", e.message);
 				}
 
-				diff = new Ggit.Diff.tree_to_tree(repo,
-						                              parents[parent].get_tree(),
-						                              get_tree(),
-						                              options);
-			}
+				Idle.add(() => {
+					release_similar();
+
+					if (!resumed)
+					{
+						resumed = true;
+						Source.remove(timeout_id);
+
+						callback();
+					}
+
+					return false;
+				});
+
+				return null;
+			});
+		}
+		catch (Error e)
+		{
+			stderr.printf("Error when finding similar files: %s\n", e.message);
+
+			release_similar();
+			return null;
+		}
+
+		timeout_id = Timeout.add(timeout, () => {
+			// Give up waiting, the thread stops as soon as it can
+			stop.cancel();
+
+			resumed = true;
+			timed_out = true;
+
+			callback();
+			return false;
+		});
+
+		if (cancellable != null)
+		{
+			cancel_id = cancellable.connect(() => {
+				stop.cancel();
+
+				Idle.add(() => {
+					if (!resumed)
+					{
+						resumed = true;
+						Source.remove(timeout_id);
+
+						callback();
+					}
+
+					return false;
+				});
+			});
+		}
+
+		yield;
+
+		if (cancellable != null)
+		{
+			cancellable.disconnect(cancel_id);
+		}
+
+		if (timed_out)
+		{
+			similarity = DiffSimilarity.TIMED_OUT;
+			return null;
+		}
+
+		similarity = exact_only ? DiffSimilarity.LIMITED : DiffSimilarity.EXACT;
+		return diff;
+	}
+
+	public delegate void DiffStatFunc(int index, uint added, uint removed);
+
+	private const int MAX_STAT_THREADS = 8;
+	private const uint STAT_FLUSH_INTERVAL = 50;
+
+	/*
+	 * Compute the number of added and removed lines of each delta of the
+	 * diff with the given parent, without rename detection, so that indices
+	 * match those of get_diff(options, parent, false). Deltas are spread
+	 * over several threads, each with its own diff since patches cannot be
+	 * generated concurrently from a single one. Results are delivered on
+	 * the main loop in batches, in no particular order.
+	 */
+	public async void get_diff_stats(Ggit.DiffOptions? options,
+	                                 int parent,
+	                                 Cancellable? cancellable,
+	                                 owned DiffStatFunc func)
+	{
+		Ggit.Tree? old_tree;
+		Ggit.Tree new_tree;
+
+		try
+		{
+			old_tree = get_parent_tree(parent);
+			new_tree = get_tree();
 		}
 		catch (Error e)
 		{
 			stderr.printf("Error when getting diff: %s\n", e.message);
+			return;
 		}
 
-		if (diff != null)
+		var repo = get_owner();
+		var nthreads = (int)uint.min(uint.max(get_num_processors(), 1), MAX_STAT_THREADS);
+
+		SourceFunc callback = get_diff_stats.callback;
+		var mutex = Mutex();
+		var stats = new uint[0];
+		var next = 0;
+		var running = nthreads;
+
+		for (var t = 0; t < nthreads; t++)
 		{
 			try
 			{
-				diff.find_similar(null);
-			} catch {}
+				new Thread<void *>.try("gitg-diff-stats", () => {
+					try
+					{
+						var d = new Ggit.Diff.tree_to_tree(repo, old_tree, new_tree, options);
+						var n = (int)d.get_num_deltas();
+
+						while (cancellable == null || !cancellable.is_cancelled())
+						{
+							var i = AtomicInt.add(ref next, 1);
+
+							if (i >= n)
+							{
+								break;
+							}
+
+							size_t added = 0;
+							size_t removed = 0;
+
+							try
+							{
+								var patch = new Ggit.Patch.from_diff(d, i);
+								patch.get_line_stats(null, out added, out removed);
+							} catch {}
+
+							mutex.lock();
+							stats += (uint)i;
+							stats += (uint)added;
+							stats += (uint)removed;
+							mutex.unlock();
+						}
+					}
+					catch (Error e)
+					{
+						stderr.printf("Error when computing diff stats: %s\n", e.message);
+					}
+
+					if (AtomicInt.dec_and_test(ref running))
+					{
+						Idle.add((owned)callback);
+					}
+
+					return null;
+				});
+			}
+			catch (Error e)
+			{
+				stderr.printf("Error when computing diff stats: %s\n", e.message);
+
+				if (AtomicInt.dec_and_test(ref running))
+				{
+					Idle.add((owned)callback);
+				}
+			}
 		}
 
-		return diff;
+		var flush_id = Timeout.add(STAT_FLUSH_INTERVAL, () => {
+			flush_diff_stats(ref mutex, ref stats, func);
+			return true;
+		});
+
+		yield;
+
+		Source.remove(flush_id);
+
+		if (cancellable == null || !cancellable.is_cancelled())
+		{
+			flush_diff_stats(ref mutex, ref stats, func);
+		}
+	}
+
+	private static void flush_diff_stats(ref Mutex mutex, ref uint[] stats, DiffStatFunc func)
+	{
+		mutex.lock();
+		var batch = (owned)stats;
+		stats = new uint[0];
+		mutex.unlock();
+
+		for (var i = 0; i + 2 < batch.length; i += 3)
+		{
+			func((int)batch[i], batch[i + 1], batch[i + 2]);
+		}
 	}
 
 	public Ggit.Note get_note()
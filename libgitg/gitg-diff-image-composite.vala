@@ -23,10 +23,10 @@ class Gitg.DiffImageComposite : Gtk.DrawingArea
 
 	private void get_natural_size(out int image_width, out int image_height)
 	{
-		var pixbuf_old = cache.old_pixbuf;
-		var pixbuf_new = cache.new_pixbuf;
+		var old_image = cache.old_image;
+		var new_image = cache.new_image;
 
-		if (pixbuf_old == null || pixbuf_new == null)
+		if (old_image == null || new_image == null)
 		{
 			image_width = 0;
 			image_height = 0;
@@ -34,25 +34,10 @@ class Gitg.DiffImageComposite : Gtk.DrawingArea
 			return;
 		}
 
-		var window = get_window();
+		var scale = get_scale_factor();
 
-		int pixbuf_old_height = pixbuf_old.get_height ();
-		int pixbuf_new_height = pixbuf_new.get_height ();
-
-		int pixbuf_old_width = pixbuf_old.get_width ();
-		int pixbuf_new_width = pixbuf_new.get_width ();
-
-		double xscale_old = 1, yscale_old = 1;
-		double xscale_new = 1, yscale_new = 1;
-
-		if (window != null)
-		{
-			cache.get_old_surface(window).get_device_scale(out xscale_old, out yscale_old);
-			cache.get_new_surface(window).get_device_scale(out xscale_new, out yscale_new);
-		}
-
-		image_width = (int) double.max (pixbuf_old_width / xscale_old, pixbuf_new_width / xscale_new);
-		image_height = (int) double.max (pixbuf_old_height / xscale_old, pixbuf_new_height / xscale_new);
+		image_width = int.max(old_image.width, new_image.width) / scale;
+		image_height = int.max(old_image.height, new_image.height) / scale;
 	}
 
 	protected void get_sizing(int width, out int image_width, out int image_height)
@@ -62,11 +47,37 @@ class Gitg.DiffImageComposite : Gtk.DrawingArea
 		// Scale down to fit in width
 		if (image_width > width)
 		{
-			image_height *= width / image_width;
+			image_height = (int)((double)image_height * width / image_width);
 			image_width = width;
 		}
 	}
 
+	/*
+	 * Paint image at x, y, scaled the same as the composite is to fit in the
+	 * allocated width.
+	 */
+	protected void paint_image(Cairo.Context cr, DiffImageMipmap image, int x, int y, double alpha = 1)
+	{
+		Gtk.Allocation alloc;
+		get_allocation(out alloc);
+
+		int natural_width, natural_height;
+		get_natural_size(out natural_width, out natural_height);
+
+		int image_width, image_height;
+		get_sizing(alloc.width, out image_width, out image_height);
+
+		if (natural_width == 0)
+		{
+			return;
+		}
+
+		var scale_factor = get_scale_factor();
+		var scale = (double)image_width / natural_width / scale_factor;
+
+		image.paint(cr, scale_factor, x, y, image.width * scale, image.height * scale, alpha);
+	}
+
 	protected override void get_preferred_width(out int minimum_width, out int natural_width)
 	{
 		int natural_height;
@@ -23,35 +23,22 @@ class Gitg.DiffImageDifference : DiffImageComposite
 	{
 		base.draw(cr);
 
-		var window = get_window();
-
 		Gtk.Allocation alloc;
 		get_allocation(out alloc);
 
 		int image_width, image_height;
 		get_sizing(alloc.width, out image_width, out image_height);
 
-		var old_surface = cache.get_old_surface(window);
-		var new_surface = cache.get_new_surface(window);
-
 		int x = (alloc.width - image_width) / 2;
 		int y = 0;
 
-		if (old_surface != null)
-		{
-			cr.set_source_surface(old_surface, x, y);
-			cr.paint();
-		}
+		// The difference is computed once when loading, drawing only
+		// scales the visible part of it
+		var difference = cache.difference;
 
-		if (new_surface != null)
+		if (difference != null)
 		{
-			cr.save();
-			{
-				cr.set_operator(Cairo.Operator.DIFFERENCE);
-				cr.set_source_surface(new_surface, x, y);
-				cr.paint();
-			}
-			cr.restore();
+			paint_image(cr, difference, x, y);
 		}
 
 		return true;
@@ -0,0 +1,355 @@
+/*
+ * This file is part of gitg
+ *
+ * Copyright (C) 2026 - Alberto Fanjul
+ *
+ * gitg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gitg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gitg. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * An image along with copies of it downscaled by successive halvings.
+ * Drawing picks the smallest copy that still has enough pixels for the
+ * size it is drawn at, and only converts the tiles of that copy which
+ * intersect the clip to cairo surfaces. Images and their copies can be
+ * created on any thread, painting must happen on the main thread.
+ */
+class Gitg.DiffImageMipmap : Object
+{
+	// Images are decoded to fit in this size, the diff view is never
+	// wider than that
+	public const int MAX_SIZE = 4096;
+
+	private const int TILE_SIZE = 512;
+	private const int MIN_LEVEL_SIZE = 32;
+
+	private class Level
+	{
+		public Gdk.Pixbuf pixbuf;
+		public int columns;
+		public int rows;
+		public Cairo.Surface?[] tiles;
+
+		public Level(Gdk.Pixbuf pixbuf)
+		{
+			this.pixbuf = pixbuf;
+
+			columns = (pixbuf.get_width() + TILE_SIZE - 1) / TILE_SIZE;
+			rows = (pixbuf.get_height() + TILE_SIZE - 1) / TILE_SIZE;
+		}
+
+		public Cairo.Surface get_tile(int column, int row)
+		{
+			if (tiles.length == 0)
+			{
+				tiles = new Cairo.Surface?[columns * rows];
+			}
+
+			var i = row * columns + column;
+
+			if (tiles[i] == null)
+			{
+				var x = column * TILE_SIZE;
+				var y = row * TILE_SIZE;
+
+				var sub = new Gdk.Pixbuf.subpixbuf(pixbuf,
+				                                   x,
+				                                   y,
+				                                   int.min(TILE_SIZE, pixbuf.get_width() - x),
+				                                   int.min(TILE_SIZE, pixbuf.get_height() - y));
+
+				tiles[i] = Gdk.cairo_surface_create_from_pixbuf(sub, 1, null);
+			}
+
+			return tiles[i];
+		}
+	}
+
+	private Level[] d_levels;
+	private int d_current_level;
+
+	// Size of the original image, which may be larger than the decoded one
+	public int width { get; private set; }
+	public int height { get; private set; }
+
+	public Gdk.Pixbuf pixbuf
+	{
+		get { return d_levels[0].pixbuf; }
+	}
+
+	public DiffImageMipmap(Gdk.Pixbuf pixbuf, int width = -1, int height = -1)
+	{
+		Object();
+
+		this.width = width > 0 ? width : pixbuf.get_width();
+		this.height = height > 0 ? height : pixbuf.get_height();
+
+		d_levels = new Level[0];
+		d_levels += new Level(pixbuf);
+
+		var level = pixbuf;
+
+		while (level.get_width() / 2 >= MIN_LEVEL_SIZE && level.get_height() / 2 >= MIN_LEVEL_SIZE)
+		{
+			level = level.scale_simple(level.get_width() / 2,
+			                           level.get_height() / 2,
+			                           Gdk.InterpType.BILINEAR);
+
+			d_levels += new Level(level);
+		}
+	}
+
+	/*
+	 * Decode an image, downscaling it while decoding when it does not fit
+	 * in MAX_SIZE.
+	 */
+	public static DiffImageMipmap? decode(Bytes data) throws Error
+	{
+		var loader = new Gdk.PixbufLoader();
+		unowned Gdk.PixbufLoader l = loader;
+
+		int width = 0;
+		int height = 0;
+
+		loader.size_prepared.connect((w, h) => {
+			width = w;
+			height = h;
+
+			var factor = double.min(1, (double)MAX_SIZE / int.max(w, h));
+
+			if (factor < 1)
+			{
+				l.set_size(int.max(1, (int)(w * factor)), int.max(1, (int)(h * factor)));
+			}
+		});
+
+		try
+		{
+			loader.write_bytes(data);
+		}
+		finally
+		{
+			loader.close();
+		}
+
+		var pixbuf = loader.get_pixbuf();
+
+		if (pixbuf == null)
+		{
+			return null;
+		}
+
+		return new DiffImageMipmap(pixbuf, width, height);
+	}
+
+	private static Gdk.Pixbuf rgba_at_scale(DiffImageMipmap image, double factor)
+	{
+		var pixbuf = image.pixbuf;
+		var w = int.max(1, (int)Math.round(image.width * factor));
+		var h = int.max(1, (int)Math.round(image.height * factor));
+
+		if (w != pixbuf.get_width() || h != pixbuf.get_height())
+		{
+			pixbuf = pixbuf.scale_simple(w, h, Gdk.InterpType.BILINEAR);
+		}
+
+		if (!pixbuf.get_has_alpha())
+		{
+			pixbuf = pixbuf.add_alpha(false, 0, 0, 0);
+		}
+
+		return pixbuf;
+	}
+
+	/*
+	 * Compute the result of drawing b over a with the cairo DIFFERENCE
+	 * operator, both anchored at the top left. The images are brought to a
+	 * common resolution first in case only one of them was downscaled
+	 * while decoding.
+	 */
+	public static DiffImageMipmap difference(DiffImageMipmap a, DiffImageMipmap b)
+	{
+		var factor = double.min((double)a.pixbuf.get_width() / a.width,
+		                        (double)b.pixbuf.get_width() / b.width);
+
+		var pa = rgba_at_scale(a, factor);
+		var pb = rgba_at_scale(b, factor);
+
+		var width = int.max(pa.get_width(), pb.get_width());
+		var height = int.max(pa.get_height(), pb.get_height());
+
+		var ret = new Gdk.Pixbuf(Gdk.Colorspace.RGB, true, 8, width, height);
+		ret.fill(0);
+
+		unowned uint8[] da = pa.get_pixels_with_length();
+		unowned uint8[] db = pb.get_pixels_with_length();
+		unowned uint8[] dr = ret.get_pixels_with_length();
+
+		var sa = pa.get_rowstride();
+		var sb = pb.get_rowstride();
+		var sr = ret.get_rowstride();
+
+		var wa = pa.get_width();
+		var wb = pb.get_width();
+		var ha = pa.get_height();
+		var hb = pb.get_height();
+
+		for (var y = 0; y < height; y++)
+		{
+			uint8 *ra = y < ha ? &da[y * sa] : null;
+			uint8 *rb = y < hb ? &db[y * sb] : null;
+			uint8 *rr = &dr[y * sr];
+
+			var overlap = 0;
+
+			if (ra != null && rb != null)
+			{
+				overlap = int.min(wa, wb);
+				difference_row(ra, rb, rr, overlap);
+			}
+
+			// Outside of the overlap only one of the images is there
+			if (ra != null && wa > overlap)
+			{
+				Memory.copy(rr + overlap * 4, ra + overlap * 4, (wa - overlap) * 4);
+			}
+			else if (rb != null && wb > overlap)
+			{
+				Memory.copy(rr + overlap * 4, rb + overlap * 4, (wb - overlap) * 4);
+			}
+		}
+
+		var w = int.max(a.width, b.width);
+		var h = int.max(a.height, b.height);
+
+		return new DiffImageMipmap(ret, w, h);
+	}
+
+	/*
+	 * Same as cairo DIFFERENCE on premultiplied colors, but on straight
+	 * alpha, for n pixels. The loop has no branches and no calls, the
+	 * divisions are by a constant or done in float, so it can be
+	 * vectorized over the row.
+	 */
+	private static void difference_row(uint8 *a, uint8 *b, uint8 *r, int n)
+	{
+		for (var i = 0; i < n * 4; i += 4)
+		{
+			uint aa = a[i + 3];
+			uint ba = b[i + 3];
+			uint ra = aa + ba - aa * ba / 255;
+
+			// Both alphas are 0 when ra is, and so are the colors
+			float unpremultiply = 255.0f / uint.max(ra, 1);
+
+			for (var c = 0; c < 3; c++)
+			{
+				uint ac = a[i + c] * aa / 255;
+				uint bc = b[i + c] * ba / 255;
+				uint m = uint.min(ac * ba, bc * aa) / 255;
+				uint rc = ac + bc - 2 * m;
+
+				r[i + c] = (uint8)uint.min((uint)(rc * unpremultiply), 255);
+			}
+
+			r[i + 3] = (uint8)ra;
+		}
+	}
+
+	/*
+	 * Paint the image scaled to width x height at x, y in user space.
+	 * scale_factor is the number of device pixels per user space unit.
+	 */
+	public void paint(Cairo.Context cr,
+	                  int scale_factor,
+	                  double x,
+	                  double y,
+	                  double width,
+	                  double height,
+	                  double alpha = 1)
+	{
+		if (width <= 0 || height <= 0)
+		{
+			return;
+		}
+
+		var index = 0;
+		var device_width = width * scale_factor;
+
+		while (index + 1 < d_levels.length && d_levels[index + 1].pixbuf.get_width() >= device_width)
+		{
+			index++;
+		}
+
+		if (index != d_current_level)
+		{
+			// Only keep tiles for the level in use
+			d_levels[d_current_level].tiles = new Cairo.Surface?[0];
+			d_current_level = index;
+		}
+
+		var level = d_levels[index];
+
+		var sx = width / level.pixbuf.get_width();
+		var sy = height / level.pixbuf.get_height();
+
+		double cx1, cy1, cx2, cy2;
+		cr.clip_extents(out cx1, out cy1, out cx2, out cy2);
+
+		for (var row = 0; row < level.rows; row++)
+		{
+			// Round tile edges so that neighbouring tiles neither overlap
+			// nor leave gaps
+			var y1 = Math.round(y + row * TILE_SIZE * sy);
+			var y2 = Math.round(y + double.min((row + 1) * TILE_SIZE, level.pixbuf.get_height()) * sy);
+
+			if (y2 <= cy1 || y1 >= cy2)
+			{
+				continue;
+			}
+
+			for (var column = 0; column < level.columns; column++)
+			{
+				var x1 = Math.round(x + column * TILE_SIZE * sx);
+				var x2 = Math.round(x + double.min((column + 1) * TILE_SIZE, level.pixbuf.get_width()) * sx);
+
+				if (x2 <= cx1 || x1 >= cx2)
+				{
+					continue;
+				}
+
+				cr.save();
+				{
+					cr.rectangle(x1, y1, x2 - x1, y2 - y1);
+					cr.clip();
+
+					cr.translate(x + column * TILE_SIZE * sx, y + row * TILE_SIZE * sy);
+					cr.scale(sx, sy);
+
+					cr.set_source_surface(level.get_tile(column, row), 0, 0);
+					cr.get_source().set_extend(Cairo.Extend.PAD);
+
+					if (alpha < 1)
+					{
+						cr.paint_with_alpha(alpha);
+					}
+					else
+					{
+						cr.paint();
+					}
+				}
+				cr.restore();
+			}
+		}
+	}
+}
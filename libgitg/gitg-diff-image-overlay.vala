@@ -46,30 +46,26 @@ class Gitg.DiffImageOverlay : DiffImageComposite
 	{
 		base.draw(cr);
 
-		var window = get_window();
-
 		Gtk.Allocation alloc;
 		get_allocation(out alloc);
 
 		int image_width, image_height;
 		get_sizing(alloc.width, out image_width, out image_height);
 
-		var old_surface = cache.get_old_surface(window);
-		var new_surface = cache.get_new_surface(window);
+		var old_image = cache.old_image;
+		var new_image = cache.new_image;
 
 		int x = (alloc.width - image_width) / 2;
 		int y = 0;
 
-		if (old_surface != null && d_alpha != 1)
+		if (old_image != null && d_alpha != 1)
 		{
-			cr.set_source_surface(old_surface, x, y);
-			cr.paint_with_alpha(1 - d_alpha);
+			paint_image(cr, old_image, x, y, 1 - d_alpha);
 		}
 
-		if (new_surface != null && d_alpha != 0)
+		if (new_image != null && d_alpha != 0)
 		{
-			cr.set_source_surface(new_surface, x, y);
-			cr.paint_with_alpha(d_alpha);
+			paint_image(cr, new_image, x, y, d_alpha);
 		}
 
 		return true;
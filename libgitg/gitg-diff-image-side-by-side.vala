@@ -28,11 +28,11 @@ class Gitg.DiffImageSideBySide : Gtk.DrawingArea
 	{
 		get
 		{
-			if (d_old_size_layout == null && cache.old_pixbuf != null)
+			if (d_old_size_layout == null && cache.old_image != null)
 			{
-				string message = @"$(cache.old_pixbuf.get_width()) × $(cache.old_pixbuf.get_height())";
+				string message = @"$(cache.old_image.width) × $(cache.old_image.height)";
 
-				if (cache.new_pixbuf != null)
+				if (cache.new_image != null)
 				{
 					// Translators: this label is displayed below the image diff, %s
 					// is substituted with the size of the image
@@ -54,11 +54,11 @@ class Gitg.DiffImageSideBySide : Gtk.DrawingArea
 	{
 		get
 		{
-			if (d_new_size_layout == null && cache.new_pixbuf != null)
+			if (d_new_size_layout == null && cache.new_image != null)
 			{
-				string message = @"$(cache.new_pixbuf.get_width()) × $(cache.new_pixbuf.get_height())";
+				string message = @"$(cache.new_image.width) × $(cache.new_image.height)";
 
-				if (cache.old_pixbuf != null)
+				if (cache.old_image != null)
 				{
 					// Translators: this label is displayed below the image diff, %s
 					// is substituted with the size of the image
@@ -97,35 +97,21 @@ class Gitg.DiffImageSideBySide : Gtk.DrawingArea
 	{
 		double ow = 0, oh = 0, nw = 0, nh = 0;
 
-		var old_pixbuf = cache.old_pixbuf;
-		var new_pixbuf = cache.new_pixbuf;
+		var old_image = cache.old_image;
+		var new_image = cache.new_image;
 
-		var window = get_window();
+		double scale = get_scale_factor();
 
-		if (old_pixbuf != null)
+		if (old_image != null)
 		{
-			double xscale = 1, yscale = 1;
-
-			if (window != null)
-			{
-				cache.get_old_surface(get_window()).get_device_scale(out xscale, out yscale);
-			}
-
-			ow = (double)old_pixbuf.get_width() / xscale;
-			oh = (double)old_pixbuf.get_height() / yscale;
+			ow = (double)old_image.width / scale;
+			oh = (double)old_image.height / scale;
 		}
 
-		if (new_pixbuf != null)
+		if (new_image != null)
 		{
-			double xscale = 1, yscale = 1;
-
-			if (window != null)
-			{
-				cache.get_new_surface(get_window()).get_device_scale(out xscale, out yscale);
-			}
-
-			nw = (double)new_pixbuf.get_width() / xscale;
-			nh = (double)new_pixbuf.get_height() / yscale;
+			nw = (double)new_image.width / scale;
+			nh = (double)new_image.height / scale;
 		}
 
 		var tw = ow + nw;
@@ -218,15 +204,15 @@ class Gitg.DiffImageSideBySide : Gtk.DrawingArea
 
 	protected override bool draw(Cairo.Context cr)
 	{
-		var window = get_window();
-
 		Gtk.Allocation alloc;
 		get_allocation(out alloc);
 
 		var sizing = get_sizing(alloc.width);
 
-		var old_surface = cache.get_old_surface(window);
-		var new_surface = cache.get_new_surface(window);
+		var old_image = cache.old_image;
+		var new_image = cache.new_image;
+
+		var scale_factor = get_scale_factor();
 
 		var ctx = get_style_context();
 
@@ -235,18 +221,17 @@ class Gitg.DiffImageSideBySide : Gtk.DrawingArea
 		double max_height = double.max(sizing.old_size.image_height, sizing.new_size.image_height);
 		double spread_factor = 0.5;
 
-		if (old_surface != null && new_surface != null)
+		if (old_image != null && new_image != null)
 		{
 			spread_factor = 2.0 / 3.0;
 		}
 
-		if (old_surface != null)
+		if (old_image != null)
 		{
 			var x = (sizing.old_size.width - sizing.old_size.image_width) * spread_factor;
 			var y = (max_height - sizing.old_size.image_height) / 2;
 
-			cr.set_source_surface(old_surface, x, y);
-			cr.paint();
+			old_image.paint(cr, scale_factor, x, y, sizing.old_size.image_width, sizing.old_size.image_height);
 
 			Pango.Rectangle rect;
 
@@ -258,18 +243,17 @@ class Gitg.DiffImageSideBySide : Gtk.DrawingArea
 			                  old_size_layout);
 		}
 
-		if (new_surface != null)
+		if (new_image != null)
 		{
 			var x = (sizing.new_size.width - sizing.new_size.image_width) * (1.0 - spread_factor);
 			var y = (max_height - sizing.new_size.image_height) / 2;
 
-			if (cache.old_pixbuf != null)
+			if (old_image != null)
 			{
 				x += sizing.old_size.width + spacing;
 			}
 
-			cr.set_source_surface(new_surface, x, y);
-			cr.paint();
+			new_image.paint(cr, scale_factor, x, y, sizing.new_size.image_width, sizing.new_size.image_height);
 
 			Pango.Rectangle rect;
 
@@ -46,42 +46,38 @@ class Gitg.DiffImageSlider : DiffImageComposite
 	{
 		base.draw(cr);
 
-		var window = get_window();
-
 		Gtk.Allocation alloc;
 		get_allocation(out alloc);
 
 		int image_width, image_height;
 		get_sizing(alloc.width, out image_width, out image_height);
 
-		var old_surface = cache.get_old_surface(window);
-		var new_surface = cache.get_new_surface(window);
+		var old_image = cache.old_image;
+		var new_image = cache.new_image;
 
 		int x = (alloc.width - image_width) / 2;
 		int y = 0;
 
 		int pos = (int)(image_width * position);
 
-		if (old_surface != null)
+		if (old_image != null)
 		{
 			cr.save();
 			{
 				cr.rectangle(x, y, pos, image_height);
 				cr.clip();
-				cr.set_source_surface(old_surface, x, y);
-				cr.paint();
+				paint_image(cr, old_image, x, y);
 			}
 			cr.restore();
 		}
 
-		if (new_surface != null)
+		if (new_image != null)
 		{
 			cr.save();
 			{
 				cr.rectangle(x + pos, y, image_width - pos, image_height);
 				cr.clip();
-				cr.set_source_surface(new_surface, x, y);
-				cr.paint();
+				paint_image(cr, new_image, x, y);
 			}
 			cr.restore();
 		}
@@ -19,11 +19,10 @@
 
 interface Gitg.DiffImageSurfaceCache : Object
 {
-	public abstract Gdk.Pixbuf? old_pixbuf { get; construct set; }
-	public abstract Gdk.Pixbuf? new_pixbuf { get; construct set; }
+	public abstract DiffImageMipmap? old_image { get; }
+	public abstract DiffImageMipmap? new_image { get; }
 
-	public abstract Gdk.Window window { get; construct set; }
-
-	public abstract Cairo.Surface? get_old_surface(Gdk.Window window);
-	public abstract Cairo.Surface? get_new_surface(Gdk.Window window);
+	// Result of drawing the new image over the old one with the cairo
+	// DIFFERENCE operator, only available when both images are
+	public abstract DiffImageMipmap? difference { get; }
 }
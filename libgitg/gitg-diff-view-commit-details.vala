@@ -53,6 +53,9 @@ class Gitg.DiffViewCommitDetails : Gtk.Grid
 	[GtkChild( name = "label_expand_collapse_files" )]
 	private unowned Gtk.Label d_label_expand_collapse_files;
 
+	[GtkChild( name = "label_similarity" )]
+	private unowned Gtk.Label d_label_similarity;
+
 	private Settings d_settings;
 
 	public bool expanded
@@ -78,6 +81,40 @@ class Gitg.DiffViewCommitDetails : Gtk.Grid
 		}
 	}
 
+	private DiffSimilarity d_similarity;
+
+	public DiffSimilarity similarity
+	{
+		get { return d_similarity; }
+
+		set
+		{
+			d_similarity = value;
+
+			switch (value)
+			{
+			case DiffSimilarity.DETECTING:
+				d_label_similarity.label = _("Detecting renames…");
+				d_label_similarity.tooltip_text = null;
+				d_label_similarity.visible = true;
+				break;
+			case DiffSimilarity.LIMITED:
+				d_label_similarity.label = _("Rename detection limited");
+				d_label_similarity.tooltip_text = _("There are too many added and removed files to detect all renames, only exact renames are shown");
+				d_label_similarity.visible = true;
+				break;
+			case DiffSimilarity.TIMED_OUT:
+				d_label_similarity.label = _("Rename detection stopped");
+				d_label_similarity.tooltip_text = _("Detecting renames took too long, renamed files are shown as added and removed");
+				d_label_similarity.visible = true;
+				break;
+			default:
+				d_label_similarity.visible = false;
+				break;
+			}
+		}
+	}
+
 	private Cancellable? d_avatar_cancel;
 
 	private Ggit.Commit? d_commit;
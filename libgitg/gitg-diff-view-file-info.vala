@@ -7,6 +7,16 @@ class Gitg.DiffViewFileInfo : Object
 	public InputStream? new_file_input_stream { get; set; }
 	public string? new_file_content_type { get; private set; }
 
+	// Guessed content types, keyed by blob id or by path, size and mtime
+	// for working directory files
+	private static Gee.HashMap<string, string> s_content_types;
+	private const int MAX_CONTENT_TYPES = 10000;
+
+	static construct
+	{
+		s_content_types = new Gee.HashMap<string, string>();
+	}
+
 	public DiffViewFileInfo(Repository? repository, Ggit.DiffDelta delta, bool from_workdir)
 	{
 		Object(repository: repository, delta: delta, from_workdir: from_workdir);
@@ -31,6 +41,18 @@ class Gitg.DiffViewFileInfo : Object
 		var workdir = repository.get_workdir();
 		File location = workdir != null ? workdir.get_child(path) : null;
 
+		var key = yield content_type_key(id, location, cancellable);
+
+		if (key != null && s_content_types.has_key(key))
+		{
+			// The content stream is only an optimization for the renderers,
+			// they read the file themselves when it is not there
+			var content_type = s_content_types[key];
+			new_file_content_type = content_type != "" ? content_type : null;
+
+			return;
+		}
+
 		if (!from_workdir)
 		{
 			Ggit.Blob blob;
@@ -44,9 +66,13 @@ class Gitg.DiffViewFileInfo : Object
 				return;
 			}
 
-			uint8[]? raw_content = blob.get_raw_content();
+			uint8[] raw_content;
+
 			if (TextConv.has_textconv_command(repository, file))
-				raw_content = TextConv.get_textconv_content_from_raw(repository, file, raw_content);
+				raw_content = yield repository.textconv.convert_file(file, cancellable);
+			else
+				raw_content = blob.get_raw_content();
+
 			var bytes = new Bytes(raw_content);
 			new_file_input_stream = new GLib.MemoryInputStream.from_bytes(bytes);
 		}
@@ -59,7 +85,7 @@ class Gitg.DiffViewFileInfo : Object
 				{
 					uint8[]? content = null;
 					yield location.load_contents_async(cancellable, out content, null);
-					content = TextConv.get_textconv_content_from_raw(repository, file, content);
+					content = yield repository.textconv.convert_raw(file, content, cancellable);
 					var bytes = new Bytes(content);
 					new_file_input_stream = new GLib.MemoryInputStream.from_bytes(bytes);
 				}
@@ -90,6 +116,53 @@ class Gitg.DiffViewFileInfo : Object
 				stderr.printf("Failed to seek back to beginning of stream...\n");
 				new_file_input_stream = null;
 			}
+
+			if (key != null && (cancellable == null || !cancellable.is_cancelled()))
+			{
+				if (s_content_types.size >= MAX_CONTENT_TYPES)
+				{
+					s_content_types.clear();
+				}
+
+				s_content_types[key] = new_file_content_type != null ? new_file_content_type : "";
+			}
+		}
+	}
+
+	private async string? content_type_key(Ggit.OId id, File? location, Cancellable? cancellable)
+	{
+		var textconv = TextConv.has_textconv_command(repository, delta.get_new_file()) ? "textconv:" : "";
+
+		if (!from_workdir)
+		{
+			// The type is guessed from the name as well, the same blob can
+			// be stored under names of different types
+			var basename = location != null ? location.get_basename() : "";
+			return @"$(textconv)blob:$(id.to_string()):$basename";
+		}
+
+		if (location == null)
+		{
+			return null;
+		}
+
+		try
+		{
+			var info = yield location.query_info_async(FileAttribute.STANDARD_SIZE + "," +
+			                                           FileAttribute.TIME_MODIFIED + "," +
+			                                           FileAttribute.TIME_MODIFIED_USEC,
+			                                           FileQueryInfoFlags.NONE,
+			                                           Priority.DEFAULT,
+			                                           cancellable);
+
+			var mtime = info.get_attribute_uint64(FileAttribute.TIME_MODIFIED);
+			var usec = info.get_attribute_uint32(FileAttribute.TIME_MODIFIED_USEC);
+
+			return @"$(textconv)file:$(location.get_path()):$(info.get_size()):$mtime.$usec";
+		}
+		catch
+		{
+			return null;
 		}
 	}
 
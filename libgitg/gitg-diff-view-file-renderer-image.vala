@@ -45,6 +45,7 @@ class Gitg.DiffViewFileRendererImage : Gtk.Grid, DiffViewFileRenderer
 	private unowned Gtk.StackSwitcher d_stack_switcher;
 
 	private SurfaceCache d_cache;
+	private Cancellable d_cancellable;
 
 	public DiffViewFileRendererImage(Repository repository, Ggit.DiffDelta delta)
 	{
@@ -53,24 +54,73 @@ class Gitg.DiffViewFileRendererImage : Gtk.Grid, DiffViewFileRenderer
 
 	construct
 	{
-		d_cache = new SurfaceCache(pixbuf_for_file(delta.get_old_file()),
-		                           pixbuf_for_file(delta.get_new_file()));
+		d_cache = new SurfaceCache();
+		d_cancellable = new Cancellable();
 
 		d_diff_image_side_by_side.cache = d_cache;
 		d_diff_image_slider.cache = d_cache;
 		d_diff_image_overlay.cache = d_cache;
 		d_diff_image_difference.cache = d_cache;
 
-		if (d_cache.old_pixbuf == null || d_cache.new_pixbuf == null)
-		{
-			d_stack_switcher.sensitive = false;
-		}
+		d_stack_switcher.sensitive = false;
 
 		d_scale_slider_adjustment.bind_property("value", d_diff_image_slider, "position", BindingFlags.DEFAULT | BindingFlags.SYNC_CREATE);
 		d_scale_overlay_adjustment.bind_property("value", d_diff_image_overlay, "alpha", BindingFlags.DEFAULT | BindingFlags.SYNC_CREATE);
+
+		load.begin((obj, res) => {
+			load.end(res);
+		});
+	}
+
+	public override void dispose()
+	{
+		d_cancellable.cancel();
+		base.dispose();
+	}
+
+	private async void load()
+	{
+		var old_file = delta.get_old_file();
+		var new_file = delta.get_new_file();
+
+		DiffImageMipmap? old_image = null;
+		DiffImageMipmap? new_image = null;
+		DiffImageMipmap? difference = null;
+
+		// Decoding large images takes long, and so does computing their
+		// difference, so do it all on a thread
+		yield Async.thread_try(() => {
+			old_image = image_for_file(old_file);
+
+			if (d_cancellable.is_cancelled())
+			{
+				return;
+			}
+
+			new_image = image_for_file(new_file);
+
+			if (old_image != null && new_image != null && !d_cancellable.is_cancelled())
+			{
+				difference = DiffImageMipmap.difference(old_image, new_image);
+			}
+		});
+
+		if (d_cancellable.is_cancelled())
+		{
+			return;
+		}
+
+		d_cache.set_images(old_image, new_image, difference);
+
+		d_stack_switcher.sensitive = (old_image != null && new_image != null);
+
+		d_diff_image_side_by_side.queue_resize();
+		d_diff_image_slider.queue_resize();
+		d_diff_image_overlay.queue_resize();
+		d_diff_image_difference.queue_resize();
 	}
 
-	private Gdk.Pixbuf? pixbuf_for_file(Ggit.DiffFile file)
+	private DiffImageMipmap? image_for_file(Ggit.DiffFile file)
 	{
 		if ((file.get_flags() & Ggit.DiffFlag.VALID_ID) == 0 || file.get_oid().is_zero())
 		{
@@ -89,11 +139,9 @@ class Gitg.DiffViewFileRendererImage : Gtk.Grid, DiffViewFileRenderer
 			return null;
 		}
 
-		var stream = new MemoryInputStream.from_data(blob.get_raw_content(), null);
-
 		try
 		{
-			return new Gdk.Pixbuf.from_stream(stream);
+			return DiffImageMipmap.decode(new Bytes(blob.get_raw_content()));
 		}
 		catch (Error e)
 		{
@@ -102,47 +150,20 @@ class Gitg.DiffViewFileRendererImage : Gtk.Grid, DiffViewFileRenderer
 		}
 	}
 
-	public void add_hunk(Ggit.DiffHunk hunk, Gee.ArrayList<Ggit.DiffLine> lines)
+	public void add_hunk(DiffViewHunk hunk)
 	{
 	}
 
 	private class SurfaceCache : Object, Gitg.DiffImageSurfaceCache {
-		private Cairo.Surface? d_old_surface;
-		private Cairo.Surface? d_new_surface;
-
-		public Gdk.Pixbuf? old_pixbuf { get; construct set; }
-		public Gdk.Pixbuf? new_pixbuf { get; construct set; }
-
-		public Gdk.Window window { get; construct set; }
+		public DiffImageMipmap? old_image { get; private set; }
+		public DiffImageMipmap? new_image { get; private set; }
+		public DiffImageMipmap? difference { get; private set; }
 
-		public SurfaceCache(Gdk.Pixbuf? old_pixbuf, Gdk.Pixbuf? new_pixbuf)
+		public void set_images(DiffImageMipmap? old_image, DiffImageMipmap? new_image, DiffImageMipmap? difference)
 		{
-			Object(old_pixbuf: old_pixbuf, new_pixbuf: new_pixbuf);
-		}
-
-		public Cairo.Surface? get_old_surface(Gdk.Window window)
-		{
-			return get_cached_surface(window, old_pixbuf, ref d_old_surface);
-		}
-
-		public Cairo.Surface? get_new_surface(Gdk.Window window)
-		{
-			return get_cached_surface(window, new_pixbuf, ref d_new_surface);
-		}
-
-		private Cairo.Surface? get_cached_surface(Gdk.Window window, Gdk.Pixbuf? pixbuf, ref Cairo.Surface? cached)
-		{
-			if (pixbuf == null)
-			{
-				return null;
-			}
-
-			if (cached == null)
-			{
-				cached = Gdk.cairo_surface_create_from_pixbuf(pixbuf, 0, window);
-			}
-
-			return cached;
+			this.old_image = old_image;
+			this.new_image = new_image;
+			this.difference = difference;
 		}
 	}
 }
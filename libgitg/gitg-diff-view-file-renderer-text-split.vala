@@ -154,10 +154,10 @@ class Gitg.DiffViewFileRendererTextSplit : Gtk.Box, DiffSelectable, DiffViewFile
 		can_select = false;
 	}
 
-	public void add_hunk(Ggit.DiffHunk hunk, Gee.ArrayList<Ggit.DiffLine> lines)
+	public void add_hunk(DiffViewHunk hunk)
 	{
-		d_renderer_left.add_hunk(hunk, lines);
-		d_renderer_right.add_hunk(hunk, lines);
+		d_renderer_left.add_hunk(hunk);
+		d_renderer_right.add_hunk(hunk);
 	}
 
 	public bool has_selection
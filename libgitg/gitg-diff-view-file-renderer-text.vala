@@ -34,6 +34,13 @@ class Gitg.DiffViewFileRendererText : Gtk.SourceView, DiffSelectable, DiffViewFi
 		NEW
 	}
 
+	// Number of lines before a hunk that are highlighted along with it, so
+	// that the language state is settled when the hunk starts
+	private const int LEADING_CONTEXT_LINES = 50;
+
+	// Time in microseconds spent inserting lines per main loop iteration
+	private const int64 INSERT_SLICE = 8000;
+
 	private struct Region
 	{
 		public RegionType type;
@@ -57,14 +64,33 @@ class Gitg.DiffViewFileRendererText : Gtk.SourceView, DiffSelectable, DiffViewFi
 	private bool d_highlight;
 
 	private Cancellable? d_higlight_cancellable;
-	private Gtk.SourceBuffer? d_old_highlight_buffer;
-	private Gtk.SourceBuffer? d_new_highlight_buffer;
+	private DiffViewHighlightCache.Entry? d_old_highlight;
+	private DiffViewHighlightCache.Entry? d_new_highlight;
 	private bool d_old_highlight_ready;
 	private bool d_new_highlight_ready;
+	private uint d_highlight_idle;
+	private Gee.HashMap<Gtk.TextTag, Gtk.TextTag> d_highlight_tags;
 
 	private Region[] d_regions;
 	private bool d_constructed;
 
+	// Hunks are inserted a slice of lines at a time, this keeps where the
+	// insertion of a hunk is at between slices
+	private class PendingHunk
+	{
+		public DiffViewHunk hunk;
+		public bool started;
+		public int next;
+		public Region region;
+		public int buffer_line;
+		public int add_line_num;
+		public int remove_line_num;
+		public bool in_change_line;
+	}
+
+	private Gee.ArrayQueue<PendingHunk> d_pending;
+	private uint d_insert_idle;
+
 	private Settings? d_stylesettings;
 
 	private FontManager d_font_manager;
@@ -259,6 +285,20 @@ class Gitg.DiffViewFileRendererText : Gtk.SourceView, DiffSelectable, DiffViewFi
 		}
 
 		d_lines = new Gee.HashMap<int, PatchSet.Patch?>();
+		d_highlight_tags = new Gee.HashMap<Gtk.TextTag, Gtk.TextTag>();
+		d_pending = new Gee.ArrayQueue<PendingHunk>();
+
+		d_stylesettings = try_settings(Gitg.Config.APPLICATION_ID + ".preferences.interface");
+
+		if (d_stylesettings != null)
+		{
+			d_stylesettings.changed["style-scheme"].connect(() => {
+				update_style();
+				update_highlight();
+			});
+
+			update_style();
+		}
 
 		highlight = true;
 	}
@@ -272,6 +312,23 @@ class Gitg.DiffViewFileRendererText : Gtk.SourceView, DiffSelectable, DiffViewFi
 			d_higlight_cancellable.cancel();
 			d_higlight_cancellable = null;
 		}
+
+		if (d_highlight_idle != 0)
+		{
+			Source.remove(d_highlight_idle);
+			d_highlight_idle = 0;
+		}
+
+		if (d_insert_idle != 0)
+		{
+			Source.remove(d_insert_idle);
+			d_insert_idle = 0;
+		}
+	}
+
+	private bool can_highlight()
+	{
+		return d_constructed && highlight && repository != null && delta != null;
 	}
 
 	private void update_highlight()
@@ -287,24 +344,17 @@ class Gitg.DiffViewFileRendererText : Gtk.SourceView, DiffSelectable, DiffViewFi
 			d_higlight_cancellable = null;
 		}
 
-		d_old_highlight_buffer = null;
-		d_new_highlight_buffer = null;
+		d_old_highlight = null;
+		d_new_highlight = null;
 
 		d_old_highlight_ready = false;
 		d_new_highlight_ready = false;
 
-		if (highlight && repository != null && delta != null)
-		{
-			var cancellable = new Cancellable();
-			d_higlight_cancellable = cancellable;
-
-			init_highlighting_buffer_old.begin(cancellable, (obj, res) => {
-				init_highlighting_buffer_old.end(res);
-			});
+		remove_highlight_tags();
 
-			init_highlighting_buffer_new.begin(cancellable, (obj, res) => {
-				init_highlighting_buffer_new.end(res);
-			});
+		if (can_highlight())
+		{
+			queue_highlight();
 		}
 		else
 		{
@@ -312,13 +362,57 @@ class Gitg.DiffViewFileRendererText : Gtk.SourceView, DiffSelectable, DiffViewFi
 		}
 	}
 
-	private async void init_highlighting_buffer_old(Cancellable cancellable)
+	private void queue_highlight()
 	{
-		var buffer = yield init_highlighting_buffer(delta.get_old_file(), false, cancellable);
+		// Hunks are added right after construction, wait for them so that
+		// only the lines that are actually shown get highlighted
+		if (d_highlight_idle != 0)
+		{
+			return;
+		}
+
+		d_highlight_idle = Idle.add(() => {
+			d_highlight_idle = 0;
+
+			// Highlighting is queued again once all lines are inserted
+			if (can_highlight() && d_pending.is_empty)
+			{
+				start_highlight();
+			}
+
+			return false;
+		}, Priority.LOW);
+	}
+
+	private void start_highlight()
+	{
+		if (d_higlight_cancellable != null)
+		{
+			d_higlight_cancellable.cancel();
+		}
+
+		var cancellable = new Cancellable();
+		d_higlight_cancellable = cancellable;
+
+		d_old_highlight_ready = false;
+		d_new_highlight_ready = false;
+
+		init_highlighting_old.begin(cancellable, (obj, res) => {
+			init_highlighting_old.end(res);
+		});
+
+		init_highlighting_new.begin(cancellable, (obj, res) => {
+			init_highlighting_new.end(res);
+		});
+	}
+
+	private async void init_highlighting_old(Cancellable cancellable)
+	{
+		var entry = yield init_highlighting(delta.get_old_file(), false, null, null, true, cancellable);
 
 		if (!cancellable.is_cancelled())
 		{
-			d_old_highlight_buffer = buffer;
+			d_old_highlight = entry;
 			d_old_highlight_ready = true;
 
 			update_highlighting_ready();
@@ -344,128 +438,187 @@ class Gitg.DiffViewFileRendererText : Gtk.SourceView, DiffSelectable, DiffViewFi
 		return workdir.get_child(path);
 	}
 
-	private async void init_highlighting_buffer_new(Cancellable cancellable)
+	private async void init_highlighting_new(Cancellable cancellable)
 	{
-		Gtk.SourceBuffer? buffer;
-
-		var file = delta.get_new_file();
-
-		if (info.new_file_input_stream != null)
-		{
-			// Use once
-			var stream = info.new_file_input_stream;
-			info.new_file_input_stream = null;
+		// Use once
+		var stream = info.new_file_input_stream;
+		info.new_file_input_stream = null;
 
-			buffer = yield init_highlighting_buffer_from_stream(delta.get_new_file(),
-			                                                    get_file_location(file),
-			                                                    stream,
-			                                                    info.new_file_content_type,
-			                                                    cancellable);
-		}
-		else
-		{
-			buffer = yield init_highlighting_buffer(delta.get_new_file(), info.from_workdir, cancellable);
-		}
+		var entry = yield init_highlighting(delta.get_new_file(),
+		                                    info.from_workdir,
+		                                    stream,
+		                                    info.new_file_content_type,
+		                                    false,
+		                                    cancellable);
 
 		if (!cancellable.is_cancelled())
 		{
-			d_new_highlight_buffer = buffer;
+			d_new_highlight = entry;
 			d_new_highlight_ready = true;
 
 			update_highlighting_ready();
 		}
 	}
 
-	private async Gtk.SourceBuffer? init_highlighting_buffer(Ggit.DiffFile file, bool from_workdir, Cancellable cancellable)
+	private DiffViewHighlightCache.Range[] highlight_ranges(bool old)
 	{
-		var id = file.get_oid();
-		var location = get_file_location(file);
+		var lines = new Gee.TreeSet<int>();
 
-		if ((id.is_zero() && !from_workdir) || (location == null && from_workdir))
+		foreach (var region in d_regions)
 		{
-			return null;
+			if ((region.type == RegionType.REMOVED) != old)
+			{
+				continue;
+			}
+
+			for (var i = 0; i < region.length; i++)
+			{
+				lines.add(region.source_line_start + i);
+			}
 		}
 
-		uint8[] content;
+		var ranges = new DiffViewHighlightCache.Range[0];
 
-		if (!from_workdir)
+		foreach (var line in lines)
 		{
-			Ggit.Blob blob;
-
-			try
+			if (ranges.length != 0 && ranges[ranges.length - 1].end == line)
 			{
-				blob = repository.lookup<Ggit.Blob>(id);
+				ranges[ranges.length - 1].end++;
 			}
-			catch
+			else
 			{
-				return null;
+				ranges += DiffViewHighlightCache.Range() {
+					start = line,
+					keep = line,
+					end = line + 1
+				};
 			}
-
-			if (TextConv.has_textconv_command(repository, file))
-				content = TextConv.get_textconv_content(repository, file);
-			else
-				content = blob.get_raw_content();
 		}
-		else
+
+		return ranges;
+	}
+
+	private DiffViewHighlightCache.Range[] missing_ranges(DiffViewHighlightCache.Range[] ranges, DiffViewHighlightCache.Entry? entry)
+	{
+		var ret = new DiffViewHighlightCache.Range[0];
+
+		foreach (var range in ranges)
 		{
-			// Try to read from disk
-			try
-			{
-				// Read it all into a buffer so we can guess the content type from
-				// it. This isn't really nice, but it's simple.
-				yield location.load_contents_async(cancellable, out content, null);
-				if (TextConv.has_textconv_command(repository, file))
-					content = TextConv.get_textconv_content_from_raw(repository, file, content);
-			}
-			catch
+			for (var line = range.keep; line < range.end; line++)
 			{
-				return null;
+				if (entry != null && entry.has_line(line))
+				{
+					continue;
+				}
+
+				var start = int.max(0, line - LEADING_CONTEXT_LINES);
+
+				if (ret.length != 0 && ret[ret.length - 1].end >= start)
+				{
+					ret[ret.length - 1].end = line + 1;
+				}
+				else
+				{
+					ret += DiffViewHighlightCache.Range() {
+						start = start,
+						keep = line,
+						end = line + 1
+					};
+				}
 			}
 		}
 
-		bool uncertain;
-		var content_type = GLib.ContentType.guess(location.get_basename(), content, out uncertain);
+		return ret;
+	}
 
-		var stream = new GLib.MemoryInputStream.from_bytes(new Bytes(content));
+	private Gtk.SourceLanguage? guess_language(string? basename, string? content_type)
+	{
+		var manager = Gtk.SourceLanguageManager.get_default();
+
+		if (content_type == null && basename != null)
+		{
+			bool uncertain;
+			content_type = GLib.ContentType.guess(basename, null, out uncertain);
+		}
 
-		return yield init_highlighting_buffer_from_stream(file, location, stream, content_type, cancellable);
+		return manager.guess_language(basename, content_type);
 	}
 
-	private async Gtk.SourceBuffer? init_highlighting_buffer_from_stream(Ggit.DiffFile file, File location, InputStream stream, string content_type, Cancellable cancellable)
+	private async DiffViewHighlightCache.Entry? init_highlighting(Ggit.DiffFile file,
+	                                                             bool from_workdir,
+	                                                             InputStream? stream,
+	                                                             string? content_type,
+	                                                             bool old,
+	                                                             Cancellable cancellable)
 	{
-		var manager = Gtk.SourceLanguageManager.get_default();
-		var language = manager.guess_language(location != null ? location.get_basename() : null, content_type);
+		var ranges = highlight_ranges(old);
 
-		var buffer = new Gtk.SourceBuffer(this.buffer.tag_table);
+		if (ranges.length == 0)
+		{
+			return null;
+		}
 
-		if (language != null)
+		var id = file.get_oid();
+		var location = get_file_location(file);
+
+		if (stream == null && ((id.is_zero() && !from_workdir) || (location == null && from_workdir)))
 		{
-			buffer.language = language;
+			return null;
 		}
 
-		var style_scheme_manager = Gitg.Utils.get_source_style_manager();
+		var path = file.get_path();
+		var basename = path != null ? Path.get_basename(path) : null;
 
-		buffer.highlight_syntax = true;
+		var cache = DiffViewHighlightCache.@default();
+		var scheme = ((Gtk.SourceBuffer)this.buffer).style_scheme;
+		var language = guess_language(basename, content_type);
 
-		d_stylesettings = try_settings(Gitg.Config.APPLICATION_ID + ".preferences.interface");
-		if (d_stylesettings != null)
-		{
-			d_stylesettings.changed["style-scheme"].connect(update_style);
+		DiffViewHighlightCache.Entry? entry = null;
 
-			update_style();
-		} else {
-			buffer.style_scheme = style_scheme_manager.get_scheme("classic");
+		if (language != null)
+		{
+			entry = cache.lookup(from_workdir ? null : id, language, scheme);
 		}
 
-		var sfile = new Gtk.SourceFile();
-		sfile.location = location;
+		var missing = missing_ranges(ranges, entry);
 
-		var loader = new Gtk.SourceFileLoader.from_stream(buffer, sfile, stream);
+		if (missing.length == 0)
+		{
+			return entry;
+		}
+
+		string text;
+		uint8[]? content = null;
 
 		try
 		{
-			yield loader.load_async(GLib.Priority.LOW, cancellable, null);
-			this.strip_carriage_returns(buffer);
+			if (stream != null)
+			{
+				text = yield DiffViewHighlightCache.read_lines(stream, missing, cancellable);
+			}
+			else if (!from_workdir)
+			{
+				var blob = repository.lookup<Ggit.Blob>(id);
+
+				if (TextConv.has_textconv_command(repository, file))
+					content = yield repository.textconv.convert_file(file, cancellable);
+				else
+					content = blob.get_raw_content();
+
+				text = DiffViewHighlightCache.extract_lines(content, missing);
+			}
+			else if (TextConv.has_textconv_command(repository, file))
+			{
+				yield location.load_contents_async(cancellable, out content, null);
+				content = yield repository.textconv.convert_raw(file, content, cancellable);
+
+				text = DiffViewHighlightCache.extract_lines(content, missing);
+			}
+			else
+			{
+				var input = yield location.read_async(Priority.LOW, cancellable);
+				text = yield DiffViewHighlightCache.read_lines(input, missing, cancellable);
+			}
 		}
 		catch (Error e)
 		{
@@ -473,9 +626,38 @@ class Gitg.DiffViewFileRendererText : Gtk.SourceView, DiffSelectable, DiffViewFi
 			{
 				stderr.printf(@"ERROR: failed to load $(file.get_path()) for highlighting: $(e.message)\n");
 			}
+
+			return null;
+		}
+
+		if (cancellable.is_cancelled())
+		{
+			return null;
+		}
+
+		if (language == null)
+		{
+			if (content == null)
+			{
+				return null;
+			}
+
+			// Could not guess from the file name alone, sniff the content
+			bool uncertain;
+			var head = content[0:int.min(content.length, 4096)];
+
+			language = guess_language(basename, GLib.ContentType.guess(basename, head, out uncertain));
+
+			if (language == null)
+			{
+				return null;
+			}
+
+			entry = cache.lookup(from_workdir ? null : id, language, scheme);
 		}
 
-		return buffer;
+		cache.highlight(entry, text, missing, language, scheme);
+		return entry;
 	}
 
 	private void update_style() {
@@ -499,19 +681,29 @@ class Gitg.DiffViewFileRendererText : Gtk.SourceView, DiffSelectable, DiffViewFi
 		return null;
 	}
 
-	private void strip_carriage_returns(Gtk.SourceBuffer buffer)
+	private void remove_highlight_tags()
 	{
-		var search_settings = new Gtk.SourceSearchSettings();
+		foreach (var tag in d_highlight_tags.values)
+		{
+			buffer.tag_table.remove(tag);
+		}
 
-		search_settings.regex_enabled = true;
-		search_settings.search_text = "\\r";
+		d_highlight_tags.clear();
+	}
 
-		var search_context = new Gtk.SourceSearchContext(buffer, search_settings);
+	private Gtk.TextTag highlight_tag(Gtk.TextTag style)
+	{
+		var tag = d_highlight_tags[style];
 
-		try
+		if (tag == null)
 		{
-			search_context.replace_all("", 0);
-		} catch (Error e) {}
+			tag = buffer.create_tag(null);
+			DiffViewHighlightCache.copy_style(style, tag);
+
+			d_highlight_tags[style] = tag;
+		}
+
+		return tag;
 	}
 
 	private void update_highlighting_ready()
@@ -529,19 +721,19 @@ class Gitg.DiffViewFileRendererText : Gtk.SourceView, DiffSelectable, DiffViewFi
 
 		var buffer = this.buffer;
 
-		// Go over all the source chunks and match up to old/new buffer. Then,
-		// apply the tags that are applied to the highlighted source buffers.
+		// Go over all the source chunks and match up to old/new highlight
+		// runs. Then, apply the tags of the runs to the buffer.
 		foreach (var region in d_regions)
 		{
-			Gtk.SourceBuffer? source;
+			DiffViewHighlightCache.Entry? source;
 
 			if (region.type == RegionType.REMOVED)
 			{
-				source = d_old_highlight_buffer;
+				source = d_old_highlight;
 			}
 			else
 			{
-				source = d_new_highlight_buffer;
+				source = d_new_highlight;
 			}
 
 			if (source == null)
@@ -549,41 +741,42 @@ class Gitg.DiffViewFileRendererText : Gtk.SourceView, DiffSelectable, DiffViewFi
 				continue;
 			}
 
-			Gtk.TextIter buffer_iter, source_iter;
-
-			buffer.get_iter_at_line(out buffer_iter, region.buffer_line_start);
-			source.get_iter_at_line(out source_iter, region.source_line_start);
+			for (var i = 0; i < region.length; i++)
+			{
+				var runs = source.get_line(region.source_line_start + i);
 
-			var source_end_iter = source_iter;
-			source_end_iter.forward_lines(region.length);
+				if (runs == null || runs.tags.length == 0)
+				{
+					continue;
+				}
 
-			source.ensure_highlight(source_iter, source_end_iter);
+				Gtk.TextIter line_start;
+				buffer.get_iter_at_line(out line_start, region.buffer_line_start + i);
 
-			var buffer_end_iter = buffer_iter;
-			buffer_end_iter.forward_lines(region.length);
+				var line_end = line_start;
 
-			var source_next_iter = source_iter;
-			var tags = source_iter.get_tags();
+				if (!line_end.ends_line())
+				{
+					line_end.forward_to_line_end();
+				}
 
-			while (source_next_iter.forward_to_tag_toggle(null) && source_next_iter.compare(source_end_iter) < 0)
-			{
-				var buffer_next_iter = buffer_iter;
-				buffer_next_iter.forward_chars(source_next_iter.get_offset() - source_iter.get_offset());
+				var nchars = line_end.get_line_offset();
 
-				foreach (var tag in tags)
+				for (var r = 0; r < runs.tags.length; r++)
 				{
-					buffer.apply_tag(tag, buffer_iter, buffer_next_iter);
-				}
+					if (runs.starts[r] >= nchars)
+					{
+						continue;
+					}
 
-				source_iter = source_next_iter;
-				buffer_iter = buffer_next_iter;
+					var start = line_start;
+					start.set_line_offset(runs.starts[r]);
 
-				tags = source_iter.get_tags();
-			}
+					var end = line_start;
+					end.set_line_offset(int.min(runs.ends[r], nchars));
 
-			foreach (var tag in tags)
-			{
-				buffer.apply_tag(tag, buffer_iter, buffer_end_iter);
+					buffer.apply_tag(highlight_tag(runs.tags[r]), start, end);
+				}
 			}
 		}
 	}
@@ -674,10 +867,102 @@ class Gitg.DiffViewFileRendererText : Gtk.SourceView, DiffSelectable, DiffViewFi
 		update_highlight();
 	}
 
-	public void add_hunk(Ggit.DiffHunk hunk, Gee.ArrayList<Ggit.DiffLine> lines)
+	public void add_hunk(DiffViewHunk hunk)
 	{
+		d_pending.offer(new PendingHunk() { hunk = hunk });
+
+		if (d_insert_idle != 0)
+		{
+			return;
+		}
+
+		// Insert the first slice right away so that the start of the diff
+		// shows up without waiting for the main loop
+		if (insert_pending())
+		{
+			d_insert_idle = Idle.add(() => {
+				if (insert_pending())
+				{
+					return true;
+				}
+
+				d_insert_idle = 0;
+				return false;
+			});
+		}
+	}
+
+	private void append_line_style(DiffViewLinesRenderer.Line_Style style)
+	{
+		if (d_old_lines != null)
+		{
+			d_old_lines.add_line(style);
+		}
+
+		if (d_new_lines != null)
+		{
+			d_new_lines.add_line(style);
+		}
+
+		d_sym_lines.add_line(style);
+	}
+
+	/*
+	 * Insert pending hunk lines for at most INSERT_SLICE. Returns whether
+	 * there are lines left to insert.
+	 */
+	private bool insert_pending()
+	{
+		var start = get_monotonic_time();
 		var buffer = this.buffer as Gtk.SourceBuffer;
 
+		Gtk.TextIter iter;
+		buffer.get_end_iter(out iter);
+
+		this.freeze_notify();
+
+		while (!d_pending.is_empty)
+		{
+			var pending = d_pending.peek();
+
+			if (!pending.started)
+			{
+				begin_hunk(pending, buffer, ref iter);
+			}
+
+			while (pending.next < pending.hunk.size)
+			{
+				insert_line(pending, buffer, ref iter);
+
+				if ((pending.next % 32) == 0 && get_monotonic_time() - start > INSERT_SLICE)
+				{
+					this.thaw_notify();
+					return true;
+				}
+			}
+
+			if (pending.hunk.size != 0)
+			{
+				d_regions += pending.region;
+			}
+
+			d_pending.poll();
+		}
+
+		this.thaw_notify();
+
+		if (can_highlight())
+		{
+			queue_highlight();
+		}
+
+		return false;
+	}
+
+	private void begin_hunk(PendingHunk pending, Gtk.SourceBuffer buffer, ref Gtk.TextIter iter)
+	{
+		var hunk = pending.hunk.hunk;
+
 		/* Diff hunk */
 		var h = hunk.get_header();
 		var pos = h.last_index_of("@@");
@@ -689,9 +974,6 @@ class Gitg.DiffViewFileRendererText : Gtk.SourceView, DiffSelectable, DiffViewFi
 
 		h = h.chomp();
 
-		Gtk.TextIter iter;
-		buffer.get_end_iter(out iter);
-
 		if (!iter.is_start())
 		{
 			buffer.insert(ref iter, "\n", 1);
@@ -703,237 +985,228 @@ class Gitg.DiffViewFileRendererText : Gtk.SourceView, DiffSelectable, DiffViewFi
 		var header = @"@@ -$(hunk.get_old_start()),$(hunk.get_old_lines()) +$(hunk.get_new_start()),$(hunk.get_new_lines()) @@ $h\n";
 		buffer.insert(ref iter, header, -1);
 
-		int buffer_line = iter.get_line();
-
-		int line_hunk_start = iter.get_line();
+		pending.started = true;
+		pending.buffer_line = iter.get_line();
 
-		var region = Region() {
+		pending.region = Region() {
 			type = RegionType.CONTEXT,
 			buffer_line_start = 0,
 			source_line_start = 0,
 			length = 0
 		};
 
-		this.freeze_notify();
+		if (d_old_lines != null)
+		{
+			d_old_lines.begin_hunk(pending.buffer_line, hunk);
+		}
 
-		var add_line_num = 0;
-		var remove_line_num = 0;
-		var in_change_line = false;
-		for (var i = 0; i < lines.size; i++)
+		if (d_new_lines != null)
 		{
-			var line = lines[i];
-			var text = line.get_text().replace("\r", "");
-			var added = false;
-			var removed = false;
-			var origin = line.get_origin();
+			d_new_lines.begin_hunk(pending.buffer_line, hunk);
+		}
 
-			var rtype = RegionType.CONTEXT;
+		d_sym_lines.begin_hunk(pending.buffer_line, hunk);
 
-			switch (origin)
-			{
-				case Ggit.DiffLineType.ADDITION:
-					added = true;
-					this.added++;
+		sensitive = true;
+	}
 
-					rtype = RegionType.ADDED;
-					break;
-				case Ggit.DiffLineType.DELETION:
-					removed = true;
-					this.removed++;
+	private void insert_line(PendingHunk pending, Gtk.SourceBuffer buffer, ref Gtk.TextIter iter)
+	{
+		var lines = pending.hunk;
+		var i = pending.next++;
 
-					rtype = RegionType.REMOVED;
-					break;
-				case Ggit.DiffLineType.CONTEXT_EOFNL:
-				case Ggit.DiffLineType.ADD_EOFNL:
-				case Ggit.DiffLineType.DEL_EOFNL:
-					text = text.substring(1);
-					break;
-				case Ggit.DiffLineType.HUNK_HDR:
-				case Ggit.DiffLineType.BINARY:
-				case Ggit.DiffLineType.CONTEXT:
-				case Ggit.DiffLineType.FILE_HDR:
-					break;
-			}
+		var text = lines.get_text(i).replace("\r", "");
+		var added = false;
+		var removed = false;
+		var origin = lines.get_origin(i);
 
-			if (i == 0 || rtype != region.type)
-			{
-				if (i != 0)
-				{
-					d_regions += region;
-				}
+		var rtype = RegionType.CONTEXT;
 
-				int source_line_start;
+		switch (origin)
+		{
+			case Ggit.DiffLineType.ADDITION:
+				added = true;
+				this.added++;
 
-				if (rtype == RegionType.REMOVED)
-				{
-					source_line_start = line.get_old_lineno() - 1;
-				}
-				else
-				{
-					source_line_start = line.get_new_lineno() - 1;
-				}
+				rtype = RegionType.ADDED;
+				break;
+			case Ggit.DiffLineType.DELETION:
+				removed = true;
+				this.removed++;
 
-				region = Region() {
-					type = rtype,
-					buffer_line_start = buffer_line,
-					source_line_start = source_line_start,
-					length = 0
-				};
+				rtype = RegionType.REMOVED;
+				break;
+			case Ggit.DiffLineType.CONTEXT_EOFNL:
+			case Ggit.DiffLineType.ADD_EOFNL:
+			case Ggit.DiffLineType.DEL_EOFNL:
+				text = text.substring(1);
+				break;
+			case Ggit.DiffLineType.HUNK_HDR:
+			case Ggit.DiffLineType.BINARY:
+			case Ggit.DiffLineType.CONTEXT:
+			case Ggit.DiffLineType.FILE_HDR:
+				break;
+		}
+
+		if (i == 0 || rtype != pending.region.type)
+		{
+			if (i != 0)
+			{
+				d_regions += pending.region;
 			}
 
-			if (d_style == Style.ONE)
-				region.length++;
+			int source_line_start;
 
-			if (added || removed)
+			if (rtype == RegionType.REMOVED)
+			{
+				source_line_start = lines.get_old_lineno(i) - 1;
+			}
+			else
 			{
-				var offset = (size_t)line.get_content_offset();
-				var bytes = line.get_content();
+				source_line_start = lines.get_new_lineno(i) - 1;
+			}
 
-				var pset = PatchSet.Patch() {
-					type = added ? PatchSet.Type.ADD : PatchSet.Type.REMOVE,
-					old_offset = offset,
-					new_offset = offset,
-					length = bytes.length
-				};
+			pending.region = Region() {
+				type = rtype,
+				buffer_line_start = pending.buffer_line,
+				source_line_start = source_line_start,
+				length = 0
+			};
+		}
 
-				if (added)
-				{
-					pset.old_offset = (size_t)((int64)pset.old_offset - d_doffset);
-				}
-				else
-				{
-					pset.new_offset = (size_t)((int64)pset.new_offset + d_doffset);
-				}
+		if (d_style == Style.ONE)
+			pending.region.length++;
 
-				d_lines[buffer_line] = pset;
-				d_doffset += added ? (int64)bytes.length : -(int64)bytes.length;
-			}
+		if (added || removed)
+		{
+			var offset = (size_t)lines.get_content_offset(i);
+			var length = lines.get_content_length(i);
+
+			var pset = PatchSet.Patch() {
+				type = added ? PatchSet.Type.ADD : PatchSet.Type.REMOVE,
+				old_offset = offset,
+				new_offset = offset,
+				length = length
+			};
 
-			if (i == lines.size - 1 && text.length > 0 && text[text.length - 1] == '\n')
+			if (added)
 			{
-				text = text.slice(0, text.length - 1);
+				pset.old_offset = (size_t)((int64)pset.old_offset - d_doffset);
+			}
+			else
+			{
+				pset.new_offset = (size_t)((int64)pset.new_offset + d_doffset);
 			}
 
-			if (rtype == RegionType.CONTEXT)
+			d_lines[pending.buffer_line] = pset;
+			d_doffset += added ? (int64)length : -(int64)length;
+		}
+
+		if (i == lines.size - 1 && text.length > 0 && text[text.length - 1] == '\n')
+		{
+			text = text.slice(0, text.length - 1);
+		}
+
+		if (rtype == RegionType.CONTEXT)
+		{
+			if (d_style == Style.OLD || d_style == Style.NEW)
 			{
-				if (d_style == Style.OLD || d_style == Style.NEW)
+				if (pending.in_change_line == true)
 				{
-					if (in_change_line == true)
+					bool check = d_style == Style.OLD ? pending.add_line_num > pending.remove_line_num : pending.remove_line_num > pending.add_line_num;
+					if (check)
 					{
-						bool check = d_style == Style.OLD ? add_line_num > remove_line_num : remove_line_num > add_line_num;
-						if (check)
+						int end = d_style == Style.OLD ? pending.add_line_num - pending.remove_line_num : pending.remove_line_num - pending.add_line_num;
+						for (var l = 0; l < end; l++)
 						{
-							int end = d_style == Style.OLD ? add_line_num - remove_line_num : remove_line_num - add_line_num;
-							for (var l = 0; l < end; l++)
-							{
-								Gtk.TextIter t_iter;
-								buffer.get_end_iter(out t_iter);
-								buffer.create_source_mark(null, "empty", t_iter);
-
-								buffer.insert(ref iter, "\n", -1);
-								buffer_line++;
-								region.buffer_line_start = buffer_line;
-							}
-						}
+							buffer.create_source_mark(null, "empty", iter);
 
-						add_line_num = 0;
-						remove_line_num = 0;
+							buffer.insert(ref iter, "\n", -1);
+							append_line_style(DiffViewLinesRenderer.Line_Style.EMPTY);
+							pending.buffer_line++;
+							pending.region.buffer_line_start = pending.buffer_line;
+						}
 					}
 
-					in_change_line = false;
+					pending.add_line_num = 0;
+					pending.remove_line_num = 0;
 				}
 
-				buffer.insert(ref iter, text, -1);
-				buffer_line++;
-				if (d_style == Style.OLD || d_style == Style.NEW)
-				{
-					region.length++;
-				}
+				pending.in_change_line = false;
 			}
 
-			RegionType? rtype_check = null;
-			string mark = null;
-			switch (d_style)
+			buffer.insert(ref iter, text, -1);
+			append_line_style(DiffViewLinesRenderer.Line_Style.CONTEXT);
+			pending.buffer_line++;
+			if (d_style == Style.OLD || d_style == Style.NEW)
 			{
-			case Style.ONE:
-			case Style.OLD:
-				rtype_check = RegionType.REMOVED;
-				mark = "removed";
-				break;
-			case Style.NEW:
-				rtype_check = RegionType.ADDED;
-				mark = "added";
-				break;
+				pending.region.length++;
 			}
+		}
 
-			if (rtype == rtype_check)
-			{
-				Gtk.TextIter t_iter;
-				buffer.get_end_iter(out t_iter);
-				buffer.create_source_mark(null, mark, t_iter);
-
-				buffer.insert(ref iter, text, -1);
-				buffer_line++;
-				if (d_style == Style.OLD || d_style == Style.NEW)
-				{
-					region.length++;
+		RegionType? rtype_check = null;
+		string mark = null;
+		var mark_style = DiffViewLinesRenderer.Line_Style.REMOVED;
+		switch (d_style)
+		{
+		case Style.ONE:
+		case Style.OLD:
+			rtype_check = RegionType.REMOVED;
+			mark = "removed";
+			break;
+		case Style.NEW:
+			rtype_check = RegionType.ADDED;
+			mark = "added";
+			mark_style = DiffViewLinesRenderer.Line_Style.ADDED;
+			break;
+		}
 
-					if (d_style == Style.OLD)
-						remove_line_num++;
-					else
-						add_line_num++;
-					in_change_line = true;
-				}
-			}
+		if (rtype == rtype_check)
+		{
+			buffer.create_source_mark(null, mark, iter);
 
-			switch (d_style)
+			buffer.insert(ref iter, text, -1);
+			append_line_style(mark_style);
+			pending.buffer_line++;
+			if (d_style == Style.OLD || d_style == Style.NEW)
 			{
-			case Style.ONE:
-			case Style.OLD:
-				rtype_check = RegionType.ADDED;
-				break;
-			case Style.NEW:
-				rtype_check = RegionType.REMOVED;
-				break;
-			}
-			if (rtype == rtype_check)
-			{
-				if (d_style == Style.OLD || d_style == Style.NEW)
-				{
-					if (d_style == Style.OLD)
-						add_line_num++;
-					else
-						remove_line_num++;
-					in_change_line = true;
-				} else if (d_style == Style.ONE) {
-					Gtk.TextIter t_iter;
-					buffer.get_end_iter(out t_iter);
-					buffer.create_source_mark(null, "added", t_iter);
-
-					buffer.insert(ref iter, text, -1);
-					buffer_line++;
-				}
-			}
-		}
+				pending.region.length++;
 
-		if (lines.size != 0)
-		{
-			d_regions += region;
+				if (d_style == Style.OLD)
+					pending.remove_line_num++;
+				else
+					pending.add_line_num++;
+				pending.in_change_line = true;
+			}
 		}
 
-		if (d_style == Style.ONE || d_style == Style.OLD)
+		switch (d_style)
 		{
-			d_old_lines.add_hunk(line_hunk_start, iter.get_line(), hunk, buffer);
+		case Style.ONE:
+		case Style.OLD:
+			rtype_check = RegionType.ADDED;
+			break;
+		case Style.NEW:
+			rtype_check = RegionType.REMOVED;
+			break;
 		}
-		if (d_style == Style.ONE || d_style == Style.NEW)
+		if (rtype == rtype_check)
 		{
-			d_new_lines.add_hunk(line_hunk_start, iter.get_line(), hunk, buffer);
-		}
-		d_sym_lines.add_hunk(line_hunk_start, iter.get_line(), hunk, buffer);
-
-		this.thaw_notify();
+			if (d_style == Style.OLD || d_style == Style.NEW)
+			{
+				if (d_style == Style.OLD)
+					pending.add_line_num++;
+				else
+					pending.remove_line_num++;
+				pending.in_change_line = true;
+			} else if (d_style == Style.ONE) {
+				buffer.create_source_mark(null, "added", iter);
 
-		sensitive = true;
+				buffer.insert(ref iter, text, -1);
+				append_line_style(DiffViewLinesRenderer.Line_Style.ADDED);
+				pending.buffer_line++;
+			}
+		}
 	}
 }
 
@@ -80,20 +80,33 @@ class Gitg.DiffViewFile : Gtk.Grid
 	}
 
 	public DiffViewFileInfo? info {get; construct set;}
+
+	// Identifies the content the file was created from, set when it can be
+	// shown again for a later diff of the same content
+	public string? content_key;
 	private Gee.HashMap<Gtk.Widget, bool> d_diff_stat_visible_map = new Gee.HashMap<Gtk.Widget, bool>();
 
-	public bool has_selection()
+	public bool has_selection { get; private set; }
+
+	private void update_has_selection()
 	{
-		bool has_selection = false;
+		bool selected = false;
+
 		foreach (DiffViewFileRenderer renderer in renderer_list)
 		{
 			var selectable = renderer as DiffSelectable;
-			if (selectable != null)
-				has_selection = selectable.has_selection;
-			if (has_selection)
+
+			if (selectable != null && selectable.has_selection)
+			{
+				selected = true;
 				break;
+			}
+		}
+
+		if (selected != has_selection)
+		{
+			has_selection = selected;
 		}
-		return has_selection;
 	}
 
 	public void clear_selection()
@@ -101,7 +114,11 @@ class Gitg.DiffViewFile : Gtk.Grid
 		foreach (var renderer in renderer_list)
 		{
 			var sel = renderer as DiffSelectable;
-			sel.clear_selection();
+
+			if (sel != null)
+			{
+				sel.clear_selection();
+			}
 		}
 	}
 
@@ -142,7 +159,30 @@ class Gitg.DiffViewFile : Gtk.Grid
 	{
 		d_diff_stat_visible_map.set(widget, show_stats);
 		renderer_list.add(renderer);
+
+		var selectable = renderer as DiffSelectable;
+
+		if (selectable != null)
+		{
+			selectable.notify["has-selection"].connect(update_has_selection);
+		}
 		d_stack_file_renderer.add_titled(widget, name, title);
+
+		if (d_expanded)
+		{
+			d_stack_switcher.set_visible(d_stack_file_renderer.get_children().length() > 1);
+		}
+	}
+
+	/*
+	 * Show line statistics for a file whose hunks are not loaded yet.
+	 * Once a text renderer is added, it keeps the statistics up to date.
+	 */
+	public void set_stats(uint added, uint removed)
+	{
+		d_diff_stat_file.added = added;
+		d_diff_stat_file.removed = removed;
+		d_diff_stat_file.set_visible(added != 0 || removed != 0);
 	}
 
 	private void setup_hscrollbar_margins(Gtk.ScrolledWindow sw, Gtk.TextView view)
@@ -348,11 +388,11 @@ class Gitg.DiffViewFile : Gtk.Grid
 		return true;
 	}
 
-	public void add_hunk(Ggit.DiffHunk hunk, Gee.ArrayList<Ggit.DiffLine> lines)
+	public void add_hunk(DiffViewHunk hunk)
 	{
 		foreach (DiffViewFileRenderer renderer in renderer_list)
 		{
-			renderer.add_hunk(hunk, lines);
+			renderer.add_hunk(hunk);
 		}
 	}
 }
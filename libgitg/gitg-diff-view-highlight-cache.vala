@@ -0,0 +1,416 @@
+/*
+ * This file is part of gitg
+ *
+ * Copyright (C) 2026 - Alberto Fanjul
+ *
+ * gitg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gitg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gitg. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Highlighting for diff renderers is computed on small excerpts of a file
+ * (the hunk lines plus some leading context) instead of on the whole file.
+ * The resulting tag runs are kept per source line, keyed by blob id,
+ * language and style scheme, so that a blob that shows up in several
+ * commits is only highlighted once.
+ */
+class Gitg.DiffViewHighlightCache : Object
+{
+	private const int MAX_ENTRIES = 128;
+
+	public struct Range
+	{
+		// First source line present in the excerpt (includes leading context)
+		public int start;
+
+		// First source line for which tag runs are stored
+		public int keep;
+
+		// Source line after the last line of the excerpt
+		public int end;
+	}
+
+	public class Line
+	{
+		public int[] starts;
+		public int[] ends;
+		public Gtk.TextTag[] tags;
+
+		public Line()
+		{
+			starts = new int[0];
+			ends = new int[0];
+			tags = new Gtk.TextTag[0];
+		}
+
+		public void add(int start, int end, Gtk.TextTag tag)
+		{
+			starts += start;
+			ends += end;
+			tags += tag;
+		}
+	}
+
+	public class Entry : Object
+	{
+		private Gee.HashMap<int, Line> d_lines;
+
+		construct
+		{
+			d_lines = new Gee.HashMap<int, Line>();
+		}
+
+		public Line? get_line(int line)
+		{
+			return d_lines[line];
+		}
+
+		public bool has_line(int line)
+		{
+			return d_lines.has_key(line);
+		}
+
+		public void set_line(int line, Line runs)
+		{
+			d_lines[line] = runs;
+		}
+	}
+
+	private static string[] s_style_properties = {
+		"foreground-rgba",
+		"background-rgba",
+		"paragraph-background-rgba",
+		"style",
+		"weight",
+		"underline",
+		"underline-rgba",
+		"strikethrough",
+		"scale"
+	};
+
+	private static string[] s_style_set_properties = {
+		"foreground-set",
+		"background-set",
+		"paragraph-background-set",
+		"style-set",
+		"weight-set",
+		"underline-set",
+		"underline-rgba-set",
+		"strikethrough-set",
+		"scale-set"
+	};
+
+	private Gee.HashMap<string, Entry> d_entries;
+	private Gee.LinkedList<string> d_lru;
+	private Gee.HashMap<string, Gtk.TextTag> d_styles;
+
+	private static DiffViewHighlightCache? s_instance;
+
+	construct
+	{
+		d_entries = new Gee.HashMap<string, Entry>();
+		d_lru = new Gee.LinkedList<string>();
+		d_styles = new Gee.HashMap<string, Gtk.TextTag>();
+	}
+
+	private DiffViewHighlightCache()
+	{
+		Object();
+	}
+
+	public static DiffViewHighlightCache @default()
+	{
+		if (s_instance == null)
+		{
+			s_instance = new DiffViewHighlightCache();
+		}
+
+		return s_instance;
+	}
+
+	/*
+	 * Get the entry for a blob. Entries without an id (e.g. working
+	 * directory files) are never stored since their content can change.
+	 */
+	public Entry lookup(Ggit.OId? id, Gtk.SourceLanguage language, Gtk.SourceStyleScheme? scheme)
+	{
+		if (id == null || id.is_zero())
+		{
+			return new Entry();
+		}
+
+		var scheme_id = scheme != null ? scheme.get_id() : "";
+		var key = @"$(id.to_string()) $(language.get_id()) $scheme_id";
+
+		var entry = d_entries[key];
+
+		if (entry != null)
+		{
+			d_lru.remove(key);
+			d_lru.add(key);
+
+			return entry;
+		}
+
+		entry = new Entry();
+
+		d_entries[key] = entry;
+		d_lru.add(key);
+
+		while (d_lru.size > MAX_ENTRIES)
+		{
+			d_entries.unset(d_lru.poll_head());
+		}
+
+		return entry;
+	}
+
+	/*
+	 * Highlight an excerpt built by extract_lines() or read_lines() for the
+	 * given ranges and store the tag runs of the kept lines in entry.
+	 */
+	public void highlight(Entry entry, string text, Range[] ranges, Gtk.SourceLanguage language, Gtk.SourceStyleScheme? scheme)
+	{
+		var buffer = new Gtk.SourceBuffer(null);
+
+		buffer.language = language;
+
+		if (scheme != null)
+		{
+			buffer.style_scheme = scheme;
+		}
+
+		buffer.highlight_syntax = true;
+
+		var excerpt = text.replace("\r", "");
+
+		if (!excerpt.validate())
+		{
+			excerpt = excerpt.make_valid();
+		}
+
+		buffer.set_text(excerpt);
+
+		Gtk.TextIter start, end;
+		buffer.get_bounds(out start, out end);
+		buffer.ensure_highlight(start, end);
+
+		var offset = 0;
+
+		foreach (var range in ranges)
+		{
+			for (var line = range.keep; line < range.end; line++)
+			{
+				entry.set_line(line, collect_line(buffer, offset + line - range.start));
+			}
+
+			offset += range.end - range.start;
+		}
+	}
+
+	private Line collect_line(Gtk.SourceBuffer buffer, int line)
+	{
+		var ret = new Line();
+
+		Gtk.TextIter iter;
+		buffer.get_iter_at_line(out iter, line);
+
+		if (iter.get_line() != line)
+		{
+			return ret;
+		}
+
+		var end = iter;
+
+		if (!end.ends_line())
+		{
+			end.forward_to_line_end();
+		}
+
+		while (iter.compare(end) < 0)
+		{
+			var next = iter;
+
+			if (!next.forward_to_tag_toggle(null) || next.compare(end) > 0)
+			{
+				next = end;
+			}
+
+			foreach (var tag in iter.get_tags())
+			{
+				ret.add(iter.get_line_offset(), next.get_line_offset(), intern_style(tag));
+			}
+
+			iter = next;
+		}
+
+		return ret;
+	}
+
+	/*
+	 * Highlight tags belong to the tag table of the temporary buffer, so
+	 * keep a detached copy of their style which renderers can mirror into
+	 * their own tag table.
+	 */
+	private Gtk.TextTag intern_style(Gtk.TextTag tag)
+	{
+		var key = new StringBuilder();
+
+		for (var i = 0; i < s_style_properties.length; i++)
+		{
+			bool isset;
+			tag.get(s_style_set_properties[i], out isset);
+
+			if (!isset)
+			{
+				continue;
+			}
+
+			var pspec = tag.get_class().find_property(s_style_properties[i]);
+			var val = Value(pspec.value_type);
+
+			tag.get_property(s_style_properties[i], ref val);
+
+			if (pspec.value_type == typeof(Gdk.RGBA))
+			{
+				Gdk.RGBA *rgba = (Gdk.RGBA *)val.get_boxed();
+				key.append_printf("%s=%s;", s_style_properties[i], rgba != null ? rgba->to_string() : "");
+			}
+			else
+			{
+				key.append_printf("%s=%s;", s_style_properties[i], val.strdup_contents());
+			}
+		}
+
+		var style = d_styles[key.str];
+
+		if (style == null)
+		{
+			style = new Gtk.TextTag(null);
+			copy_style(tag, style);
+
+			d_styles[key.str] = style;
+		}
+
+		return style;
+	}
+
+	public static void copy_style(Gtk.TextTag source, Gtk.TextTag target)
+	{
+		for (var i = 0; i < s_style_properties.length; i++)
+		{
+			bool isset;
+			source.get(s_style_set_properties[i], out isset);
+
+			if (!isset)
+			{
+				continue;
+			}
+
+			var pspec = source.get_class().find_property(s_style_properties[i]);
+			var val = Value(pspec.value_type);
+
+			source.get_property(s_style_properties[i], ref val);
+			target.set_property(s_style_properties[i], val);
+		}
+	}
+
+	private static void append_line(StringBuilder builder, uint8[] data)
+	{
+		if (data.length != 0)
+		{
+			builder.append_len((string)data, data.length);
+		}
+
+		builder.append_c('\n');
+	}
+
+	/*
+	 * Build an excerpt of exactly (end - start) lines for each of the
+	 * ranges, which must be sorted and non-overlapping. Lines past the
+	 * end of the content are left empty.
+	 */
+	public static string extract_lines(uint8[] content, Range[] ranges)
+	{
+		var builder = new StringBuilder();
+		var line = 0;
+		var pos = 0;
+
+		foreach (var range in ranges)
+		{
+			while (line < range.end)
+			{
+				var eol = pos;
+
+				while (eol < content.length && content[eol] != '\n')
+				{
+					eol++;
+				}
+
+				if (line >= range.start)
+				{
+					append_line(builder, content[pos:eol]);
+				}
+
+				line++;
+				pos = int.min(eol + 1, content.length);
+			}
+		}
+
+		return builder.str;
+	}
+
+	/*
+	 * Same as extract_lines(), but reads from a stream, stopping after the
+	 * last line that is needed.
+	 */
+	public static async string read_lines(InputStream stream, Range[] ranges, Cancellable? cancellable) throws Error
+	{
+		var data = new DataInputStream(stream);
+		data.newline_type = DataStreamNewlineType.LF;
+
+		var builder = new StringBuilder();
+		var line = 0;
+		var eof = false;
+
+		foreach (var range in ranges)
+		{
+			while (line < range.end)
+			{
+				string? text = null;
+
+				if (!eof)
+				{
+					text = yield data.read_line_async(Priority.LOW, cancellable);
+					eof = (text == null);
+				}
+
+				if (line >= range.start)
+				{
+					if (text != null)
+					{
+						builder.append(text);
+					}
+
+					builder.append_c('\n');
+				}
+
+				line++;
+			}
+		}
+
+		return builder.str;
+	}
+}
+
+// ex:ts=4 noet
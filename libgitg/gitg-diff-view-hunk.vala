@@ -0,0 +1,118 @@
+/*
+ * This file is part of gitg
+ *
+ * Copyright (C) 2026 - Alberto Fanjul
+ *
+ * gitg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gitg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gitg. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The lines of a diff hunk. The content of all lines is stored back to
+ * back in a single buffer, and the other fields of each line in flat
+ * arrays, instead of keeping a Ggit.DiffLine object around per line.
+ */
+class Gitg.DiffViewHunk : Object
+{
+	public Ggit.DiffHunk hunk { get; construct set; }
+
+	private ByteArray d_content;
+	private int[] d_offsets;
+	private Ggit.DiffLineType[] d_origins;
+	private int[] d_old_linenos;
+	private int[] d_new_linenos;
+	private int64[] d_content_offsets;
+
+	public int size
+	{
+		get { return d_origins.length; }
+	}
+
+	public DiffViewHunk(Ggit.DiffHunk hunk)
+	{
+		Object(hunk: hunk);
+	}
+
+	construct
+	{
+		d_content = new ByteArray();
+		d_offsets = new int[] {0};
+		d_origins = new Ggit.DiffLineType[0];
+		d_old_linenos = new int[0];
+		d_new_linenos = new int[0];
+		d_content_offsets = new int64[0];
+	}
+
+	public static DiffViewHunk from_patch(Ggit.Patch patch, int index) throws Error
+	{
+		var ret = new DiffViewHunk(patch.get_hunk(index));
+		var nlines = patch.get_num_lines_in_hunk(index);
+
+		for (var i = 0; i < nlines; i++)
+		{
+			ret.add(patch.get_line_in_hunk(index, i));
+		}
+
+		return ret;
+	}
+
+	public void add(Ggit.DiffLine line)
+	{
+		d_content.append(line.get_content());
+
+		d_offsets += (int)d_content.len;
+		d_origins += line.get_origin();
+		d_old_linenos += line.get_old_lineno();
+		d_new_linenos += line.get_new_lineno();
+		d_content_offsets += line.get_content_offset();
+	}
+
+	public Ggit.DiffLineType get_origin(int i)
+	{
+		return d_origins[i];
+	}
+
+	public int get_old_lineno(int i)
+	{
+		return d_old_linenos[i];
+	}
+
+	public int get_new_lineno(int i)
+	{
+		return d_new_linenos[i];
+	}
+
+	public int64 get_content_offset(int i)
+	{
+		return d_content_offsets[i];
+	}
+
+	public int get_content_length(int i)
+	{
+		return d_offsets[i + 1] - d_offsets[i];
+	}
+
+	public string get_text(int i)
+	{
+		var length = get_content_length(i);
+
+		if (length == 0)
+		{
+			return "";
+		}
+
+		return ((string)(&d_content.data[d_offsets[i]])).ndup(length);
+	}
+}
+
+// ex:ts=4 noet
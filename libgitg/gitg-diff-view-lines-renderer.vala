@@ -28,7 +28,7 @@ class Gitg.DiffViewLinesRenderer : Gtk.SourceGutterRendererText
 		SYMBOL_NEW
 	}
 
-	private enum Line_Style
+	public enum Line_Style
 	{
 		CONTEXT,
 		ADDED,
@@ -38,19 +38,24 @@ class Gitg.DiffViewLinesRenderer : Gtk.SourceGutterRendererText
 
 	private int d_num_digits;
 	private string d_num_digits_fill;
+	private int d_max_line;
 
 	private ulong d_view_style_updated_id;
 
-	private struct HunkInfo
+	// Lines are added to the last hunk while its lines are inserted in the
+	// buffer. Each line stores its line number (or 0 when it has none), or
+	// for symbol styles 1 for added and -1 for removed lines.
+	private class HunkInfo
 	{
-		int start;
-		int end;
-		int hunk_line;
-		Ggit.DiffHunk hunk;
-		string[] line_infos;
+		public int start;
+		public int end;
+		public int hunk_line;
+		public int oldn;
+		public int newn;
+		public int[] values;
 	}
 
-	private Gee.ArrayList<HunkInfo?> d_hunks_list;
+	private Gee.ArrayList<HunkInfo> d_hunks_list;
 
 	public Style style
 	{
@@ -81,7 +86,7 @@ class Gitg.DiffViewLinesRenderer : Gtk.SourceGutterRendererText
 
 	construct
 	{
-		d_hunks_list = new Gee.ArrayList<HunkInfo?>();
+		d_hunks_list = new Gee.ArrayList<HunkInfo>();
 
 		set_alignment(1.0f, 0.5f);
 		calculate_num_digits();
@@ -92,29 +97,43 @@ class Gitg.DiffViewLinesRenderer : Gtk.SourceGutterRendererText
 		get { return get_view().buffer; }
 	}
 
-	protected override void query_data(Gtk.TextIter start, Gtk.TextIter end, Gtk.SourceGutterRendererState state)
+	private HunkInfo? find_hunk(int line)
 	{
-		var line = start.get_line();
-		bool is_hunk = false;
-		HunkInfo? info = null;
+		// Hunks are sorted by their line in the buffer
+		var lo = 0;
+		var hi = d_hunks_list.size;
 
-		foreach (var i in d_hunks_list)
+		while (lo < hi)
 		{
-			if (line == i.hunk_line)
+			var mid = (lo + hi) / 2;
+
+			if (d_hunks_list[mid].hunk_line <= line)
 			{
-				is_hunk = true;
-				break;
+				lo = mid + 1;
 			}
-			else if (line >= i.start && line <= i.end)
+			else
 			{
-				info = i;
-				break;
+				hi = mid;
 			}
 		}
 
-		if (info == null || (line - info.start) >= info.line_infos.length)
+		return lo > 0 ? d_hunks_list[lo - 1] : null;
+	}
+
+	protected override void query_data(Gtk.TextIter start, Gtk.TextIter end, Gtk.SourceGutterRendererState state)
+	{
+		var line = start.get_line();
+		var info = find_hunk(line);
+
+		if (info == null)
 		{
-			if (is_hunk && style != Style.SYMBOL && style != Style.SYMBOL_OLD && style != Style.SYMBOL_NEW)
+			set_text("", -1);
+			return;
+		}
+
+		if (line == info.hunk_line)
+		{
+			if (style != Style.SYMBOL && style != Style.SYMBOL_OLD && style != Style.SYMBOL_NEW)
 			{
 				set_text("...", -1);
 			}
@@ -122,10 +141,29 @@ class Gitg.DiffViewLinesRenderer : Gtk.SourceGutterRendererText
 			{
 				set_text("", -1);
 			}
+
+			return;
 		}
-		else
+
+		var i = line - info.start;
+
+		if (i >= info.values.length)
+		{
+			set_text("", -1);
+			return;
+		}
+
+		var val = info.values[i];
+
+		switch (style)
 		{
-			set_text(info.line_infos[start.get_line() - info.start], -1);
+		case Style.OLD:
+		case Style.NEW:
+			set_text(val > 0 ? "%*d".printf(d_num_digits, val) : "", -1);
+			break;
+		default:
+			set_text(val > 0 ? "+" : (val < 0 ? "-" : ""), -1);
+			break;
 		}
 	}
 
@@ -170,22 +208,16 @@ class Gitg.DiffViewLinesRenderer : Gtk.SourceGutterRendererText
 		{
 			num_digits = 3;
 
-			foreach (var info in d_hunks_list)
-			{
-				var oldn = info.hunk.get_old_start() + info.hunk.get_old_lines();
-				var newn = info.hunk.get_new_start() + info.hunk.get_new_lines();
-
-				var num = int.max(int.max(oldn, newn), d_maxlines);
+			var num = int.max(d_max_line, d_maxlines);
+			var digits = 0;
 
-				var hunk_digits = 0;
-				while (num > 0)
-				{
-					++hunk_digits;
-					num /= 10;
-				}
-
-				num_digits = int.max(num_digits, hunk_digits);
+			while (num > 0)
+			{
+				++digits;
+				num /= 10;
 			}
+
+			num_digits = int.max(num_digits, digits);
 		}
 		else
 		{
@@ -196,109 +228,85 @@ class Gitg.DiffViewLinesRenderer : Gtk.SourceGutterRendererText
 		d_num_digits_fill = string.nfill(num_digits, ' ');
 	}
 
-	private Line_Style get_origin(int buffer_line, Gtk.SourceBuffer buffer)
+	/*
+	 * Start a hunk, its header is on the line before buffer_line_start.
+	 * Its lines are then added with add_line as they are inserted.
+	 */
+	public void begin_hunk(int buffer_line_start, Ggit.DiffHunk hunk)
 	{
-		var origin = Line_Style.CONTEXT;
-
-		var mark = buffer.get_source_marks_at_line(buffer_line, null);
-		if (mark != null)
-		{
-			mark.@foreach ((item) => {
-				switch (item.get_category())
-				{
-				case "added":
-					origin = Line_Style.ADDED;
-					break;
-				case "removed":
-					origin = Line_Style.REMOVED;
-					break;
-				case "empty":
-					origin = Line_Style.EMPTY;
-					break;
-				}
-			});
-		}
-
-		return origin;
-	}
+		var info = new HunkInfo();
 
-	private string[] precalculate_line_strings(Ggit.DiffHunk hunk, Gtk.SourceBuffer buffer, int buffer_line_start)
-	{
-		var oldn = hunk.get_old_start();
-		var newn = hunk.get_new_start();
+		info.start = buffer_line_start;
+		info.end = buffer_line_start - 1;
+		info.hunk_line = buffer_line_start - 1;
+		info.oldn = hunk.get_old_start();
+		info.newn = hunk.get_new_start();
+		info.values = new int[0];
 
-		Gtk.TextIter iter;
-		buffer.get_end_iter(out iter);
-		int buffer_line_end = iter.get_line();
+		d_hunks_list.add(info);
 
-		var line_infos = new string[buffer_line_end - buffer_line_start + 1];
+		var max_line = int.max(hunk.get_old_start() + hunk.get_old_lines(),
+		                       hunk.get_new_start() + hunk.get_new_lines());
 
-		for (var i = 0; i <= (buffer_line_end - buffer_line_start); i++)
+		if (max_line > d_max_line)
 		{
-			var origin = get_origin(buffer_line_start + i, buffer);
+			var num_digits = d_num_digits;
 
-			string ltext = "";
+			d_max_line = max_line;
+			calculate_num_digits();
 
-			switch (style)
+			if (num_digits != d_num_digits)
 			{
-			case Style.NEW:
-				if (origin == Line_Style.CONTEXT || origin == Line_Style.ADDED)
-				{
-					ltext = "%*d".printf(d_num_digits, newn);
-					newn++;
-				}
-				break;
-			case Style.OLD:
-				if (origin == Line_Style.CONTEXT || origin == Line_Style.REMOVED)
-				{
-					ltext = "%*d".printf(d_num_digits, oldn);
-					oldn++;
-				}
-				break;
-			case Style.SYMBOL:
-				if (origin == Line_Style.ADDED)
-				{
-					ltext = "+";
-				}
-				else if (origin == Line_Style.REMOVED)
-				{
-					ltext = "-";
-				}
-				break;
-			case Style.SYMBOL_OLD:
-				if (origin == Line_Style.REMOVED)
-				{
-					ltext = "-";
-				}
-				break;
-			case Style.SYMBOL_NEW:
-				if (origin == Line_Style.ADDED)
-				{
-					ltext = "+";
-				}
-				break;
+				recalculate_size();
 			}
-
-			line_infos[i] = ltext;
 		}
-
-		return line_infos;
 	}
-	public void add_hunk(int buffer_line_start, int buffer_line_end, Ggit.DiffHunk hunk, Gtk.SourceBuffer buffer)
-	{
-		HunkInfo info = HunkInfo();
-
-		calculate_num_digits();
 
-		info.start = buffer_line_start;
-		info.end = buffer_line_end;
-		info.hunk_line = buffer_line_start - 1;
-		info.hunk = hunk;
-		info.line_infos = precalculate_line_strings(hunk, buffer, buffer_line_start);
+	public void add_line(Line_Style origin)
+	{
+		var info = d_hunks_list[d_hunks_list.size - 1];
+		var val = 0;
 
-		d_hunks_list.add(info);
+		switch (style)
+		{
+		case Style.NEW:
+			if (origin == Line_Style.CONTEXT || origin == Line_Style.ADDED)
+			{
+				val = info.newn++;
+			}
+			break;
+		case Style.OLD:
+			if (origin == Line_Style.CONTEXT || origin == Line_Style.REMOVED)
+			{
+				val = info.oldn++;
+			}
+			break;
+		case Style.SYMBOL:
+			if (origin == Line_Style.ADDED)
+			{
+				val = 1;
+			}
+			else if (origin == Line_Style.REMOVED)
+			{
+				val = -1;
+			}
+			break;
+		case Style.SYMBOL_OLD:
+			if (origin == Line_Style.REMOVED)
+			{
+				val = -1;
+			}
+			break;
+		case Style.SYMBOL_NEW:
+			if (origin == Line_Style.ADDED)
+			{
+				val = 1;
+			}
+			break;
+		}
 
-		recalculate_size();
+		info.values += val;
+		info.end++;
 	}
 }
 
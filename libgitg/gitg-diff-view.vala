@@ -17,6 +17,15 @@
  * along with gitg. If not, see <http://www.gnu.org/licenses/>.
  */
 
+public enum Gitg.DiffSimilarity
+{
+	NONE,
+	DETECTING,
+	EXACT,
+	LIMITED,
+	TIMED_OUT
+}
+
 [GtkTemplate( ui = "/org/gnome/gitg/ui/gitg-diff-view.ui" )]
 public class Gitg.DiffView : Gtk.Grid
 {
@@ -49,6 +58,15 @@ public class Gitg.DiffView : Gtk.Grid
 	private ulong d_parent_commit_notify;
 	private bool d_changes_inline;
 
+	// Files that are collapsed or have a selection, kept up to date by
+	// the files themselves so that neither needs a scan of all files
+	private Gee.HashSet<Gitg.DiffViewFile> d_collapsed_files;
+	private Gee.HashSet<Gitg.DiffViewFile> d_selected_files;
+
+	// Files of the previous diff, by content key, which are shown again
+	// as they are if the next diff has the same content for them
+	private Gee.HashMap<string, Gitg.DiffViewFile> d_reusable_files;
+
 	Gdk.RGBA d_color_link;
 	Gdk.RGBA color_hovered_link;
 	bool hovering_over_link = false;
@@ -59,6 +77,11 @@ public class Gitg.DiffView : Gtk.Grid
 
 	private static Gee.HashSet<string> s_image_mime_types;
 
+	private const int MAX_FILE_QUERIES = 4;
+
+	// Time in microseconds spent adding summary headers per idle iteration
+	private const int64 SUMMARY_SLICE = 10000;
+
 	public Ggit.DiffOptions options
 	{
 		get
@@ -125,6 +148,23 @@ public class Gitg.DiffView : Gtk.Grid
 	public bool handle_selection { get; construct set; default = false; }
 	public bool highlight { get; construct set; default = true; }
 
+	// Rename detection is done in the background for diffs with more
+	// (deleted, added) pairs than this
+	private const int64 SIMILARITY_INLINE_PAIRS = 10000;
+
+	public uint similarity_timeout { get; set; default = 2000; }
+	public int64 similarity_pair_limit { get; set; default = 1000000; }
+
+	// Diffs with more deltas than this only show file headers and line
+	// statistics, hunks are loaded when a file is expanded. 0 disables it.
+	public uint summary_threshold { get; set; default = 1000; }
+
+	public DiffSimilarity similarity
+	{
+		get { return d_commit_details.similarity; }
+		private set { d_commit_details.similarity = value; }
+	}
+
 	private Repository? d_repository;
 
 	private GLib.Regex regex_custom_links = /gitg\.custom-link\.(.+)\.regex/;
@@ -241,11 +281,19 @@ public class Gitg.DiffView : Gtk.Grid
 
 	private void update_expanded_files()
 	{
-		var expanded = d_commit_details.expanded;
-
-		foreach (var file in d_grid_files.get_children())
+		if (d_commit_details.expanded)
+		{
+			foreach (var file in d_collapsed_files.to_array())
+			{
+				file.expanded = true;
+			}
+		}
+		else
 		{
-			((Gitg.DiffViewFile) file).expanded = expanded;
+			foreach (var file in d_grid_files.get_children())
+			{
+				((Gitg.DiffViewFile) file).expanded = false;
+			}
 		}
 	}
 
@@ -271,6 +319,10 @@ public class Gitg.DiffView : Gtk.Grid
 
 	construct
 	{
+		d_collapsed_files = new Gee.HashSet<Gitg.DiffViewFile>();
+		d_selected_files = new Gee.HashSet<Gitg.DiffViewFile>();
+		d_reusable_files = new Gee.HashMap<string, Gitg.DiffViewFile>();
+
 		context_lines = 3;
 	}
 
@@ -529,6 +581,8 @@ public class Gitg.DiffView : Gtk.Grid
 		// the diff content
 		if (d_diff == null && d_commit == null)
 		{
+			destroy_reusable_files();
+
 			d_commit_details.hide();
 			d_scrolledwindow.hide();
 			return;
@@ -541,13 +595,15 @@ public class Gitg.DiffView : Gtk.Grid
 		d_cancellable.cancel();
 		d_cancellable = new Cancellable();
 
+		int parent = 0;
+		similarity = DiffSimilarity.NONE;
+
 		if (d_commit != null)
 		{
 			SignalHandler.block(d_commit_details, d_parent_commit_notify);
 			d_commit_details.commit = d_commit;
 			SignalHandler.unblock(d_commit_details, d_parent_commit_notify);
 
-			int parent = 0;
 			var parents = d_commit.get_parents();
 
 			var parent_commit = d_commit_details.parent_commit;
@@ -566,7 +622,29 @@ public class Gitg.DiffView : Gtk.Grid
 				}
 			}
 
-			d_diff = d_commit.get_diff(options, parent);
+			d_diff = d_commit.get_diff(options, parent, false);
+
+			if (d_diff != null)
+			{
+				// Small diffs are paired right away, large ones are shown
+				// unpaired first and merged once detection is done. Summaries
+				// are never paired inline, their statistics are computed on
+				// unpaired diffs.
+				if (!is_summary(d_diff) && Commit.get_similarity_pairs(d_diff) <= SIMILARITY_INLINE_PAIRS)
+				{
+					try
+					{
+						d_diff.find_similar(null);
+					} catch {}
+
+					similarity = DiffSimilarity.EXACT;
+				}
+				else
+				{
+					similarity = DiffSimilarity.DETECTING;
+				}
+			}
+
 			d_commit_details.show();
 
 			var message = message_without_subject(d_commit);
@@ -590,7 +668,19 @@ public class Gitg.DiffView : Gtk.Grid
 
 		if (d_diff != null)
 		{
-			update_diff(d_diff, preserve_expanded, d_cancellable);
+			var update = update_diff(d_diff, preserve_expanded, d_cancellable);
+
+			if (update.summary)
+			{
+				query_stats(update, d_commit, parent);
+			}
+
+			if (d_commit != null && similarity == DiffSimilarity.DETECTING)
+			{
+				find_similar.begin(d_commit, parent, update, (obj, res) => {
+					find_similar.end(res);
+				});
+			}
 		}
 	}
 
@@ -639,18 +729,9 @@ public class Gitg.DiffView : Gtk.Grid
 		SignalHandler.unblock(d_commit_details, d_expanded_notify);
 	}
 
-	private void on_selection_changed()
+	private void update_has_selection()
 	{
-		bool something_selected = false;
-
-		foreach (var file in d_grid_files.get_children())
-		{
-			if (((Gitg.DiffViewFile) file).has_selection())
-			{
-				something_selected = true;
-				break;
-			}
-		}
+		var something_selected = !d_selected_files.is_empty;
 
 		if (has_selection != something_selected)
 		{
@@ -658,347 +739,219 @@ public class Gitg.DiffView : Gtk.Grid
 		}
 	}
 
-	private string? primary_path(Ggit.DiffDelta delta)
+	private void track_file(Gitg.DiffViewFile file)
 	{
-		var path = delta.get_old_file().get_path();
+		if (!file.expanded)
+		{
+			d_collapsed_files.add(file);
+		}
 
-		if (path == null)
+		if (file.has_selection)
 		{
-			path = delta.get_new_file().get_path();
+			d_selected_files.add(file);
+			update_has_selection();
 		}
 
-		return path;
+		file.notify["expanded"].connect(on_file_expanded);
+		file.notify["has-selection"].connect(on_file_selection_changed);
+		file.destroy.connect(on_file_destroyed);
 	}
 
-	private delegate void Anon();
-
-	private string key_for_delta(Ggit.DiffDelta delta)
+	private void on_file_expanded(Object obj, ParamSpec pspec)
 	{
-		var new_file = delta.get_new_file();
-		var new_path = new_file.get_path();
+		var file = (Gitg.DiffViewFile)obj;
 
-		if (new_path != null)
+		if (file.expanded)
 		{
-			return @"path:$(new_path)";
+			d_collapsed_files.remove(file);
 		}
-
-		var old_file = delta.get_old_file();
-		var old_path = old_file.get_path();
-
-		if (old_path != null)
+		else
 		{
-			return @"path:$(old_path)";
+			d_collapsed_files.add(file);
 		}
 
-		return "";
+		auto_change_expanded(d_collapsed_files.is_empty);
 	}
 
-	private void update_diff(Ggit.Diff diff, bool preserve_expanded, Cancellable? cancellable)
+	private void on_file_selection_changed(Object obj, ParamSpec pspec)
 	{
-		var nqueries = 0;
-		var finished = false;
-		var infomap = new Gee.HashMap<string, DiffViewFileInfo>();
-
-		Anon check_finish = () => {
-			if (nqueries == 0 && finished && (cancellable == null || !cancellable.is_cancelled()))
-			{
-				finished = false;
-				update_diff_hunks(diff, preserve_expanded, infomap, cancellable);
-			}
-		};
+		var file = (Gitg.DiffViewFile)obj;
 
-		// Collect file info asynchronously first
-		for (var i = 0; i < diff.get_num_deltas(); i++)
+		if (file.has_selection)
 		{
-			var delta = diff.get_delta(i);
-			var info = new DiffViewFileInfo(repository, delta, new_is_workdir);
-
-			nqueries++;
-
-			info.query.begin(cancellable, (obj, res) => {
-				info.query.end(res);
-
-				infomap[key_for_delta(delta)] = info;
-
-				nqueries--;
-
-				check_finish();
-			});
+			d_selected_files.add(file);
+		}
+		else
+		{
+			d_selected_files.remove(file);
 		}
 
-		finished = true;
-		check_finish();
+		update_has_selection();
 	}
 
-	private void update_diff_hunks(Ggit.Diff diff, bool preserve_expanded, Gee.HashMap<string, DiffViewFileInfo> infomap, Cancellable? cancellable)
+	private void on_file_destroyed(Gtk.Widget widget)
 	{
-		var files = new Gee.ArrayList<Gitg.DiffViewFile>();
-
-		Gitg.DiffViewFile? current_file = null;
-		Ggit.DiffHunk? current_hunk = null;
-		Gee.ArrayList<Ggit.DiffLine>? current_lines = null;
-		var current_is_binary = false;
+		var file = (Gitg.DiffViewFile)widget;
 
-		var maxlines = 0;
-
-		Anon add_hunk = () => {
-			if (current_hunk != null)
-			{
-				current_file.add_hunk(current_hunk, current_lines);
-
-				current_lines = null;
-				current_hunk = null;
-			}
-		};
-
-		Anon add_file = () => {
-			add_hunk();
-
-			if (current_file != null)
-			{
-				current_file.show();
-
-				files.add(current_file);
-
-				current_file = null;
-			}
-		};
+		d_collapsed_files.remove(file);
 
-		try
+		if (file.content_key != null && d_reusable_files[file.content_key] == file)
 		{
-			diff.foreach(
-				(delta, progress) => {
-					if (cancellable != null && cancellable.is_cancelled())
-					{
-						return 1;
-					}
-
-					add_file();
-
-					DiffViewFileInfo? info = null;
-					var deltakey = key_for_delta(delta);
+			d_reusable_files.unset(file.content_key);
+		}
 
-					if (infomap.has_key(deltakey))
-					{
-						info = infomap[deltakey];
-					}
-					else
-					{
-						info = new DiffViewFileInfo(repository, delta, new_is_workdir);
-					}
+		if (d_selected_files.remove(file))
+		{
+			update_has_selection();
+		}
+	}
 
-					current_is_binary = ((delta.get_flags() & Ggit.DiffFlag.BINARY) != 0);
+	private string? primary_path(Ggit.DiffDelta delta)
+	{
+		var path = delta.get_old_file().get_path();
 
-					// List of known binary file types that may be wrongly classified by
-					// libgit2 because it does not contain any null bytes in the first N
-					// bytes. E.g. PDF
-					var known_binary_files_types = new string[] {"application/pdf"};
+		if (path == null)
+		{
+			path = delta.get_new_file().get_path();
+		}
 
-					// Ignore binary based on content type
-					if (info != null && info.new_file_content_type in known_binary_files_types)
-					{
-						current_is_binary = true;
-					}
+		return path;
+	}
 
-					string? mime_type_for_image = null;
+	/*
+	 * Compute a key identifying the content a file of a diff shown in the
+	 * commit view is computed from: the old blob, the new blob or, for the
+	 * working directory, the size, modification time and inode of the new
+	 * file, and the diff options. Returns null when the file can't be
+	 * reused.
+	 */
+	private string? content_key(Ggit.DiffDelta delta)
+	{
+		if (d_commit != null || repository == null)
+		{
+			return null;
+		}
 
-					if (info == null || info.new_file_content_type == null)
-					{
-						// Guess mime type from old file name in the case of a deleted file
-						var oldpath = delta.get_old_file().get_path();
+		var old_file = delta.get_old_file();
+		var new_file = delta.get_new_file();
 
-						if (oldpath != null)
-						{
-							bool uncertain;
-							var ctype = ContentType.guess(Path.get_basename(oldpath), null, out uncertain);
+		var opts = options;
 
-							if (ctype != null)
-							{
-								mime_type_for_image = ContentType.get_mime_type(ctype);
-							}
-						}
-					}
-					else
-					{
-						mime_type_for_image = ContentType.get_mime_type(info.new_file_content_type);
-					}
+		var key = "%s\n%s\n%d %d %d %d %s".printf(old_file.get_path() ?? "",
+		                                         new_file.get_path() ?? "",
+		                                         (int)delta.get_status(),
+		                                         (int)opts.flags,
+		                                         opts.n_context_lines,
+		                                         opts.n_interhunk_lines,
+		                                         old_file.get_oid().to_string());
 
-					bool can_diff_as_image = mime_type_for_image != null && s_image_mime_types.contains(mime_type_for_image);
-					bool can_diff_as_text = ContentType.is_mime_type(mime_type_for_image, "text/plain");
+		if (!new_is_workdir)
+		{
+			return key + " " + new_file.get_oid().to_string();
+		}
 
-					current_file = new Gitg.DiffViewFile(info);
+		var workdir = repository.get_workdir();
+		var path = new_file.get_path();
 
-					if (can_diff_as_image)
-					{
-						current_file.add_image_renderer();
-					}
-					if (!can_diff_as_image && !current_is_binary && !can_diff_as_text)
-					{
-							//force diff as text if no other diff is possible
-							can_diff_as_text = true;
-					}
-					if (can_diff_as_text)
-					{
-						current_file.add_text_renderer(handle_selection);
-						var renderer_list = current_file.renderer_list;
-						foreach (DiffViewFileRenderer renderer in renderer_list)
-						{
-							var renderer_text = renderer as DiffViewFileRendererTextable;
-							if (renderer_text != null)
-							{
-								bind_property("highlight", renderer_text, "highlight", BindingFlags.SYNC_CREATE);
-								bind_property("wrap-lines", renderer_text, "wrap-lines", BindingFlags.DEFAULT | BindingFlags.SYNC_CREATE);
-								bind_property("tab-width", renderer_text, "tab-width", BindingFlags.DEFAULT | BindingFlags.SYNC_CREATE);
-								renderer_text.maxlines = maxlines;
-								renderer_text.notify["has-selection"].connect(on_selection_changed);
-							}
-						}
-						on_selection_changed();
-					}
-					if (current_is_binary)
-					{
-						try {
-							var new_file = delta.get_new_file();
-							var old_file = delta.get_old_file();
-
-							if (TextConv.has_textconv_command(repository, old_file) || TextConv.has_textconv_command(repository, new_file))
-							{
-								uint8[] n_textconv = TextConv.get_textconv_content(repository, new_file);
-								uint8[] o_textconv = TextConv.get_textconv_content(repository, old_file);
-
-								current_is_binary = false;
-								var opts = new Ggit.DiffOptions();
-								opts.flags = Ggit.DiffOption.INCLUDE_UNTRACKED |
-											Ggit.DiffOption.IGNORE_WHITESPACE |
-											Ggit.DiffOption.DISABLE_PATHSPEC_MATCH |
-											Ggit.DiffOption.RECURSE_UNTRACKED_DIRS;
-								opts.n_context_lines = 3;
-								opts.n_interhunk_lines = 3;
-
-
-								var bdiff = new Ggit.Diff.buffers(o_textconv, old_file.get_path(), n_textconv, new_file.get_path(), opts);
-								bdiff.foreach(
-									(delta, progress) => {
-											if (cancellable != null && cancellable.is_cancelled())
-											{
-												return 1;
-											}
-											deltakey = key_for_delta(delta);
-
-											if (infomap.has_key(deltakey))
-											{
-												info = infomap[deltakey];
-											}
-											else
-											{
-												info = new DiffViewFileInfo(repository, delta, new_is_workdir);
-											}
-												current_file = new Gitg.DiffViewFile(info);
-												current_file.add_text_renderer(handle_selection);
-												return 0;
-											},
-									(delta, binary) => {
-											if (cancellable != null && cancellable.is_cancelled())
-											{
-												return 1;
-											}
-											return 0;
-									},
-									(delta, hunk) => {
-											if (cancellable != null && cancellable.is_cancelled())
-											{
-												return 1;
-											}
-											if (!current_is_binary)
-											{
-												maxlines = int.max(maxlines, hunk.get_old_start() + hunk.get_old_lines());
-												maxlines = int.max(maxlines, hunk.get_new_start() + hunk.get_new_lines());
-
-												add_hunk();
-
-												current_hunk = hunk;
-												current_lines = new Gee.ArrayList<Ggit.DiffLine>();
-											}
-
-											return 0;
-									},
-									(delta, hunk, line) => {
-											if (cancellable != null && cancellable.is_cancelled())
-											{
-												return 1;
-											}
-											if (!current_is_binary)
-											{
-												current_lines.add(line);
-											}
-											return 0;
-									}
-								);
-								add_hunk();
-								add_file();
-							}
-						} catch (Error error) {
-							stderr.printf (@"Error: $(error.message)\n");
-						}
-						if (current_is_binary)
-							current_file.add_binary_renderer();
-					}
-					return 0;
-				},
+		if (workdir == null || path == null)
+		{
+			return null;
+		}
 
-				(delta, binary) => {
-					// FIXME: do we want to handle binary data?
-					if (cancellable != null && cancellable.is_cancelled())
-					{
-						return 1;
-					}
+		try
+		{
+			var info = workdir.get_child(path).query_info(FileAttribute.STANDARD_SIZE + "," +
+			                                              FileAttribute.TIME_MODIFIED + "," +
+			                                              FileAttribute.TIME_MODIFIED_USEC + "," +
+			                                              FileAttribute.UNIX_INODE,
+			                                              FileQueryInfoFlags.NOFOLLOW_SYMLINKS);
+
+			return key + " w %lld %llu.%u %llu".printf(info.get_size(),
+			                                          info.get_attribute_uint64(FileAttribute.TIME_MODIFIED),
+			                                          info.get_attribute_uint32(FileAttribute.TIME_MODIFIED_USEC),
+			                                          info.get_attribute_uint64(FileAttribute.UNIX_INODE));
+		}
+		catch
+		{
+			// Removed from the working directory
+			return key + " w -";
+		}
+	}
 
-					return 0;
-				},
+	private void destroy_reusable_files()
+	{
+		var files = d_reusable_files.values.to_array();
 
-				(delta, hunk) => {
-					if (cancellable != null && cancellable.is_cancelled())
-					{
-						return 1;
-					}
+		d_reusable_files.clear();
 
-					if (!current_is_binary)
-					{
-						maxlines = int.max(maxlines, hunk.get_old_start() + hunk.get_old_lines());
-						maxlines = int.max(maxlines, hunk.get_new_start() + hunk.get_new_lines());
+		foreach (var file in files)
+		{
+			file.destroy();
+		}
+	}
 
-						add_hunk();
+	private delegate void Anon();
 
-						current_hunk = hunk;
-						current_lines = new Gee.ArrayList<Ggit.DiffLine>();
-					}
+	private class DiffUpdate : Object
+	{
+		public Ggit.Diff diff;
+		public Cancellable? cancellable;
+		public Gee.HashSet<string> was_expanded;
+		public int num_deltas;
+		public int next_query;
+		public int maxlines;
+		public bool cleared;
+		public int added;
+		public Ggit.Diff? paired;
+
+		public bool summary;
+		public Gitg.DiffViewFile?[] files;
+		public uint[] stats;
+		public bool[] has_stats;
+		public bool[] requested;
+		public Gee.ArrayQueue<int> load_queue;
+		public int loads_running;
+
+		public void init_summary()
+		{
+			summary = true;
+			files = new Gitg.DiffViewFile?[num_deltas];
+			stats = new uint[num_deltas * 2];
+			has_stats = new bool[num_deltas];
+			requested = new bool[num_deltas];
+			load_queue = new Gee.ArrayQueue<int>();
+		}
+	}
 
-					return 0;
-				},
+	private bool is_summary(Ggit.Diff diff)
+	{
+		return summary_threshold > 0 && diff.get_num_deltas() > summary_threshold;
+	}
 
-				(delta, hunk, line) => {
-					if (cancellable != null && cancellable.is_cancelled())
-					{
-						return 1;
-					}
+	private DiffUpdate update_diff(Ggit.Diff diff, bool preserve_expanded, Cancellable? cancellable)
+	{
+		var update = new DiffUpdate();
 
-					if (!current_is_binary)
-					{
-						current_lines.add(line);
-					}
+		update.diff = diff;
+		update.cancellable = cancellable;
+		update.was_expanded = new Gee.HashSet<string>();
+		update.num_deltas = (int)diff.get_num_deltas();
 
-					return 0;
-				}
-			);
-		} catch {}
+		if (is_summary(diff))
+		{
+			update.init_summary();
+		}
 
-		add_hunk();
-		add_file();
+		// Only files shown one by one can be reused, summaries are loaded
+		// on demand
+		var reuse = d_commit == null && !update.summary;
 
-		var file_widgets = d_grid_files.get_children();
-		var was_expanded = new Gee.HashSet<string>();
+		if (!reuse)
+		{
+			destroy_reusable_files();
+		}
 
-		foreach (var file in file_widgets)
+		foreach (var file in d_grid_files.get_children())
 		{
 			unowned DiffViewFile f = (DiffViewFile) file;
 
@@ -1008,65 +961,783 @@ public class Gitg.DiffView : Gtk.Grid
 
 				if (path != null)
 				{
-					was_expanded.add(path);
+					update.was_expanded.add(path);
 				}
 			}
 
-			f.destroy();
+			if (reuse && f.content_key != null)
+			{
+				var prev = d_reusable_files[f.content_key];
+
+				if (prev != null && prev != f)
+				{
+					prev.destroy();
+				}
+
+				d_reusable_files[f.content_key] = f;
+			}
 		}
 
-		d_commit_details.expanded = (files.size <= 1 || !default_collapse_all);
-		d_commit_details.expander_visible = (files.size > 1);
+		auto_change_expanded(!update.summary && (update.num_deltas <= 1 || !default_collapse_all));
+		d_commit_details.expander_visible = (update.num_deltas > 1);
 
-		for (var i = 0; i < files.size; i++)
+		if (update.num_deltas == 0)
 		{
-			var file = files[i];
-			var path = primary_path(file.info.delta);
+			clear_files(update);
+			destroy_reusable_files();
 
-			file.expanded = d_commit_details.expanded || (path != null && was_expanded.contains(path));
-
-			if (i == files.size - 1)
-			{
-				file.vexpand = true;
-			}
+			return update;
+		}
 
-			d_grid_files.add(file);
+		if (update.summary)
+		{
+			add_summary_files(update);
+			return update;
+		}
 
-			file.notify["expanded"].connect(auto_update_expanded);
+		// Collect file info with a small number of concurrent queries, each
+		// file is shown as soon as its own info is available
+		for (var i = 0; i < int.min(MAX_FILE_QUERIES, update.num_deltas); i++)
+		{
+			query_files.begin(update, (obj, res) => {
+				query_files.end(res);
+			});
 		}
+
+		return update;
 	}
 
-	private void auto_update_expanded()
+	private async void query_files(DiffUpdate update)
 	{
-		foreach (var file in d_grid_files.get_children())
+		while (update.next_query < update.num_deltas)
 		{
-			if (!((Gitg.DiffViewFile) file).expanded)
+			if (update.cancellable != null && update.cancellable.is_cancelled())
+			{
+				return;
+			}
+
+			var index = update.next_query++;
+			var delta = update.diff.get_delta(index);
+			var key = content_key(delta);
+
+			if (key != null && d_reusable_files.has_key(key))
+			{
+				add_reused_file(update, index, key);
+				continue;
+			}
+
+			var info = new DiffViewFileInfo(repository, delta, new_is_workdir);
+
+			yield info.query(update.cancellable);
+
+			if (update.cancellable != null && update.cancellable.is_cancelled())
 			{
-				auto_change_expanded(false);
 				return;
 			}
+
+			add_file(update, index, info, key);
 		}
+	}
+
+	// Show a file of the previous diff again, without computing its patch
+	private void add_reused_file(DiffUpdate update, int index, string key)
+	{
+		clear_files(update);
+
+		Gitg.DiffViewFile file;
+		d_reusable_files.unset(key, out file);
 
-		auto_change_expanded(true);
+		file.vexpand = (index == update.num_deltas - 1);
+		d_grid_files.attach(file, 0, index, 1, 1);
+
+		file_added(update);
 	}
 
-	public PatchSet[] get_selection()
+	/*
+	 * Add collapsed headers for all files of a summary, in time slices so
+	 * that the first files are shown right away. Headers don't need the file
+	 * info to be queried, that only happens when a file is expanded.
+	 */
+	private void add_summary_files(DiffUpdate update)
 	{
-		var ret = new PatchSet[0];
+		var next = 0;
 
-		foreach (var file in d_grid_files.get_children())
-		{
-			ret += ((Gitg.DiffViewFile)file).get_selection();
-		}
+		Idle.add(() => {
+			if (update.cancellable != null && update.cancellable.is_cancelled())
+			{
+				return false;
+			}
 
-		return ret;
+			var start = get_monotonic_time();
+
+			while (next < update.num_deltas && get_monotonic_time() - start < SUMMARY_SLICE)
+			{
+				var info = new DiffViewFileInfo(repository, update.diff.get_delta(next), new_is_workdir);
+
+				add_file(update, next, info);
+				next++;
+			}
+
+			return next < update.num_deltas;
+		});
 	}
 
-	public void clear_selection()
+	private void query_stats(DiffUpdate update, Commit? commit, int parent)
 	{
-		foreach (var file in d_grid_files.get_children())
+		if (commit != null)
+		{
+			commit.get_diff_stats.begin(options, parent, update.cancellable, (index, added, removed) => {
+				set_file_stats(update, index, added, removed);
+			}, (obj, res) => {
+				commit.get_diff_stats.end(res);
+			});
+
+			return;
+		}
+
+		// Diffs that can't be recomputed on another thread (e.g. against the
+		// working directory) are done on the main loop instead
+		var next = 0;
+
+		Idle.add(() => {
+			if (update.cancellable != null && update.cancellable.is_cancelled())
+			{
+				return false;
+			}
+
+			var start = get_monotonic_time();
+
+			while (next < update.num_deltas && get_monotonic_time() - start < SUMMARY_SLICE)
+			{
+				compute_file_stats(update, next);
+				next++;
+			}
+
+			return next < update.num_deltas;
+		}, Priority.LOW);
+	}
+
+	private void compute_file_stats(DiffUpdate update, int index)
+	{
+		size_t added = 0;
+		size_t removed = 0;
+
+		try
+		{
+			var patch = new Ggit.Patch.from_diff(update.diff, index);
+			patch.get_line_stats(null, out added, out removed);
+		} catch {}
+
+		set_file_stats(update, index, (uint)added, (uint)removed);
+	}
+
+	private void set_file_stats(DiffUpdate update, int index, uint added, uint removed)
+	{
+		if (update.cancellable != null && update.cancellable.is_cancelled())
+		{
+			return;
+		}
+
+		update.stats[index * 2] = added;
+		update.stats[index * 2 + 1] = removed;
+		update.has_stats[index] = true;
+
+		var file = update.files[index];
+
+		// Loaded files keep their statistics up to date themselves
+		if (file != null && file.renderer_list.size == 0)
+		{
+			file.set_stats(added, removed);
+		}
+	}
+
+	private Gitg.DiffViewFile create_summary_file(DiffUpdate update, int index, DiffViewFileInfo info)
+	{
+		var file = new Gitg.DiffViewFile(info);
+
+		update.files[index] = file;
+
+		if (update.has_stats[index])
+		{
+			file.set_stats(update.stats[index * 2], update.stats[index * 2 + 1]);
+		}
+		else
+		{
+			file.set_stats(0, 0);
+		}
+
+		file.notify["expanded"].connect((obj, pspec) => {
+			if (((Gitg.DiffViewFile)obj).expanded)
+			{
+				queue_load(update, index);
+			}
+		});
+
+		// The handlers above reference the update, drop its reference to the
+		// file when it goes away so that neither is kept alive
+		file.destroy.connect(() => {
+			update.files[index] = null;
+		});
+
+		return file;
+	}
+
+	private void queue_load(DiffUpdate update, int index)
+	{
+		if (update.requested[index])
+		{
+			return;
+		}
+
+		update.requested[index] = true;
+		update.load_queue.offer(index);
+
+		if (update.loads_running < MAX_FILE_QUERIES)
+		{
+			update.loads_running++;
+
+			load_files.begin(update, (obj, res) => {
+				load_files.end(res);
+			});
+		}
+	}
+
+	private async void load_files(DiffUpdate update)
+	{
+		while (!update.load_queue.is_empty)
+		{
+			if (update.cancellable != null && update.cancellable.is_cancelled())
+			{
+				break;
+			}
+
+			var index = update.load_queue.poll();
+			var file = update.files[index];
+
+			if (file == null)
+			{
+				continue;
+			}
+
+			yield file.info.query(update.cancellable);
+
+			if (update.cancellable != null && update.cancellable.is_cancelled())
+			{
+				break;
+			}
+
+			populate_file(update, index, file);
+		}
+
+		update.loads_running--;
+	}
+
+	private void clear_files(DiffUpdate update)
+	{
+		if (update.cleared)
+		{
+			return;
+		}
+
+		// Keep showing the previous diff until the first file of the new
+		// one is ready
+		foreach (var child in d_grid_files.get_children())
+		{
+			var file = (Gitg.DiffViewFile)child;
+
+			if (file.content_key != null && d_reusable_files[file.content_key] == file)
+			{
+				// Kept aside until the new diff is complete
+				d_grid_files.remove(file);
+			}
+			else
+			{
+				file.destroy();
+			}
+		}
+
+		update.cleared = true;
+	}
+
+	private void add_file(DiffUpdate update, int index, DiffViewFileInfo info, string? key = null)
+	{
+		clear_files(update);
+
+		var file = update.summary ? create_summary_file(update, index, info) : create_file(update, index, info, key);
+		var path = primary_path(info.delta);
+
+		file.expanded = d_commit_details.expanded || (path != null && update.was_expanded.contains(path));
+
+		if (index == update.num_deltas - 1)
+		{
+			file.vexpand = true;
+		}
+
+		file.show();
+
+		d_grid_files.attach(file, 0, index, 1, 1);
+
+		track_file(file);
+		file_added(update);
+	}
+
+	private void file_added(DiffUpdate update)
+	{
+		update.added++;
+
+		if (update.added != update.num_deltas)
+		{
+			return;
+		}
+
+		// Files of the previous diff which are not part of this one
+		destroy_reusable_files();
+
+		if (update.paired != null)
+		{
+			merge_similar(update);
+		}
+	}
+
+	private async void find_similar(Commit commit, int parent, DiffUpdate update)
+	{
+		DiffSimilarity result;
+
+		var paired = yield commit.get_diff_similar(options,
+		                                           parent,
+		                                           similarity_timeout,
+		                                           similarity_pair_limit,
+		                                           update.cancellable,
+		                                           out result);
+
+		if (update.cancellable != null && update.cancellable.is_cancelled())
+		{
+			return;
+		}
+
+		similarity = result;
+
+		if (paired == null)
+		{
+			return;
+		}
+
+		update.paired = paired;
+
+		if (update.added == update.num_deltas)
+		{
+			merge_similar(update);
+		}
+	}
+
+	private void merge_similar(DiffUpdate update)
+	{
+		var paired = update.paired;
+		update.paired = null;
+
+		var added = new Gee.HashMap<string, Gitg.DiffViewFile>();
+		var deleted = new Gee.HashMap<string, Gitg.DiffViewFile>();
+
+		foreach (var child in d_grid_files.get_children())
+		{
+			var file = (Gitg.DiffViewFile)child;
+			var delta = file.info.delta;
+
+			switch (delta.get_status())
+			{
+			case Ggit.DeltaType.ADDED:
+				added[delta.get_new_file().get_path()] = file;
+				break;
+			case Ggit.DeltaType.DELETED:
+				deleted[delta.get_old_file().get_path()] = file;
+				break;
+			default:
+				break;
+			}
+		}
+
+		var merge = new DiffUpdate();
+
+		merge.diff = paired;
+		merge.cancellable = update.cancellable;
+		merge.was_expanded = update.was_expanded;
+		merge.num_deltas = (int)paired.get_num_deltas();
+		merge.maxlines = update.maxlines;
+		merge.cleared = true;
+
+		if (update.summary)
+		{
+			merge.init_summary();
+		}
+
+		// Replace the added file of each pair with the renamed or copied
+		// one and drop the deleted file of renames
+		for (var i = 0; i < merge.num_deltas; i++)
+		{
+			var delta = paired.get_delta(i);
+			var status = delta.get_status();
+
+			if (status != Ggit.DeltaType.RENAMED && status != Ggit.DeltaType.COPIED)
+			{
+				continue;
+			}
+
+			var target = added[delta.get_new_file().get_path()];
+
+			if (target == null)
+			{
+				continue;
+			}
+
+			if (status == Ggit.DeltaType.RENAMED)
+			{
+				var source = deleted[delta.get_old_file().get_path()];
+
+				if (source != null)
+				{
+					source.destroy();
+				}
+			}
+
+			merge_file.begin(merge, i, target, (obj, res) => {
+				merge_file.end(res);
+			});
+		}
+	}
+
+	private async void merge_file(DiffUpdate update, int index, Gitg.DiffViewFile target)
+	{
+		var info = new DiffViewFileInfo(repository, update.diff.get_delta(index), new_is_workdir);
+		Gitg.DiffViewFile file;
+
+		if (update.summary)
+		{
+			file = create_summary_file(update, index, info);
+			compute_file_stats(update, index);
+		}
+		else
+		{
+			yield info.query(update.cancellable);
+
+			if (update.cancellable != null && update.cancellable.is_cancelled())
+			{
+				return;
+			}
+
+			file = create_file(update, index, info);
+		}
+
+		var row = Value(typeof(int));
+
+		d_grid_files.child_get_property(target, "top-attach", ref row);
+
+		file.expanded = target.expanded;
+		file.vexpand = target.vexpand;
+
+		target.destroy();
+		file.show();
+
+		d_grid_files.attach(file, 0, row.get_int(), 1, 1);
+
+		track_file(file);
+	}
+
+	private void add_text_renderer(Gitg.DiffViewFile file, int maxlines)
+	{
+		file.add_text_renderer(handle_selection);
+
+		foreach (DiffViewFileRenderer renderer in file.renderer_list)
+		{
+			var renderer_text = renderer as DiffViewFileRendererTextable;
+
+			if (renderer_text != null)
+			{
+				bind_property("highlight", renderer_text, "highlight", BindingFlags.SYNC_CREATE);
+				bind_property("wrap-lines", renderer_text, "wrap-lines", BindingFlags.DEFAULT | BindingFlags.SYNC_CREATE);
+				bind_property("tab-width", renderer_text, "tab-width", BindingFlags.DEFAULT | BindingFlags.SYNC_CREATE);
+				renderer_text.maxlines = maxlines;
+			}
+		}
+	}
+
+	private async void update_textconv_hunks(Gitg.DiffViewFile file, Cancellable? cancellable)
+	{
+		var old_file = file.info.delta.get_old_file();
+		var new_file = file.info.delta.get_new_file();
+		var textconv = repository.textconv;
+
+		uint8[] o_textconv = {};
+		uint8[] n_textconv = {};
+
+		// Convert old and new side concurrently, the textconv worker pool
+		// bounds the number of converters running at the same time
+		SourceFunc callback = update_textconv_hunks.callback;
+		var pending = 2;
+
+		textconv.convert_file.begin(old_file, cancellable, (obj, res) => {
+			o_textconv = textconv.convert_file.end(res);
+
+			if (--pending == 0)
+			{
+				callback();
+			}
+		});
+
+		textconv.convert_file.begin(new_file, cancellable, (obj, res) => {
+			n_textconv = textconv.convert_file.end(res);
+
+			if (--pending == 0)
+			{
+				callback();
+			}
+		});
+
+		yield;
+
+		if (cancellable != null && cancellable.is_cancelled())
+		{
+			return;
+		}
+
+		var opts = new Ggit.DiffOptions();
+		opts.flags = Ggit.DiffOption.INCLUDE_UNTRACKED |
+		             Ggit.DiffOption.IGNORE_WHITESPACE |
+		             Ggit.DiffOption.DISABLE_PATHSPEC_MATCH |
+		             Ggit.DiffOption.RECURSE_UNTRACKED_DIRS;
+		opts.n_context_lines = 3;
+		opts.n_interhunk_lines = 3;
+
+		DiffViewHunk? current_hunk = null;
+		var maxlines = 0;
+
+		Anon add_hunk = () => {
+			if (current_hunk != null)
+			{
+				file.add_hunk(current_hunk);
+				current_hunk = null;
+			}
+		};
+
+		try
+		{
+			var bdiff = new Ggit.Diff.buffers(o_textconv, old_file.get_path(), n_textconv, new_file.get_path(), opts);
+
+			bdiff.foreach(
+				(delta, progress) => {
+					return 0;
+				},
+
+				(delta, binary) => {
+					return 0;
+				},
+
+				(delta, hunk) => {
+					if (cancellable != null && cancellable.is_cancelled())
+					{
+						return 1;
+					}
+
+					maxlines = int.max(maxlines, hunk.get_old_start() + hunk.get_old_lines());
+					maxlines = int.max(maxlines, hunk.get_new_start() + hunk.get_new_lines());
+
+					add_hunk();
+
+					current_hunk = new DiffViewHunk(hunk);
+
+					return 0;
+				},
+
+				(delta, hunk, line) => {
+					if (cancellable != null && cancellable.is_cancelled())
+					{
+						return 1;
+					}
+
+					current_hunk.add(line);
+					return 0;
+				}
+			);
+		} catch (Error error) {
+			stderr.printf (@"Error: $(error.message)\n");
+		}
+
+		if (cancellable != null && cancellable.is_cancelled())
+		{
+			return;
+		}
+
+		add_hunk();
+
+		foreach (var renderer in file.renderer_list)
+		{
+			var renderer_text = renderer as DiffViewFileRendererTextable;
+
+			if (renderer_text != null)
+			{
+				renderer_text.maxlines = int.max(renderer_text.maxlines, maxlines);
+			}
+		}
+	}
+
+	private Gitg.DiffViewFile create_file(DiffUpdate update, int index, DiffViewFileInfo info, string? key = null)
+	{
+		var file = new Gitg.DiffViewFile(info);
+		file.content_key = key;
+
+		populate_file(update, index, file);
+
+		return file;
+	}
+
+	private void populate_file(DiffUpdate update, int index, Gitg.DiffViewFile file)
+	{
+		var info = file.info;
+		var delta = info.delta;
+		var current_is_binary = ((delta.get_flags() & Ggit.DiffFlag.BINARY) != 0);
+
+		// List of known binary file types that may be wrongly classified by
+		// libgit2 because it does not contain any null bytes in the first N
+		// bytes. E.g. PDF
+		var known_binary_files_types = new string[] {"application/pdf"};
+
+		// Ignore binary based on content type
+		if (info.new_file_content_type in known_binary_files_types)
+		{
+			current_is_binary = true;
+		}
+
+		string? mime_type_for_image = null;
+
+		if (info.new_file_content_type == null)
+		{
+			// Guess mime type from old file name in the case of a deleted file
+			var oldpath = delta.get_old_file().get_path();
+
+			if (oldpath != null)
+			{
+				bool uncertain;
+				var ctype = ContentType.guess(Path.get_basename(oldpath), null, out uncertain);
+
+				if (ctype != null)
+				{
+					mime_type_for_image = ContentType.get_mime_type(ctype);
+				}
+			}
+		}
+		else
+		{
+			mime_type_for_image = ContentType.get_mime_type(info.new_file_content_type);
+		}
+
+		bool can_diff_as_image = mime_type_for_image != null && s_image_mime_types.contains(mime_type_for_image);
+		bool can_diff_as_text = ContentType.is_mime_type(mime_type_for_image, "text/plain");
+
+		Ggit.Patch? patch = null;
+
+		if (!current_is_binary)
+		{
+			try
+			{
+				patch = new Ggit.Patch.from_diff(update.diff, index);
+			}
+			catch (Error e)
+			{
+				stderr.printf(@"Failed to create patch: $(e.message)\n");
+			}
+		}
+
+		if (patch != null)
+		{
+			for (var i = 0; i < (int)patch.get_num_hunks(); i++)
+			{
+				try
+				{
+					var hunk = patch.get_hunk(i);
+
+					update.maxlines = int.max(update.maxlines, hunk.get_old_start() + hunk.get_old_lines());
+					update.maxlines = int.max(update.maxlines, hunk.get_new_start() + hunk.get_new_lines());
+				} catch {}
+			}
+		}
+
+		if (can_diff_as_image)
+		{
+			file.add_image_renderer();
+		}
+
+		if (!can_diff_as_image && !current_is_binary && !can_diff_as_text)
+		{
+			//force diff as text if no other diff is possible
+			can_diff_as_text = true;
+		}
+
+		if (can_diff_as_text)
+		{
+			add_text_renderer(file, update.maxlines);
+		}
+
+		if (current_is_binary)
+		{
+			var new_file = delta.get_new_file();
+			var old_file = delta.get_old_file();
+
+			if (repository != null &&
+			    (TextConv.has_textconv_command(repository, old_file) || TextConv.has_textconv_command(repository, new_file)))
+			{
+				// Converters run asynchronously, hunks are added when done.
+				// They are lost when the update is cancelled, so the file
+				// can't be reused
+				file.content_key = null;
+				add_text_renderer(file, update.maxlines);
+
+				update_textconv_hunks.begin(file, update.cancellable, (obj, res) => {
+					update_textconv_hunks.end(res);
+				});
+			}
+			else
+			{
+				file.add_binary_renderer();
+			}
+		}
+
+		if (patch != null)
+		{
+			for (var i = 0; i < (int)patch.get_num_hunks(); i++)
+			{
+				try
+				{
+					file.add_hunk(DiffViewHunk.from_patch(patch, i));
+				}
+				catch (Error e)
+				{
+					stderr.printf(@"Failed to read hunk: $(e.message)\n");
+				}
+			}
+		}
+	}
+
+	public PatchSet[] get_selection()
+	{
+		var ret = new PatchSet[0];
+
+		foreach (var file in d_selected_files)
+		{
+			// Skip files of a previous diff kept aside for reuse
+			if (file.get_parent() != null)
+			{
+				ret += file.get_selection();
+			}
+		}
+
+		return ret;
+	}
+
+	public void clear_selection()
+	{
+		// Clearing removes files from the set
+		foreach (var file in d_selected_files.to_array())
 		{
-			((Gitg.DiffViewFile)file).clear_selection();
+			file.clear_selection();
 		}
 	}
 
@@ -121,8 +121,17 @@ public class Remote : Ggit.Remote
 	private string[]? d_fetch_specs;
 	private string[]? d_push_specs;
 	private uint d_reset_transfer_progress_timeout;
+	private uint d_sample_transfer_progress_timeout;
 	private double d_transfer_progress;
 
+	// Frame rate at which the transfer progress is sampled
+	private const uint TRANSFER_PROGRESS_INTERVAL = 1000 / 30;
+
+	// Written on the network thread, sampled on the main loop
+	private int d_total_objects;
+	private int d_received_objects;
+	private int d_indexed_objects;
+
 	private Callbacks? d_callbacks;
 
 	public signal void tip_updated(string refname, Ggit.OId a, Ggit.OId b);
@@ -135,6 +144,12 @@ public class Remote : Ggit.Remote
 			d_reset_transfer_progress_timeout = 0;
 		}
 
+		if (d_sample_transfer_progress_timeout != 0)
+		{
+			Source.remove(d_sample_transfer_progress_timeout);
+			d_sample_transfer_progress_timeout = 0;
+		}
+
 		base.dispose();
 	}
 
@@ -172,6 +187,11 @@ public class Remote : Ggit.Remote
 
 		if (with_delay)
 		{
+			if (d_reset_transfer_progress_timeout != 0)
+			{
+				Source.remove(d_reset_transfer_progress_timeout);
+			}
+
 			d_reset_transfer_progress_timeout = Timeout.add(500, () => {
 				do_reset_transfer_progress();
 				return false;
@@ -183,19 +203,67 @@ public class Remote : Ggit.Remote
 		}
 	}
 
+	/*
+	 * Called by libgit2 for every packet on the network thread, only
+	 * records the counts. They are sampled on the main loop at a fixed
+	 * rate while transferring.
+	 */
 	private void update_transfer_progress(Ggit.TransferProgress stats)
 	{
-		var total = stats.get_total_objects();
-		var received = stats.get_received_objects();
-		var indexed = stats.get_indexed_objects();
+		AtomicInt.set(ref d_total_objects, (int)stats.get_total_objects());
+		AtomicInt.set(ref d_received_objects, (int)stats.get_received_objects());
+		AtomicInt.set(ref d_indexed_objects, (int)stats.get_indexed_objects());
+	}
 
-		d_transfer_progress = (double)(received + indexed) / (double)(total + total);
-		notify_property("transfer-progress");
+	private bool sample_transfer_progress()
+	{
+		var total = AtomicInt.get(ref d_total_objects);
 
-		if (received == total && indexed == total)
+		if (total == 0)
 		{
-			reset_transfer_progress(true);
+			return true;
+		}
+
+		var received = AtomicInt.get(ref d_received_objects);
+		var indexed = AtomicInt.get(ref d_indexed_objects);
+
+		var progress = double.min((double)(received + indexed) / (double)(total + total), 1.0);
+
+		if (progress != d_transfer_progress)
+		{
+			d_transfer_progress = progress;
+			notify_property("transfer-progress");
 		}
+
+		return true;
+	}
+
+	private void start_transfer_progress()
+	{
+		reset_transfer_progress(false);
+
+		AtomicInt.set(ref d_total_objects, 0);
+		AtomicInt.set(ref d_received_objects, 0);
+		AtomicInt.set(ref d_indexed_objects, 0);
+
+		if (d_sample_transfer_progress_timeout == 0)
+		{
+			d_sample_transfer_progress_timeout = Timeout.add(TRANSFER_PROGRESS_INTERVAL,
+			                                                 sample_transfer_progress);
+		}
+	}
+
+	private void stop_transfer_progress()
+	{
+		if (d_sample_transfer_progress_timeout != 0)
+		{
+			Source.remove(d_sample_transfer_progress_timeout);
+			d_sample_transfer_progress_timeout = 0;
+		}
+
+		// Show the final progress before it is reset
+		sample_transfer_progress();
+		reset_transfer_progress(true);
 	}
 
 	private void update_state(bool force_disconnect = false)
@@ -312,7 +380,7 @@ public class Remote : Ggit.Remote
 	private async void push_to(bool force, string local_ref, string remote_ref, Ggit.RemoteCallbacks? callbacks) throws Error
 	{
 		state = RemoteState.TRANSFERRING;
-		reset_transfer_progress(false);
+		start_transfer_progress();
 
 		try
 		{
@@ -333,11 +401,11 @@ public class Remote : Ggit.Remote
 		}
 		catch (Error e)
 		{
-			reset_transfer_progress(true);
+			stop_transfer_progress();
 			throw e;
 		}
 
-		reset_transfer_progress(true);
+		stop_transfer_progress();
 	}
 
 	private async void download_intern(string? message, Ggit.RemoteCallbacks? callbacks, Ggit.RemoteDownloadTagsType? download_tags) throws Error
@@ -351,7 +419,7 @@ public class Remote : Ggit.Remote
 		}
 
 		state = RemoteState.TRANSFERRING;
-		reset_transfer_progress(false);
+		start_transfer_progress();
 
 		try
 		{
@@ -372,12 +440,12 @@ public class Remote : Ggit.Remote
 		catch (Error e)
 		{
 			update_state(dis);
-			reset_transfer_progress(true);
+			stop_transfer_progress();
 			throw e;
 		}
 
 		update_state(dis);
-		reset_transfer_progress(true);
+		stop_transfer_progress();
 	}
 
 	public new async void download(Ggit.RemoteCallbacks? callbacks = null) throws Error
@@ -69,6 +69,7 @@ namespace Gitg
 			private SelectionMode d_mode;
 			private string? d_dirname;
 			private string? d_branch_name;
+			private uint d_metadata_generation;
 
 			public SelectionMode mode
 			{
@@ -172,77 +173,78 @@ namespace Gitg
 				}
 			}
 
+			/*
+			 * Show the cached metadata of the repository right away, and
+			 * read it again in the background.
+			 */
 			private void update_repository_data()
 			{
-				string head_name = "";
-				string head_description = "";
-				var doap = new Ide.Doap();
+				var generation = ++d_metadata_generation;
 
-				if (d_repository != null)
+				if (d_repository == null)
 				{
-					try
-					{
-						var head = d_repository.get_head();
-						head_name = head.parsed_name.shortname;
-
-						var commit = (Ggit.Commit)head.lookup();
-						var tree = commit.get_tree();
-
-						Ggit.OId? entry_id = null;
-
-						for (var i = 0; i < tree.size(); i++)
-						{
-							var entry = tree.get(i);
-							var name = entry.get_name();
-
-							if (name != null && name.has_suffix(".doap"))
-							{
-								entry_id = entry.get_id();
-								break;
-							}
-						}
-
-						if (entry_id != null)
-						{
-							var blob = d_repository.lookup<Ggit.Blob>(entry_id);
+					apply_metadata(null);
+					return;
+				}
 
-							unowned uint8[] content = blob.get_raw_content();
-							doap.load_from_data((string)content, -1);
+				var cache = RepositoryMetadataCache.get_default();
+				var location = d_repository.get_location();
 
-							head_description = doap.get_shortdesc();
+				apply_metadata(cache.lookup(location));
 
-							foreach (var lang in doap.get_languages())
-							{
-								var frame = new Gtk.Frame(null);
-								frame.shadow_type = Gtk.ShadowType.NONE;
-								frame.get_style_context().add_class("language-frame");
-								frame.show();
+				cache.update.begin(location, (obj, res) => {
+					var metadata = cache.update.end(res);
 
-								var label = new Gtk.Label(lang);
-								var attr_list = new Pango.AttrList();
-								attr_list.insert(Pango.attr_scale_new(Pango.Scale.SMALL));
-								label.set_attributes(attr_list);
-								label.show();
+					if (generation == d_metadata_generation)
+					{
+						apply_metadata(metadata);
+					}
+				});
+			}
 
-								frame.add(label);
-								d_languages_box.add(frame);
-							}
-						}
-					} catch {}
+			private void apply_metadata(RepositoryMetadata? metadata)
+			{
+				foreach (var child in d_languages_box.get_children())
+				{
+					child.destroy();
 				}
 
+				if (metadata != null)
+				{
+					foreach (var lang in metadata.languages)
+					{
+						var frame = new Gtk.Frame(null);
+						frame.shadow_type = Gtk.ShadowType.NONE;
+						frame.get_style_context().add_class("language-frame");
+						frame.show();
+
+						var label = new Gtk.Label(lang);
+						var attr_list = new Pango.AttrList();
+						attr_list.insert(Pango.attr_scale_new(Pango.Scale.SMALL));
+						label.set_attributes(attr_list);
+						label.show();
+
+						frame.add(label);
+						d_languages_box.add(frame);
+					}
+				}
 
-				if (doap.get_name() != null)
+				if (metadata != null && metadata.name != null)
 				{
-					repository_name = doap.get_name();
+					repository_name = metadata.name;
 				} else {
 					repository_name = d_repository != null ? d_repository.name : "";
 				}
 
-				d_description_label.label = head_description;
-				d_description_label.visible = head_description != "";
+				var description = metadata != null ? metadata.description : "";
 
-				branch_name = head_name;
+				d_description_label.label = description;
+				d_description_label.visible = description != "";
+
+				if (metadata != null)
+				{
+					branch_name = metadata.branch;
+				}
 			}
 
 			public bool loading
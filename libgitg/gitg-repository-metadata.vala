@@ -0,0 +1,297 @@
+/*
+ * This file is part of gitg
+ *
+ * Copyright (C) 2026 - Alberto Fanjul
+ *
+ * gitg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gitg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gitg. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+namespace Gitg
+{
+
+/*
+ * What the repository list shows about a repository: the current branch
+ * and, from the .doap file at the root of the HEAD tree, the name,
+ * description and languages of the project.
+ */
+internal class RepositoryMetadata : Object
+{
+	public string head_id = "";
+	public string branch = "";
+	public string? name;
+	public string description = "";
+	public string[] languages = new string[0];
+
+	public bool equal(RepositoryMetadata other)
+	{
+		return head_id == other.head_id &&
+		       branch == other.branch &&
+		       name == other.name &&
+		       description == other.description &&
+		       string.joinv("\n", languages) == string.joinv("\n", other.languages);
+	}
+}
+
+/*
+ * Caches the metadata of repositories on disk, so that the repository list
+ * can be shown right away. The metadata is read again on a bounded number
+ * of threads, and the .doap file is only parsed again when HEAD points to
+ * another commit.
+ */
+internal class RepositoryMetadataCache : Object
+{
+	private const int MAX_THREADS = 4;
+	private const uint SAVE_TIMEOUT = 1000;
+
+	private class Waiter
+	{
+		public SourceFunc callback;
+	}
+
+	private static RepositoryMetadataCache? s_instance;
+
+	private KeyFile d_keyfile;
+	private int d_running;
+	private Gee.ArrayQueue<Waiter> d_waiting;
+	private uint d_save_id;
+
+	public static RepositoryMetadataCache get_default()
+	{
+		if (s_instance == null)
+		{
+			s_instance = new RepositoryMetadataCache();
+		}
+
+		return s_instance;
+	}
+
+	private RepositoryMetadataCache()
+	{
+		d_keyfile = new KeyFile();
+		d_waiting = new Gee.ArrayQueue<Waiter>();
+
+		try
+		{
+			d_keyfile.load_from_file(cache_file().get_path(), KeyFileFlags.NONE);
+		} catch {}
+	}
+
+	private static File cache_file()
+	{
+		return File.new_for_path(Path.build_filename(Environment.get_user_cache_dir(),
+		                                             "gitg",
+		                                             "repository-metadata"));
+	}
+
+	public RepositoryMetadata? lookup(File location)
+	{
+		var group = location.get_uri();
+
+		if (!d_keyfile.has_group(group))
+		{
+			return null;
+		}
+
+		var ret = new RepositoryMetadata();
+
+		try
+		{
+			ret.head_id = d_keyfile.get_string(group, "head");
+			ret.branch = d_keyfile.get_string(group, "branch");
+			ret.description = d_keyfile.get_string(group, "description");
+			ret.languages = d_keyfile.get_string_list(group, "languages");
+
+			if (d_keyfile.has_key(group, "name"))
+			{
+				ret.name = d_keyfile.get_string(group, "name");
+			}
+		}
+		catch
+		{
+			return null;
+		}
+
+		return ret;
+	}
+
+	private void store(File location, RepositoryMetadata metadata)
+	{
+		var group = location.get_uri();
+
+		try
+		{
+			d_keyfile.remove_group(group);
+		} catch {}
+
+		d_keyfile.set_string(group, "head", metadata.head_id);
+		d_keyfile.set_string(group, "branch", metadata.branch);
+		d_keyfile.set_string(group, "description", metadata.description);
+		d_keyfile.set_string_list(group, "languages", metadata.languages);
+
+		if (metadata.name != null)
+		{
+			d_keyfile.set_string(group, "name", metadata.name);
+		}
+
+		if (d_save_id == 0)
+		{
+			d_save_id = Timeout.add(SAVE_TIMEOUT, () => {
+				d_save_id = 0;
+				save.begin((obj, res) => {
+					save.end(res);
+				});
+				return false;
+			});
+		}
+	}
+
+	private async void save()
+	{
+		var data = d_keyfile.to_data();
+
+		yield Async.thread_try(() => {
+			var file = cache_file();
+
+			try
+			{
+				DirUtils.create_with_parents(file.get_parent().get_path(), 0755);
+				FileUtils.set_contents(file.get_path(), data);
+			}
+			catch (Error e)
+			{
+				stderr.printf("Failed to save repository metadata: %s\n", e.message);
+			}
+		});
+	}
+
+	private async void acquire()
+	{
+		if (d_running < MAX_THREADS)
+		{
+			d_running++;
+			return;
+		}
+
+		var waiter = new Waiter();
+		waiter.callback = acquire.callback;
+
+		d_waiting.offer(waiter);
+		yield;
+	}
+
+	private void release()
+	{
+		var waiter = d_waiting.poll();
+
+		if (waiter != null)
+		{
+			// The slot is handed over
+			Idle.add((owned)waiter.callback);
+		}
+		else
+		{
+			d_running--;
+		}
+	}
+
+	private static RepositoryMetadata read_metadata(File location, RepositoryMetadata? cached) throws Error
+	{
+		var repository = Ggit.Repository.open(location);
+		var head = repository.get_head();
+		var ret = new RepositoryMetadata();
+
+		ret.head_id = head.get_target().to_string();
+		ret.branch = head.get_shorthand();
+
+		if (cached != null && cached.head_id == ret.head_id)
+		{
+			ret.name = cached.name;
+			ret.description = cached.description;
+			ret.languages = cached.languages;
+
+			return ret;
+		}
+
+		var commit = repository.lookup<Ggit.Commit>(head.get_target());
+		var tree = commit.get_tree();
+
+		Ggit.OId? entry_id = null;
+
+		for (var i = 0; i < tree.size(); i++)
+		{
+			var entry = tree.get(i);
+			var name = entry.get_name();
+
+			if (name != null && name.has_suffix(".doap"))
+			{
+				entry_id = entry.get_id();
+				break;
+			}
+		}
+
+		if (entry_id != null)
+		{
+			var doap = new Ide.Doap();
+			var blob = repository.lookup<Ggit.Blob>(entry_id);
+
+			unowned uint8[] content = blob.get_raw_content();
+			doap.load_from_data((string)content, -1);
+
+			ret.name = doap.get_name();
+			ret.description = doap.get_shortdesc() ?? "";
+
+			foreach (var lang in doap.get_languages())
+			{
+				ret.languages += lang;
+			}
+		}
+
+		return ret;
+	}
+
+	/*
+	 * Read the metadata of the repository at location on a thread and
+	 * update the cache. Returns the cached metadata when it can not be
+	 * read.
+	 */
+	public async RepositoryMetadata? update(File location)
+	{
+		yield acquire();
+
+		var cached = lookup(location);
+		RepositoryMetadata? ret = null;
+
+		yield Async.thread_try(() => {
+			ret = read_metadata(location, cached);
+		});
+
+		release();
+
+		if (ret == null)
+		{
+			return cached;
+		}
+
+		if (cached == null || !cached.equal(ret))
+		{
+			store(location, ret);
+		}
+
+		return ret;
+	}
+}
+
+}
+
+// ex: ts=4 noet
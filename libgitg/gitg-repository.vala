@@ -24,6 +24,7 @@ public class Repository : Ggit.Repository
 {
 	private HashTable<Ggit.OId, SList<Gitg.Ref>> d_refs;
 	private Stage ?d_stage;
+	private TextConv? d_textconv;
 
 	public string? name
 	{
@@ -191,6 +192,19 @@ public class Repository : Ggit.Repository
 		}
 	}
 
+	public TextConv textconv
+	{
+		owned get
+		{
+			if (d_textconv == null)
+			{
+				d_textconv = new TextConv(this);
+			}
+
+			return d_textconv;
+		}
+	}
+
 	public Ggit.Signature get_signature_with_environment(Gee.Map<string, string> env, string envname = "COMMITER") throws Error
 	{
 		string? user = null;
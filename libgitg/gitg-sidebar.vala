@@ -53,6 +53,7 @@ public class SidebarStore : Gtk.TreeStore
 	private uint d_sections;
 	private SList<Gtk.TreeIter?> d_parents;
 	private bool d_clearing;
+	private Gee.HashMap<SidebarItem, Gtk.TreeIter?> d_iters;
 
 	protected class SidebarText : Object, SidebarItem
 	{
@@ -91,6 +92,24 @@ public class SidebarStore : Gtk.TreeStore
 		}
 	}
 
+	construct
+	{
+		d_iters = new Gee.HashMap<SidebarItem, Gtk.TreeIter?>();
+	}
+
+	private void set_item(Gtk.TreeIter iter,
+	                      SidebarItem  item,
+	                      uint         hint,
+	                      uint         section)
+	{
+		@set(iter,
+		     SidebarColumn.ITEM, item,
+		     SidebarColumn.HINT, hint,
+		     SidebarColumn.SECTION, section);
+
+		d_iters[item] = iter;
+	}
+
 	private void append_real(SidebarItem      item,
 	                         uint             hint,
 	                         out Gtk.TreeIter iter)
@@ -104,10 +123,7 @@ public class SidebarStore : Gtk.TreeStore
 			base.append(out iter, null);
 		}
 
-		@set(iter,
-		     SidebarColumn.ITEM, item,
-		     SidebarColumn.HINT, hint,
-		     SidebarColumn.SECTION, d_sections);
+		set_item(iter, item, hint, d_sections);
 	}
 
 	public SidebarStore append_dummy(string text)
@@ -171,6 +187,137 @@ public class SidebarStore : Gtk.TreeStore
 		d_clearing = false;
 
 		d_sections = 0;
+		d_iters.clear();
+	}
+
+	public bool find_item(SidebarItem item, out Gtk.TreeIter iter)
+	{
+		var ret = d_iters[item];
+
+		if (ret == null)
+		{
+			iter = Gtk.TreeIter();
+			return false;
+		}
+
+		iter = ret;
+		return true;
+	}
+
+	private void forget_children(Gtk.TreeIter parent)
+	{
+		Gtk.TreeIter child;
+
+		if (!iter_children(out child, parent))
+		{
+			return;
+		}
+
+		do
+		{
+			forget_children(child);
+			d_iters.unset(item_for_iter(child));
+		} while (iter_next(ref child));
+	}
+
+	public void remove_item(SidebarItem item)
+	{
+		Gtk.TreeIter iter;
+
+		if (find_item(item, out iter))
+		{
+			forget_children(iter);
+			d_iters.unset(item);
+
+			base.remove(ref iter);
+		}
+	}
+
+	public void remove_children(SidebarItem item)
+	{
+		Gtk.TreeIter parent;
+		Gtk.TreeIter child;
+
+		if (!find_item(item, out parent))
+		{
+			return;
+		}
+
+		forget_children(parent);
+
+		while (iter_children(out child, parent))
+		{
+			base.remove(ref child);
+		}
+	}
+
+	private bool is_dummy(Gtk.TreeIter iter)
+	{
+		SidebarHint hint;
+
+		@get(iter, SidebarColumn.HINT, out hint);
+		return hint == SidebarHint.DUMMY;
+	}
+
+	public bool has_items(SidebarItem parent)
+	{
+		Gtk.TreeIter iter;
+		Gtk.TreeIter child;
+
+		return find_item(parent, out iter) &&
+		       iter_children(out child, iter) &&
+		       !is_dummy(child);
+	}
+
+	public void append_dummy_if_empty(SidebarItem parent, string text)
+	{
+		Gtk.TreeIter iter;
+
+		if (find_item(parent, out iter) && !iter_has_child(iter))
+		{
+			insert_item(new SidebarText(text), parent, null, SidebarHint.DUMMY);
+		}
+	}
+
+	/*
+	 * Insert an item below parent, before sibling or at the end when
+	 * sibling is null. A dummy child of parent is replaced by the item.
+	 */
+	public void insert_item(SidebarItem  item,
+	                        SidebarItem  parent,
+	                        SidebarItem? sibling,
+	                        SidebarHint  hint = SidebarHint.NONE)
+	{
+		Gtk.TreeIter piter;
+		Gtk.TreeIter iter;
+		Gtk.TreeIter child;
+
+		if (!find_item(parent, out piter))
+		{
+			return;
+		}
+
+		if (hint != SidebarHint.DUMMY && iter_children(out child, piter) && is_dummy(child))
+		{
+			d_iters.unset(item_for_iter(child));
+			base.remove(ref child);
+		}
+
+		uint section;
+		@get(piter, SidebarColumn.SECTION, out section);
+
+		Gtk.TreeIter siter;
+
+		if (sibling != null && find_item(sibling, out siter))
+		{
+			base.insert_before(out iter, piter, siter);
+		}
+		else
+		{
+			base.append(out iter, piter);
+		}
+
+		set_item(iter, item, hint, section);
 	}
 
 	public SidebarItem item_for_iter(Gtk.TreeIter iter)
@@ -378,32 +525,20 @@ public class Sidebar : Gtk.TreeView
 
 	public void select(SidebarItem item)
 	{
-		model.foreach((m, path, iter) => {
-			if (model.item_for_iter(iter) == item)
-			{
-				get_selection().select_iter(iter);
-				return true;
-			}
+		Gtk.TreeIter iter;
 
-			return false;
-		});
+		if (model.find_item(item, out iter))
+		{
+			get_selection().select_iter(iter);
+		}
 	}
 
 	public bool is_selected(SidebarItem item)
 	{
-		bool retval = false;
-
-		model.foreach((m, path, iter) => {
-			if (model.item_for_iter(iter) == item)
-			{
-				retval = get_selection().iter_is_selected(iter);
-				return true;
-			}
-
-			return false;
-		});
+		Gtk.TreeIter iter;
 
-		return retval;
+		return model.find_item(item, out iter) &&
+		       get_selection().iter_is_selected(iter);
 	}
 
 	protected override void row_activated(Gtk.TreePath path, Gtk.TreeViewColumn column)
@@ -153,10 +153,34 @@ public class StageStatusSubmodule : Object, StageStatusItem
 		try
 		{
 			d_flags = repository.get_submodule_status(submodule.get_name(),
-			                                          Ggit.SubmoduleIgnore.UNTRACKED);
+			                                          ignore_for(submodule));
 		} catch {}
 	}
 
+	/*
+	 * The changes to ignore when computing the status of submodule.
+	 * Untracked files in submodules are never shown, submodules configured
+	 * to ignore more than that keep their configuration.
+	 */
+	internal static Ggit.SubmoduleIgnore ignore_for(Ggit.Submodule submodule)
+	{
+		var ignore = submodule.get_ignore();
+
+		if (ignore == Ggit.SubmoduleIgnore.DIRTY || ignore == Ggit.SubmoduleIgnore.ALL)
+		{
+			return ignore;
+		}
+
+		return Ggit.SubmoduleIgnore.UNTRACKED;
+	}
+
+	internal StageStatusSubmodule.with_flags(Ggit.Submodule submodule, Ggit.SubmoduleStatus flags)
+	{
+		d_submodule = submodule;
+		d_path = submodule.get_path();
+		d_flags = flags;
+	}
+
 	public Ggit.Submodule submodule
 	{
 		get { return d_submodule; }
@@ -203,15 +227,23 @@ public class StageStatusSubmodule : Object, StageStatusItem
 
 public class StageStatusEnumerator : Object
 {
+	private const int MAX_SUBMODULE_THREADS = 8;
+
 	private Repository d_repository;
 	private Thread<void *> d_thread;
 	private StageStatusItem[] d_items;
 	private int d_offset;
 	private int d_callback_num;
+	private int64 d_batch_deadline;
 	private Cancellable d_cancellable;
 	private SourceFunc d_callback;
 	private Ggit.StatusOptions? d_options;
 	private Gee.HashSet<string> d_ignored_submodules;
+	private SubmoduleStatusCache? d_submodule_cache;
+	private string[] d_submodule_names;
+	private Ggit.SubmoduleStatus[] d_submodule_flags;
+	private bool[] d_submodule_done;
+	private int d_next_submodule;
 
 	private static Regex s_ignore_regex;
 
@@ -227,11 +259,13 @@ public class StageStatusEnumerator : Object
 		}
 	}
 
-	internal StageStatusEnumerator(Repository repository,
-	                               Ggit.StatusOptions? options = null)
+	internal StageStatusEnumerator(Repository             repository,
+	                               Ggit.StatusOptions?    options = null,
+	                               SubmoduleStatusCache?  submodule_cache = null)
 	{
 		d_repository = repository;
 		d_options = options;
+		d_submodule_cache = submodule_cache;
 
 		d_items = new StageStatusItem[100];
 		d_items.length = 0;
@@ -275,26 +309,126 @@ public class StageStatusEnumerator : Object
 		}
 	}
 
-	private delegate void AddItem(StageStatusItem item);
+	private void add_item(StageStatusItem item)
+	{
+		lock (d_items)
+		{
+			d_items += item;
 
-	private void *run_status()
+			if (d_callback != null && batch_ready())
+			{
+				var cb = (owned)d_callback;
+				d_callback = null;
+
+				Idle.add((owned)cb);
+			}
+		}
+	}
+
+	private Ggit.SubmoduleStatus submodule_status(Repository repository, string name) throws Error
 	{
-		AddItem add = (item) => {
-			lock (d_items)
+		var submodule = repository.lookup_submodule(name);
+
+		if (d_submodule_cache == null)
+		{
+			return repository.get_submodule_status(name, StageStatusSubmodule.ignore_for(submodule));
+		}
+
+		return d_submodule_cache.status(repository, submodule);
+	}
+
+	private void run_submodule_status(Repository repository)
+	{
+		while (!d_cancellable.is_cancelled())
+		{
+			var i = AtomicInt.add(ref d_next_submodule, 1);
+
+			if (i >= d_submodule_names.length)
 			{
-				d_items += item;
+				break;
+			}
 
-				if (d_callback != null && d_callback_num != -1 && d_items.length >= d_callback_num)
-				{
-					var cb = (owned)d_callback;
-					d_callback = null;
+			try
+			{
+				d_submodule_flags[i] = submodule_status(repository, d_submodule_names[i]);
+				d_submodule_done[i] = true;
+			} catch {}
+		}
+	}
 
-					Idle.add((owned)cb);
-				}
+	/*
+	 * Add the items of the submodules of which the status was computed.
+	 * The submodules are looked up again, the ones found by the threads
+	 * belong to repositories which are gone when the threads are done.
+	 */
+	private void add_submodule_items()
+	{
+		for (var i = 0; i < d_submodule_names.length; i++)
+		{
+			if (!d_submodule_done[i])
+			{
+				continue;
+			}
+
+			try
+			{
+				var submodule = d_repository.lookup_submodule(d_submodule_names[i]);
+				add_item(new StageStatusSubmodule.with_flags(submodule, d_submodule_flags[i]));
+			} catch {}
+		}
+	}
+
+	/*
+	 * Computing the status of a submodule requires checking its working
+	 * directory, which is done on a few threads, each with its own handle
+	 * on the repository, while the status of the files is collected. The
+	 * items of the submodules are added when the threads are done.
+	 */
+	private Thread<void *>[] start_submodule_status()
+	{
+		var threads = new Thread<void *>[0];
+		var n = (uint)d_submodule_names.length;
+
+		if (n == 0)
+		{
+			return threads;
+		}
+
+		var nthreads = uint.min(uint.min(uint.max(get_num_processors(), 1), n), MAX_SUBMODULE_THREADS);
+
+		var location = d_repository.get_location();
+		var workdir = d_repository.get_workdir();
+
+		for (uint t = 0; t < nthreads; t++)
+		{
+			try
+			{
+				threads += new Thread<void *>.try("gitg-submodule-status", () => {
+					try
+					{
+						run_submodule_status(new Repository(location, workdir));
+					}
+					catch (Error e)
+					{
+						stderr.printf("Failed to get submodule status: %s\n", e.message);
+					}
+
+					return null;
+				});
 			}
-		};
+			catch (Error e)
+			{
+				stderr.printf("Failed to get submodule status: %s\n", e.message);
+			}
+		}
 
+		return threads;
+	}
+
+	private void *run_status()
+	{
 		var submodule_paths = new Gee.HashSet<string>();
+		var submodule_names = new string[0];
 
 		// Due to a bug in libgit2, submodule iteration crashes when performed
 		// on a bare repository
@@ -307,10 +441,7 @@ public class StageStatusEnumerator : Object
 
 					if (!d_ignored_submodules.contains(name))
 					{
-						try
-						{
-							add(new StageStatusSubmodule(d_repository.lookup_submodule(name)));
-						} catch {}
+						submodule_names += name;
 					}
 
 					return d_cancellable.is_cancelled() ? 1 : 0;
@@ -318,23 +449,43 @@ public class StageStatusEnumerator : Object
 			} catch {}
 		}
 
+		d_submodule_names = submodule_names;
+		d_submodule_flags = new Ggit.SubmoduleStatus[submodule_names.length];
+		d_submodule_done = new bool[submodule_names.length];
+		d_next_submodule = 0;
+
+		var threads = start_submodule_status();
+
 		try
 		{
 			d_repository.file_status_foreach(d_options, (path, flags) => {
 				if (!submodule_paths.contains(path))
 				{
-					add(new StageStatusFile(path, flags));
+					add_item(new StageStatusFile(path, flags));
 				}
 
 				return d_cancellable.is_cancelled() ? 1 : 0;
 			});
 		} catch {}
 
+		if (threads.length == 0)
+		{
+			// No threads could be started, do the remaining submodules here
+			run_submodule_status(d_repository);
+		}
+
+		foreach (var thread in threads)
+		{
+			thread.join();
+		}
+
+		add_submodule_items();
+
 		lock (d_items)
 		{
 			d_cancellable = null;
 
-			if (d_callback != null && d_callback_num == -1)
+			if (d_callback != null)
 			{
 				var cb = (owned)d_callback;
 				d_callback = null;
@@ -346,6 +497,21 @@ public class StageStatusEnumerator : Object
 		return null;
 	}
 
+	// d_items is already locked here
+	private bool batch_ready()
+	{
+		var available = d_items.length - d_offset;
+
+		if (d_callback_num != -1 && available >= d_callback_num)
+		{
+			return true;
+		}
+
+		return d_batch_deadline != 0 &&
+		       available > 0 &&
+		       get_monotonic_time() >= d_batch_deadline;
+	}
+
 	private StageStatusItem[] fill_items(int num)
 	{
 		int n = 0;
@@ -408,6 +574,88 @@ public class StageStatusEnumerator : Object
 
 		return ret;
 	}
+
+	/**
+	 * Get the next batch of items.
+	 *
+	 * @param num the maximum number of items to return, or -1 for no limit.
+	 * @param interval the time in milliseconds to collect items for.
+	 *
+	 * Wait until num items are available, or until interval milliseconds
+	 * have passed and at least one item is available, without waiting for
+	 * the whole working directory to be scanned. An empty array is
+	 * returned when all items have been returned.
+	 */
+	public async StageStatusItem[] next_batch(int num = -1, uint interval = 100)
+	{
+		SourceFunc callback = next_batch.callback;
+		StageStatusItem[] ret = new StageStatusItem[0];
+		var ready = false;
+
+		lock (d_items)
+		{
+			if (d_cancellable == null || (num != -1 && d_items.length - d_offset >= num))
+			{
+				ret = fill_items(num);
+				ready = true;
+			}
+			else
+			{
+				d_callback = (owned)callback;
+				d_callback_num = num;
+				d_batch_deadline = get_monotonic_time() + interval * 1000;
+			}
+		}
+
+		if (ready)
+		{
+			if (ret.length == 0)
+			{
+				cancel();
+			}
+
+			return ret;
+		}
+
+		uint timeout_id = 0;
+
+		timeout_id = Timeout.add(interval, () => {
+			lock (d_items)
+			{
+				timeout_id = 0;
+
+				if (d_callback != null && d_items.length > d_offset)
+				{
+					var cb = (owned)d_callback;
+					d_callback = null;
+
+					Idle.add((owned)cb);
+				}
+			}
+
+			return false;
+		});
+
+		yield;
+
+		if (timeout_id != 0)
+		{
+			Source.remove(timeout_id);
+		}
+
+		lock (d_items)
+		{
+			d_batch_deadline = 0;
+			ret = fill_items(num);
+		}
+
+		if (ret.length == 0)
+		{
+			cancel();
+		}
+
+		return ret;
+	}
 }
 
 }
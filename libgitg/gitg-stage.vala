@@ -94,17 +94,22 @@ public class PatchSet
 	}
 }
 
+public delegate void StageProgressFunc(uint done, uint total);
+
 public class Stage : Object
 {
 	private const string CONFIG_USER_SIGNINGKEY = "user.signingkey";
+	private const uint PROGRESS_INTERVAL = 100;
 
 	private weak Repository d_repository;
 	private Mutex d_index_mutex;
 	private Ggit.Tree? d_head_tree;
+	private SubmoduleStatusCache d_submodule_status_cache;
 
 	internal Stage(Repository repository)
 	{
 		d_repository = repository;
+		d_submodule_status_cache = new SubmoduleStatusCache();
 	}
 
 	public async void refresh() throws Error
@@ -149,7 +154,38 @@ public class Stage : Object
 
 	public StageStatusEnumerator file_status(Ggit.StatusOptions? options = null)
 	{
-		return new StageStatusEnumerator(d_repository, options);
+		return new StageStatusEnumerator(d_repository, options, d_submodule_status_cache);
+	}
+
+	/*
+	 * Forget the status of the submodule at path, relative to the working
+	 * directory, so that the next file_status() checks it again.
+	 */
+	public void invalidate_submodule_status(string path)
+	{
+		d_submodule_status_cache.invalidate(path);
+	}
+
+	/*
+	 * Forget the status of all submodules, for when changes in their
+	 * working directories are not being watched.
+	 */
+	public void invalidate_all_submodule_status()
+	{
+		d_submodule_status_cache.invalidate_all();
+	}
+
+	/*
+	 * Compute the status of the submodule at path, relative to the working
+	 * directory, using the cached status when it is still valid. Blocks, so
+	 * call it from a thread.
+	 */
+	public StageStatusSubmodule submodule_status(string path) throws Error
+	{
+		var submodule = d_repository.lookup_submodule(path);
+		var flags = d_submodule_status_cache.status(d_repository, submodule);
+
+		return new StageStatusSubmodule.with_flags(submodule, flags);
 	}
 
 	private delegate void WithIndexFunc(Ggit.Index index) throws Error;
@@ -674,87 +710,81 @@ public class Stage : Object
 	 */
 	public async void revert_patch(PatchSet patch) throws Error
 	{
-		// new file is the current file in the working directory
-		var workdirf = d_repository.get_workdir().resolve_relative_path(patch.filename);
-		var workdirf_stream = yield workdirf.read_async();
+		yield revert_patches(new PatchSet[] { patch });
+	}
 
-		yield thread_index((index) => {
-			var entries = index.get_entries();
-			var entry = entries.get_by_path(workdirf, 0);
+	/**
+	 * Revert several patches in the working directory.
+	 *
+	 * @param patches the patches to revert.
+	 *
+	 * Same as revert_patch, but patches of the same file are reverted in a
+	 * single pass over the file.
+	 */
+	public async void revert_patches(PatchSet[] patches) throws Error
+	{
+		var merged = merge_patch_sets(patches);
+
+		if (merged.length == 0)
+		{
+			return;
+		}
 
-			if (entry == null)
+		yield thread_index((index) => {
+			foreach (var patch in merged)
 			{
-				throw new StageError.INDEX_ENTRY_NOT_FOUND(patch.filename);
+				revert_patch_set(index, patch);
 			}
+		});
+	}
 
-			var index_blob = d_repository.lookup<Ggit.Blob>(entry.get_id());
-			unowned uchar[] index_content = index_blob.get_raw_content();
-
-			var index_stream = new MemoryInputStream.from_bytes(new Bytes(index_content));
-			var reversed = patch.reversed();
+	private void revert_patch_set(Ggit.Index index, PatchSet patch) throws Error
+	{
+		// new file is the current file in the working directory
+		var workdirf = d_repository.get_workdir().resolve_relative_path(patch.filename);
 
-			FileIOStream? out_stream = null;
-			File ?outf = null;
+		var entries = index.get_entries();
+		var entry = entries.get_by_path(workdirf, 0);
 
-			try
-			{
-				outf = File.new_tmp(null, out out_stream);
+		if (entry == null)
+		{
+			throw new StageError.INDEX_ENTRY_NOT_FOUND(patch.filename);
+		}
 
-				apply_patch_stream(workdirf_stream,
-				                   index_stream,
-				                   out_stream.output_stream,
-				                   reversed);
-			}
-			catch (Error e)
-			{
-				workdirf_stream.close();
-				index_stream.close();
+		var index_blob = d_repository.lookup<Ggit.Blob>(entry.get_id());
+		var workdir_file = new MappedFile(workdirf.get_path(), false);
 
-				if (outf != null)
-				{
-					try
-					{
-						outf.delete();
-					} catch {}
-				}
+		FileIOStream out_stream;
+		var outf = File.new_tmp(null, out out_stream);
 
-				throw e;
-			}
+		try
+		{
+			apply_patch_content(mapped_content(workdir_file),
+			                    index_blob.get_raw_content(),
+			                    out_stream.output_stream,
+			                    patch.reversed());
 
-			workdirf_stream.close();
-			index_stream.close();
+			out_stream.close();
 
-			if (out_stream != null)
-			{
-				out_stream.close();
-			}
+			// Unmap before writing to the file, it might be truncated in place
+			workdir_file = null;
 
 			// Move outf to workdirf
-			try
-			{
-				var repl = workdirf.replace(null,
-				                            false,
-				                            FileCreateFlags.NONE);
-
-				repl.splice(outf.read(),
-				            OutputStreamSpliceFlags.CLOSE_SOURCE |
-				            OutputStreamSpliceFlags.CLOSE_TARGET);
-			}
-			catch (Error e)
-			{
-				try
-				{
-					outf.delete();
-				} catch {}
-
-				throw e;
-			}
+			var repl = workdirf.replace(null,
+			                            false,
+			                            FileCreateFlags.NONE);
 
+			repl.splice(outf.read(),
+			            OutputStreamSpliceFlags.CLOSE_SOURCE |
+			            OutputStreamSpliceFlags.CLOSE_TARGET);
+		}
+		finally
+		{
 			try
 			{
 				outf.delete();
 			} catch {}
-		});
+		}
 	}
 
 	/**
@@ -833,36 +863,255 @@ public class Stage : Object
 		});
 	}
 
-	private void copy_stream(OutputStream dest, InputStream src, ref size_t pos, size_t index, size_t length) throws Error
+	private delegate void BatchIndexFunc(Ggit.Index index, string path, bool removal) throws Error;
+
+	/*
+	 * Apply func to each path on the index in a worker thread and write the
+	 * index once at the end. On error or cancellation the in-memory index is
+	 * reloaded from disk, so that either all changes are written or none.
+	 */
+	private async void batch_index(string[]                 paths,
+	                               string[]                 removed_paths,
+	                               Cancellable?             cancellable,
+	                               owned StageProgressFunc? progress,
+	                               BatchIndexFunc           func) throws Error
 	{
-		if (length == 0)
+		var total = (uint)(paths.length + removed_paths.length);
+		int done = 0;
+		uint progress_id = 0;
+
+		if (progress != null)
 		{
-			return;
+			progress_id = Timeout.add(PROGRESS_INTERVAL, () => {
+				progress((uint)AtomicInt.get(ref done), total);
+				return true;
+			});
+		}
+
+		try
+		{
+			yield thread_index((index) => {
+				try
+				{
+					foreach (var path in paths)
+					{
+						cancellable.set_error_if_cancelled();
+
+						func(index, path, false);
+						AtomicInt.inc(ref done);
+					}
+
+					foreach (var path in removed_paths)
+					{
+						cancellable.set_error_if_cancelled();
+
+						func(index, path, true);
+						AtomicInt.inc(ref done);
+					}
+
+					cancellable.set_error_if_cancelled();
+				}
+				catch (Error e)
+				{
+					index.read(true);
+					throw e;
+				}
+
+				index.write();
+			});
+		}
+		finally
+		{
+			if (progress_id != 0)
+			{
+				Source.remove(progress_id);
+			}
+		}
+
+		if (progress != null)
+		{
+			progress(total, total);
+		}
+	}
+
+	/**
+	 * Stage several paths to the index at once.
+	 *
+	 * @param paths paths relative to the working directory to stage.
+	 * @param removed_paths paths relative to the working directory to delete
+	 *                      from the index.
+	 * @param cancellable a #GCancellable.
+	 * @param progress called on the main loop with the number of processed paths.
+	 *
+	 * Same as calling stage_path and delete_path for each of the paths, but
+	 * the index is only written once. When cancelled or when one of the
+	 * paths fails, the index is left untouched.
+	 */
+	public async void stage_paths(string[]                 paths,
+	                              string[]                 removed_paths,
+	                              Cancellable?             cancellable = null,
+	                              owned StageProgressFunc? progress = null) throws Error
+	{
+		var wd = d_repository.get_workdir();
+
+		yield batch_index(paths, removed_paths, cancellable, (owned)progress, (index, path, removal) => {
+			var file = wd.resolve_relative_path(path);
+
+			if (removal)
+			{
+				index.remove(file, 0);
+			}
+			else
+			{
+				index.add_file(file);
+			}
+		});
+	}
+
+	/**
+	 * Unstage several paths from the index at once.
+	 *
+	 * @param paths paths relative to the working directory to unstage.
+	 * @param removed_paths paths relative to the working directory which are
+	 *                      not in HEAD, to delete from the index.
+	 * @param cancellable a #GCancellable.
+	 * @param progress called on the main loop with the number of processed paths.
+	 *
+	 * Same as calling unstage_path and delete_path for each of the paths, but
+	 * the index is only written once. When cancelled or when one of the
+	 * paths fails, the index is left untouched.
+	 */
+	public async void unstage_paths(string[]                 paths,
+	                                string[]                 removed_paths,
+	                                Cancellable?             cancellable = null,
+	                                owned StageProgressFunc? progress = null) throws Error
+	{
+		var wd = d_repository.get_workdir();
+		var tree = paths.length != 0 ? yield get_head_tree() : null;
+
+		yield batch_index(paths, removed_paths, cancellable, (owned)progress, (index, path, removal) => {
+			if (removal)
+			{
+				index.remove(wd.resolve_relative_path(path), 0);
+				return;
+			}
+
+			var entry = tree.get_by_path(path);
+
+			var ientry = d_repository.create_index_entry_for_path(path, entry.get_id());
+			ientry.set_mode(entry.get_file_mode());
+
+			index.add(ientry);
+		});
+	}
+
+	private static unowned uint8[] mapped_content(MappedFile file)
+	{
+		unowned uint8[] ret = (uint8[])file.get_contents();
+		ret.length = (int)file.get_length();
+
+		return ret;
+	}
+
+	private static unowned uint8[] blob_content(Ggit.Blob? blob)
+	{
+		if (blob == null)
+		{
+			unowned uint8[] empty = null;
+			return empty;
 		}
 
-		var buf = new uint8[length];
+		return blob.get_raw_content();
+	}
 
-		if (pos != index)
+	private static void write_range(OutputStream stream,
+	                                uint8[]      content,
+	                                size_t       start,
+	                                size_t       end) throws Error
+	{
+		if (start > end || end > content.length)
 		{
-			((Seekable)src).seek(index, SeekType.SET);
-			pos = index;
+			throw new IOError.INVALID_DATA("Patch does not apply to the file content");
 		}
 
-		src.read_all(buf, null);
-		dest.write_all(buf, null);
+		if (start != end)
+		{
+			stream.write_all(content[(int)start:(int)end], null);
+		}
+	}
+
+	/*
+	 * Combine the patch sets of the same file into one, with the patches
+	 * sorted by their offset in the old content, so that each file is
+	 * patched in a single pass. Empty patch sets are dropped.
+	 */
+	private static PatchSet[] merge_patch_sets(PatchSet[] patches)
+	{
+		var files = new Gee.HashMap<string, Gee.ArrayList<PatchSet.Patch?>>();
+		var ret = new PatchSet[0];
+
+		foreach (var pset in patches)
+		{
+			if (pset.patches.length == 0)
+			{
+				continue;
+			}
+
+			var list = files[pset.filename];
+
+			if (list == null)
+			{
+				list = new Gee.ArrayList<PatchSet.Patch?>();
+				files[pset.filename] = list;
+
+				var merged = new PatchSet();
+				merged.filename = pset.filename;
+				merged.patches = pset.patches;
+
+				ret += merged;
+			}
 
-		pos += length;
+			foreach (var p in pset.patches)
+			{
+				list.add(p);
+			}
+		}
+
+		foreach (var merged in ret)
+		{
+			var list = files[merged.filename];
+
+			if (list.size == merged.patches.length)
+			{
+				// Only a single patch set for this file
+				continue;
+			}
+
+			// The sort is stable, patches at the same offset keep their order
+			list.sort((a, b) => {
+				return a.old_offset < b.old_offset ? -1 : (a.old_offset > b.old_offset ? 1 : 0);
+			});
+
+			merged.patches = new PatchSet.Patch[list.size];
+
+			for (var i = 0; i < list.size; i++)
+			{
+				merged.patches[i] = list[i];
+			}
+		}
+
+		return ret;
 	}
 
-	private void apply_patch(Ggit.Index  index,
-	                         uint filemode,
-	                         InputStream old_stream,
-	                         InputStream new_stream,
-	                         PatchSet    patch) throws Error
+	private void apply_patch(Ggit.Index index,
+	                         uint       filemode,
+	                         uint8[]    old_content,
+	                         uint8[]    new_content,
+	                         PatchSet   patch) throws Error
 	{
 		var patched_stream = d_repository.create_blob();
 
-		apply_patch_stream(old_stream, new_stream, patched_stream, patch);
+		apply_patch_content(old_content, new_content, patched_stream, patch);
 
 		patched_stream.close();
 		var new_id = patched_stream.get_id();
@@ -872,47 +1121,74 @@ public class Stage : Object
 		new_entry.set_mode(filemode);
 
 		index.add(new_entry);
-		index.write();
 	}
 
-	private void apply_patch_stream(InputStream  old_stream,
-	                                InputStream  new_stream,
-	                                OutputStream patched_stream,
-	                                PatchSet     patch) throws Error
+	/*
+	 * Write old_content to patched_stream while applying the patches as
+	 * specified in patch.patches from new_content. Both contents are
+	 * written to the stream directly, without copying them.
+	 */
+	private void apply_patch_content(uint8[]      old_content,
+	                                 uint8[]      new_content,
+	                                 OutputStream patched_stream,
+	                                 PatchSet     patch) throws Error
 	{
 		size_t old_ptr = 0;
-		size_t new_ptr = 0;
 
-		// Copy old_content to patched_stream while applying patches as
-		// specified in patch.patches from new_stream
 		foreach (var p in patch.patches)
 		{
 			// Copy from old_ptr until p.old_offset
-			copy_stream(patched_stream,
-			            old_stream,
-			            ref old_ptr,
-			            old_ptr,
-			            p.old_offset - old_ptr);
+			write_range(patched_stream, old_content, old_ptr, p.old_offset);
+			old_ptr = p.old_offset;
 
 			if (p.type == PatchSet.Type.REMOVE)
 			{
-				// Removing, just advance old stream
-				((Seekable)old_stream).seek(p.length, SeekType.CUR);
+				// Removing, just advance in old content
 				old_ptr += p.length;
 			}
 			else
 			{
-				// Inserting, copy from new_stream
-				copy_stream(patched_stream,
-				            new_stream,
-				            ref new_ptr,
-				            p.new_offset,
-				            p.length);
+				// Inserting, copy from new_content
+				write_range(patched_stream, new_content, p.new_offset, p.new_offset + p.length);
 			}
 		}
 
 		// Copy remaining part of old
-		patched_stream.splice(old_stream, OutputStreamSpliceFlags.NONE);
+		write_range(patched_stream, old_content, old_ptr, old_content.length);
+	}
+
+	private delegate void PatchIndexFunc(Ggit.Index index, PatchSet patch) throws Error;
+
+	/*
+	 * Run func on the index for each patch, and write the index once all
+	 * patches have been applied. When a patch fails, the index is left
+	 * untouched.
+	 */
+	private async void patch_index(PatchSet[] patches, PatchIndexFunc func) throws Error
+	{
+		var merged = merge_patch_sets(patches);
+
+		if (merged.length == 0)
+		{
+			return;
+		}
+
+		yield thread_index((index) => {
+			try
+			{
+				foreach (var patch in merged)
+				{
+					func(index, patch);
+				}
+			}
+			catch (Error e)
+			{
+				index.read(true);
+				throw e;
+			}
+
+			index.write();
+		});
 	}
 
 	/**
@@ -925,32 +1201,47 @@ public class Stage : Object
 	 * index (i.e. as obtained from diff_workdir)
 	 */
 	public async void stage_patch(PatchSet patch) throws Error
+	{
+		yield stage_patches(new PatchSet[] { patch });
+	}
+
+	/**
+	 * Stage several patches to the index.
+	 *
+	 * @param patches the patches to stage.
+	 *
+	 * Same as stage_patch, but patches of the same file are applied in a
+	 * single pass and the index is only written once.
+	 */
+	public async void stage_patches(PatchSet[] patches) throws Error
+	{
+		yield patch_index(patches, stage_patch_set);
+	}
+
+	private void stage_patch_set(Ggit.Index index, PatchSet patch) throws Error
 	{
 		// new file is the current file in the working directory
 		var newf = d_repository.get_workdir().resolve_relative_path(patch.filename);
-		var new_stream = yield newf.read_async();
+		var new_file = new MappedFile(newf.get_path(), false);
 
-		yield thread_index((index) => {
-			var entries = index.get_entries();
-			var entry = entries.get_by_path(newf, 0);
-			uchar[] old_content = new uchar[0];
-			if (entry == null)
-			{
-				print("\npath not in index %s\n", newf.get_path());
-				index.add_file(newf);
-				index.write();
-			} else {
-				var old_blob = d_repository.lookup<Ggit.Blob>(entry.get_id());
-				old_content = old_blob.get_raw_content();
-			}
+		var entries = index.get_entries();
+		var entry = entries.get_by_path(newf, 0);
+		Ggit.Blob? old_blob = null;
 
-			var old_stream = new MemoryInputStream.from_bytes(new Bytes(old_content));
+		if (entry == null)
+		{
+			// Not in the index yet, the patches apply to an empty file
+			index.add_file(newf);
 
-			apply_patch(index, entry.get_mode(), old_stream, new_stream, patch);
+			entries = index.get_entries();
+			entry = entries.get_by_path(newf, 0);
+		}
+		else
+		{
+			old_blob = d_repository.lookup<Ggit.Blob>(entry.get_id());
+		}
 
-			new_stream.close();
-			old_stream.close();
-		});
+		apply_patch(index, entry.get_mode(), blob_content(old_blob), mapped_content(new_file), patch);
 	}
 
 	/**
@@ -1009,56 +1300,63 @@ public class Stage : Object
 	 */
 	public async void unstage_patch(PatchSet patch) throws Error
 	{
-		var file = d_repository.get_workdir().resolve_relative_path(patch.filename);
+		yield unstage_patches(new PatchSet[] { patch });
+	}
+
+	/**
+	 * Unstage several patches from the index.
+	 *
+	 * @param patches the patches to unstage.
+	 *
+	 * Same as unstage_patch, but patches of the same file are applied in a
+	 * single pass and the index is only written once.
+	 */
+	public async void unstage_patches(PatchSet[] patches) throws Error
+	{
 		var tree = yield get_head_tree();
 
-		yield thread_index((index) => {
-			var entries = index.get_entries();
-			var entry = entries.get_by_path(file, 0);
+		yield patch_index(patches, (index, patch) => {
+			unstage_patch_set(index, tree, patch);
+		});
+	}
 
-			if (entry == null)
-			{
-				index.add_file(file);
-				index.write();
-				entries = index.get_entries();
-				entry = entries.get_by_path(file, 0);
-			}
+	private void unstage_patch_set(Ggit.Index index, Ggit.Tree tree, PatchSet patch) throws Error
+	{
+		var file = d_repository.get_workdir().resolve_relative_path(patch.filename);
 
-			uchar[] head_content = new uchar[0];
-			try {
-				var head_entry = tree.get_by_path(patch.filename);
-				var head_blob = d_repository.lookup<Ggit.Blob>(head_entry.get_id());
+		var entries = index.get_entries();
+		var entry = entries.get_by_path(file, 0);
 
-				head_content = head_blob.get_raw_content();
-			} catch (Error e) {}
+		if (entry == null)
+		{
+			index.add_file(file);
 
-			var index_blob = d_repository.lookup<Ggit.Blob>(entry.get_id());
-			unowned uchar[] index_content = index_blob.get_raw_content();
+			entries = index.get_entries();
+			entry = entries.get_by_path(file, 0);
+		}
 
-			var head_stream = new MemoryInputStream.from_bytes(new Bytes(head_content));
-			var index_stream = new MemoryInputStream.from_bytes(new Bytes(index_content));
+		Ggit.Blob? head_blob = null;
 
-			var reversed = patch.reversed();
+		try
+		{
+			var head_entry = tree.get_by_path(patch.filename);
+			head_blob = d_repository.lookup<Ggit.Blob>(head_entry.get_id());
+		} catch {}
 
-			try {
-				apply_patch(index, entry.get_mode(), index_stream, head_stream, reversed);
-			} catch(Error e) {
-				var stage = d_repository.stage;
-				stage.delete_path.begin(file.get_path(), (obj, res) => {
-					try
-					{
-						stage.delete_path.end(res);
-					}
-					catch (Error e)
-					{
-						warning("%s\n", e.message);
-					}
-				});
-			}
+		var index_blob = d_repository.lookup<Ggit.Blob>(entry.get_id());
 
-			head_stream.close();
-			index_stream.close();
-		});
+		try
+		{
+			apply_patch(index,
+			            entry.get_mode(),
+			            index_blob.get_raw_content(),
+			            blob_content(head_blob),
+			            patch.reversed());
+		}
+		catch
+		{
+			index.remove(file, 0);
+		}
 	}
 
 	public async Ggit.Diff? diff_index_all(StageStatusItem[]? files,
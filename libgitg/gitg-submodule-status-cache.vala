@@ -0,0 +1,228 @@
+/*
+ * This file is part of gitg
+ *
+ * Copyright (C) 2026 - Alberto Fanjul
+ *
+ * gitg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gitg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gitg. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+namespace Gitg
+{
+
+/*
+ * Remembers the status of submodules, so that it is only computed again
+ * when something it depends on changed. The part which depends on the
+ * HEAD, the index entry and the checked out commit of a submodule is
+ * keyed on those. The part which depends on the working directory of the
+ * submodule is keyed on its checked out commit and the modification time
+ * of its index. Edits of files in the submodule do not change either, so
+ * the submodule has to be invalidated when its files change, which is
+ * done from the working directory monitor of the commit view. Used from
+ * the status enumerator threads.
+ */
+internal class SubmoduleStatusCache : Object
+{
+	private class Entry
+	{
+		public string key;
+		public Ggit.SubmoduleStatus flags;
+		public string? workdir_key;
+		public Ggit.SubmoduleStatus workdir_flags;
+	}
+
+	// The flags which depend on the files in the working directory of the
+	// submodule, these are cached separately
+	public const Ggit.SubmoduleStatus WORKDIR_FLAGS = Ggit.SubmoduleStatus.WD_INDEX_MODIFIED |
+	                                                  Ggit.SubmoduleStatus.WD_WD_MODIFIED |
+	                                                  Ggit.SubmoduleStatus.WD_UNTRACKED;
+
+	private Gee.HashMap<string, Entry> d_entries;
+
+	public SubmoduleStatusCache()
+	{
+		d_entries = new Gee.HashMap<string, Entry>();
+	}
+
+	private static string id_string(Ggit.OId? id)
+	{
+		return id != null ? id.to_string() : "";
+	}
+
+	/*
+	 * Compute the key under which the status of submodule is stored, or
+	 * null if the status of the submodule should not be cached.
+	 */
+	private static string? key_for(Ggit.Repository repository, Ggit.Submodule submodule)
+	{
+		if (repository.get_workdir() == null)
+		{
+			return null;
+		}
+
+		var workdir_id = submodule.get_workdir_id();
+
+		if (workdir_id == null)
+		{
+			// Not checked out, there is no working directory to check
+			return null;
+		}
+
+		return string.join(" ",
+		                   id_string(submodule.get_head_id()),
+		                   id_string(submodule.get_index_id()),
+		                   id_string(workdir_id));
+	}
+
+	// The index of the submodule is written when files are staged in it
+	// and when git status refreshes it
+	private static string? workdir_key_for(Ggit.Repository sub)
+	{
+		try
+		{
+			var info = sub.get_location().get_child("index").query_info(FileAttribute.TIME_MODIFIED + "," +
+			                                                            FileAttribute.TIME_MODIFIED_USEC,
+			                                                            FileQueryInfoFlags.NONE);
+
+			return "%llu.%u".printf(info.get_attribute_uint64(FileAttribute.TIME_MODIFIED),
+			                        info.get_attribute_uint32(FileAttribute.TIME_MODIFIED_USEC));
+		}
+		catch
+		{
+			return null;
+		}
+	}
+
+	/*
+	 * Compute the flags of the submodule which depend on its working
+	 * directory: changes in its index and in its files. Untracked files in
+	 * submodules are not shown, like StageStatusSubmodule does.
+	 */
+	private static Ggit.SubmoduleStatus workdir_flags(Ggit.Repository sub)
+	{
+		Ggit.SubmoduleStatus ret = 0;
+
+		try
+		{
+			var options = new Ggit.StatusOptions(Ggit.StatusOption.EXCLUDE_SUBMODULES,
+			                                     Ggit.StatusShow.INDEX_AND_WORKDIR,
+			                                     null);
+
+			sub.file_status_foreach(options, (path, flags) => {
+				if ((flags & (Ggit.StatusFlags.INDEX_NEW |
+				              Ggit.StatusFlags.INDEX_MODIFIED |
+				              Ggit.StatusFlags.INDEX_DELETED |
+				              Ggit.StatusFlags.INDEX_RENAMED |
+				              Ggit.StatusFlags.INDEX_TYPECHANGE)) != 0)
+				{
+					ret |= Ggit.SubmoduleStatus.WD_INDEX_MODIFIED;
+				}
+
+				if ((flags & (Ggit.StatusFlags.WORKING_TREE_MODIFIED |
+				              Ggit.StatusFlags.WORKING_TREE_DELETED |
+				              Ggit.StatusFlags.WORKING_TREE_TYPECHANGE)) != 0)
+				{
+					ret |= Ggit.SubmoduleStatus.WD_WD_MODIFIED;
+				}
+
+				return 0;
+			});
+		} catch {}
+
+		return ret;
+	}
+
+	/*
+	 * Compute the status of submodule, reusing the cached parts which are
+	 * still valid.
+	 */
+	public Ggit.SubmoduleStatus status(Ggit.Repository repository, Ggit.Submodule submodule) throws Error
+	{
+		var name = submodule.get_name();
+		var ignore = StageStatusSubmodule.ignore_for(submodule);
+		var key = key_for(repository, submodule);
+
+		if (key == null)
+		{
+			return repository.get_submodule_status(name, ignore);
+		}
+
+		var path = submodule.get_path();
+		Entry? cached;
+
+		lock (d_entries)
+		{
+			cached = d_entries[path];
+		}
+
+		var entry = new Entry();
+		entry.key = key;
+
+		if (cached != null && cached.key == key)
+		{
+			entry.flags = cached.flags;
+		}
+		else
+		{
+			// Everything but the working directory of the submodule
+			var head_ignore = ignore == Ggit.SubmoduleIgnore.ALL ? ignore : Ggit.SubmoduleIgnore.DIRTY;
+
+			entry.flags = repository.get_submodule_status(name, head_ignore) & ~WORKDIR_FLAGS;
+			cached = null;
+		}
+
+		// Submodules configured to ignore their dirty working directory
+		// are not checked
+		if (ignore == Ggit.SubmoduleIgnore.UNTRACKED)
+		{
+			var sub = submodule.open();
+			entry.workdir_key = workdir_key_for(sub);
+
+			if (cached != null && cached.workdir_key != null && cached.workdir_key == entry.workdir_key)
+			{
+				entry.workdir_flags = cached.workdir_flags;
+			}
+			else
+			{
+				entry.workdir_flags = workdir_flags(sub);
+			}
+		}
+
+		lock (d_entries)
+		{
+			d_entries[path] = entry;
+		}
+
+		return entry.flags | entry.workdir_flags;
+	}
+
+	public void invalidate(string path)
+	{
+		lock (d_entries)
+		{
+			d_entries.unset(path);
+		}
+	}
+
+	public void invalidate_all()
+	{
+		lock (d_entries)
+		{
+			d_entries.clear();
+		}
+	}
+}
+
+}
+
+// ex: ts=4 noet
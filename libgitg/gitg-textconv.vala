@@ -21,73 +21,382 @@ using Ggit;
 namespace Gitg
 {
 
-public class TextConv
+public class TextConv : Object
 {
+	private class Waiter
+	{
+		public SourceFunc callback;
+	}
+
+	// Interval (in microseconds) in which the attribute and config files
+	// are checked for changes, invalidating the memoized commands
+	private const int64 STAMP_CHECK_INTERVAL = 1000000;
+
+	// Size of the converted blobs kept on disk. When it is exceeded, the
+	// oldest files are removed until a quarter of the space is free again
+	private const int64 CACHE_MAX_SIZE = 64 * 1024 * 1024;
+
+	// Number of files written to the cache between checking its size
+	private const int CACHE_PRUNE_INTERVAL = 32;
+
+	private weak Repository d_repository;
+
+	private Ggit.Config? d_config;
+	private Gee.HashMap<string, string> d_drivers;
+	private Gee.HashMap<string, string> d_commands;
+	private string? d_stamp;
+	private int64 d_stamp_checked;
+
+	private int d_running;
+	private Gee.ArrayQueue<Waiter> d_waiting;
+
+	private int d_cache_writes;
+	private bool d_pruning;
+
+	public int max_running { get; set; }
+
+	public TextConv(Repository repository)
+	{
+		Object();
+
+		d_repository = repository;
+	}
+
+	construct
+	{
+		d_drivers = new Gee.HashMap<string, string>();
+		d_commands = new Gee.HashMap<string, string>();
+		d_waiting = new Gee.ArrayQueue<Waiter>();
+
+		max_running = int.max(1, (int)get_num_processors());
+	}
+
 	public static bool has_textconv_command(Repository repository, DiffFile file)
 	{
-		return get_textconv_command(repository, file) != null;
+		return repository.textconv.get_command(file) != null;
 	}
 
-	private static string? get_textconv_command(Repository repository, DiffFile file)
+	private string stamp_for(File? file)
 	{
-		string? command = null;
-		var path = file.get_path();
-		string? diffattr = null;
+		if (file == null)
+		{
+			return "-";
+		}
+
 		try
 		{
-			diffattr = repository.get_attribute(path, "diff", Ggit.AttributeCheckFlags.FILE_THEN_INDEX);
-		} catch {}
-		if (diffattr != null)
+			var info = file.query_info(FileAttribute.TIME_MODIFIED, FileQueryInfoFlags.NONE);
+			return info.get_attribute_uint64(FileAttribute.TIME_MODIFIED).to_string();
+		}
+		catch
+		{
+			return "-";
+		}
+	}
+
+	private void check_stamp()
+	{
+		var now = get_monotonic_time();
+
+		if (d_stamp != null && now - d_stamp_checked < STAMP_CHECK_INTERVAL)
+		{
+			return;
+		}
+
+		d_stamp_checked = now;
+
+		var location = d_repository.get_location();
+		var workdir = d_repository.get_workdir();
+
+		var stamp = "%s:%s:%s".printf(stamp_for(location.get_child("config")),
+		                              stamp_for(location.get_child("info").get_child("attributes")),
+		                              stamp_for(workdir != null ? workdir.get_child(".gitattributes") : null));
+
+		if (stamp != d_stamp)
+		{
+			d_stamp = stamp;
+			d_config = null;
+
+			d_drivers.clear();
+			d_commands.clear();
+		}
+	}
+
+	/*
+	 * Get the textconv command for the given file. The diff driver is
+	 * memoized per path and the command per driver, until one of the
+	 * repository config or attribute files changes.
+	 */
+	public string? get_command(DiffFile file)
+	{
+		var path = file.get_path();
+
+		if (path == null)
+		{
+			return null;
+		}
+
+		check_stamp();
+
+		var driver = d_drivers[path];
+
+		if (driver == null)
 		{
-			var textconv_key = "diff.%s.textconv".printf(diffattr);
+			string? diffattr = null;
+
 			try
 			{
-				var config = repository.get_config().snapshot();
-				command = config.get_string(textconv_key);
+				diffattr = d_repository.get_attribute(path, "diff", Ggit.AttributeCheckFlags.FILE_THEN_INDEX);
+			} catch {}
+
+			driver = diffattr != null ? diffattr : "";
+			d_drivers[path] = driver;
+		}
+
+		if (driver == "")
+		{
+			return null;
+		}
+
+		var command = d_commands[driver];
+
+		if (command == null)
+		{
+			command = "";
+
+			try
+			{
+				if (d_config == null)
+				{
+					d_config = d_repository.get_config().snapshot();
+				}
+
+				var value = d_config.get_string("diff.%s.textconv".printf(driver));
+
+				if (value != null)
+				{
+					command = value;
+				}
 			}
 			catch (GLib.Error e)
 			{
 				warning("error getting textconv command: %s\n", e.message);
 			}
+
+			d_commands[driver] = command;
 		}
-		return command;
+
+		return command != "" ? command : null;
+	}
+
+	private static File cache_dir()
+	{
+		return File.new_for_path(Path.build_filename(Environment.get_user_cache_dir(),
+		                                             "gitg",
+		                                             "textconv"));
+	}
+
+	private File cache_file(OId id, string command)
+	{
+		var key = Checksum.compute_for_string(ChecksumType.SHA1, @"$(id.to_string()) $command");
+
+		return cache_dir().get_child(key);
+	}
+
+	private class CachedFile
+	{
+		public File file;
+		public int64 size;
+		public uint64 mtime;
 	}
 
-	public static uint8[] get_textconv_content(Repository repository, DiffFile file)
+	private static void prune_cache_dir(File dir) throws GLib.Error
 	{
-		uint8[] content = "".data;
-		if (file != null)
+		var files = new Gee.ArrayList<CachedFile>();
+		int64 total = 0;
+
+		var e = dir.enumerate_children(FileAttribute.STANDARD_NAME + "," +
+		                               FileAttribute.STANDARD_SIZE + "," +
+		                               FileAttribute.TIME_MODIFIED,
+		                               FileQueryInfoFlags.NOFOLLOW_SYMLINKS);
+
+		FileInfo? info;
+
+		while ((info = e.next_file()) != null)
 		{
-			var oid = file.get_oid();
-			if (!oid.is_zero()) {
-				try
-				{
-					var blob = repository.lookup<Ggit.Blob>(oid);
-					uint8[]? raw_content = blob.get_raw_content();
-					content = get_textconv_content_from_raw(repository, file, raw_content);
-				} catch {}
+			var f = new CachedFile();
+
+			f.file = dir.get_child(info.get_name());
+			f.size = info.get_size();
+			f.mtime = info.get_attribute_uint64(FileAttribute.TIME_MODIFIED);
+
+			files.add(f);
+			total += f.size;
+		}
+
+		if (total <= CACHE_MAX_SIZE)
+		{
+			return;
+		}
+
+		files.sort((a, b) => a.mtime < b.mtime ? -1 : (a.mtime > b.mtime ? 1 : 0));
+
+		foreach (var f in files)
+		{
+			if (total <= CACHE_MAX_SIZE / 4 * 3)
+			{
+				break;
 			}
+
+			try
+			{
+				f.file.delete();
+				total -= f.size;
+			} catch {}
 		}
-		return content;
 	}
 
-	public static uint8[] get_textconv_content_from_raw(Repository repository, DiffFile file, uint8[]? raw_content)
+	private async void prune_cache()
 	{
-		uint8[] content = "".data;
-		if (raw_content != null)
+		if (d_pruning || d_cache_writes++ % CACHE_PRUNE_INTERVAL != 0)
+		{
+			return;
+		}
+
+		d_pruning = true;
+
+		yield Async.thread_try(() => {
+			prune_cache_dir(cache_dir());
+		});
+
+		d_pruning = false;
+	}
+
+	/*
+	 * Convert the blob of the given file. Successful conversions are cached
+	 * on disk, keyed by blob id and textconv command.
+	 */
+	public async uint8[] convert_file(DiffFile file, Cancellable? cancellable = null)
+	{
+		var oid = file.get_oid();
+		var command = get_command(file);
+
+		if (command == null || oid.is_zero())
+		{
+			return "".data;
+		}
+
+		var cached = cache_file(oid, command);
+
+		try
+		{
+			uint8[] content;
+			yield cached.load_contents_async(cancellable, out content, null);
+
+			return content;
+		} catch {}
+
+		Ggit.Blob blob;
+
+		try
+		{
+			blob = d_repository.lookup<Ggit.Blob>(oid);
+		}
+		catch
+		{
+			return "".data;
+		}
+
+		var content = yield run(command, new Bytes(blob.get_raw_content()), cancellable);
+
+		if (content == null)
+		{
+			// Not cached, the converter may be fixed or installed later
+			return "".data;
+		}
+
+		if (cancellable != null && cancellable.is_cancelled())
 		{
-			var command = get_textconv_command(repository, file);
-			if (command != null)
+			return content;
+		}
+
+		try
+		{
+			var dir = cached.get_parent();
+
+			if (!dir.query_exists())
 			{
-				content = textconv(command, raw_content);
+				dir.make_directory_with_parents();
 			}
+
+			string etag;
+			yield cached.replace_contents_async(content, null, false, FileCreateFlags.PRIVATE, cancellable, out etag);
+
+			yield prune_cache();
+		}
+		catch (GLib.Error e)
+		{
+			debug("failed to cache textconv output: %s", e.message);
 		}
+
 		return content;
 	}
 
-	private static uint8[] textconv(string command, uint8[]? data)
+	public async uint8[] convert_raw(DiffFile file, uint8[]? raw_content, Cancellable? cancellable = null)
+	{
+		var command = get_command(file);
+
+		if (command == null || raw_content == null)
+		{
+			return "".data;
+		}
+
+		var content = yield run(command, new Bytes(raw_content), cancellable);
+		return content != null ? content : "".data;
+	}
+
+	private async void acquire()
 	{
-		string lines = "";
+		if (d_running < max_running)
+		{
+			d_running++;
+			return;
+		}
+
+		var waiter = new Waiter();
+		waiter.callback = acquire.callback;
+
+		d_waiting.offer(waiter);
+		yield;
+	}
+
+	private void release()
+	{
+		var waiter = d_waiting.poll();
+
+		if (waiter != null)
+		{
+			// Hand the slot over to the next waiting conversion
+			Idle.add((owned)waiter.callback);
+		}
+		else
+		{
+			d_running--;
+		}
+	}
+
+	/*
+	 * Run the textconv command on input. Returns null when the command
+	 * could not be run or did not exit successfully.
+	 */
+	private async uint8[]? run(string command, Bytes input, Cancellable? cancellable)
+	{
+		yield acquire();
+
+		uint8[]? content = null;
+		Subprocess? subproc = null;
+		var finished = false;
+
 		try
 		{
 			string[] command_array = command.split(" ");
@@ -96,34 +405,58 @@ public class TextConv
 			}
 			command_array += "/dev/stdin";
 
-			var subproc = new Subprocess.newv(command_array, STDIN_PIPE | STDOUT_PIPE | STDERR_PIPE);
+			subproc = new Subprocess.newv(command_array, STDIN_PIPE | STDOUT_PIPE | STDERR_PIPE);
 
-			var input = new MemoryInputStream.from_data(data, GLib.free);
-			subproc.get_stdin_pipe ().splice (input, CLOSE_TARGET);
+			Bytes? output;
+			Bytes? errors;
 
-			var end_pipe = subproc.get_stdout_pipe ();
-			var output = new DataInputStream (end_pipe);
-			string? line = null;
-			do {
-				line = output.read_line();
-				if (line != null) {
-					lines += line+"\n";
-				}
-			} while (line != null);
-
-			var err_pipe = subproc.get_stderr_pipe ();
-			var err = new DataInputStream (err_pipe);
-			string? lineerr = null;
-			do {
-				lineerr = err.read_line();
-				if (lineerr != null) {
+			yield subproc.communicate_async(input, cancellable, out output, out errors);
+			finished = true;
+
+			if (!subproc.get_successful())
+			{
+				stderr.printf("Failed to apply textconv: %s did not exit successfully\n", command_array[0]);
+			}
+			else if (output != null)
+			{
+				content = output.get_data();
+			}
+			else
+			{
+				content = "".data;
+			}
+
+			if (errors != null && errors.get_size() != 0)
+			{
+				var err = new StringBuilder();
+				err.append_len((string)errors.get_data(), (ssize_t)errors.get_size());
+
+				foreach (var lineerr in err.str.strip().split("\n"))
+				{
 					stderr.printf(": %s\n", lineerr);
 				}
-			} while (lineerr != null);
+			}
 		} catch (GLib.Error e) {
-			stderr.printf("Failed to apply texconv: %s\n", e.message);
+			if (cancellable == null || !cancellable.is_cancelled())
+			{
+				stderr.printf("Failed to apply texconv: %s\n", e.message);
+			}
 		}
-		return lines.data;
+
+		if (subproc != null && !finished)
+		{
+			// The command keeps running when communicating with it was
+			// cancelled or failed, stop it before giving up its slot
+			subproc.force_exit();
+
+			try
+			{
+				yield subproc.wait_async();
+			} catch {}
+		}
+
+		release();
+		return content;
 	}
 }
 
@@ -76,6 +76,21 @@ namespace GitgDiff
 			              "wrap-lines",
 			              SettingsBindFlags.GET | SettingsBindFlags.SET);
 
+			settings.bind("rename-detection-timeout",
+			              d_diff,
+			              "similarity-timeout",
+			              SettingsBindFlags.GET);
+
+			settings.bind("rename-detection-pair-limit",
+			              d_diff,
+			              "similarity-pair-limit",
+			              SettingsBindFlags.GET);
+
+			settings.bind("summary-threshold",
+			              d_diff,
+			              "summary-threshold",
+			              SettingsBindFlags.GET);
+
 			settings = new Settings(Gitg.Config.APPLICATION_ID + ".preferences.interface");
 
 			settings.bind("use-gravatar",
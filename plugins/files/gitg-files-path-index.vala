@@ -0,0 +1,393 @@
+/*
+ * This file is part of gitg
+ *
+ * Copyright (C) 2026 - Alberto Fanjul
+ *
+ * gitg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gitg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gitg. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+namespace GitgFiles
+{
+
+/*
+ * Index of the paths of all files in a tree, to find files by fuzzy
+ * matching. The entries of each tree object are read once and kept by id,
+ * so that indexing the tree of another commit only reads the subtrees that
+ * differ from the previously indexed tree. Entry names are interned, along
+ * with their case folded versions. Files are kept as the directory they
+ * are in and their position in the node of that directory, full paths are
+ * only built for the results of a search.
+ */
+class PathIndex : Object
+{
+	private class Node
+	{
+		public string id;
+		public (unowned string)[] names;
+		public (unowned string)[] folded;
+		public Node?[] children;
+	}
+
+	private class Files
+	{
+		// Paths of the directories, empty for the root or ending in a slash,
+		// and their nodes
+		private string[] d_dirs;
+		private string[] d_folded_dirs;
+		private Node[] d_dir_nodes;
+
+		// Directory and position in the node of the directory of each file
+		private int[] d_file_dirs;
+		private int[] d_file_entries;
+
+		public Files(Node root)
+		{
+			d_dirs = new string[0];
+			d_folded_dirs = new string[0];
+			d_dir_nodes = new Node[0];
+			d_file_dirs = new int[0];
+			d_file_entries = new int[0];
+
+			add(root, "", "");
+		}
+
+		private void add(Node node, string prefix, string folded_prefix)
+		{
+			var d = d_dirs.length;
+
+			d_dirs += prefix;
+			d_folded_dirs += folded_prefix;
+			d_dir_nodes += node;
+
+			for (int i = 0; i < node.names.length; i++)
+			{
+				if (node.children[i] != null)
+				{
+					add(node.children[i], prefix + node.names[i] + "/", folded_prefix + node.folded[i] + "/");
+				}
+				else
+				{
+					d_file_dirs += d;
+					d_file_entries += i;
+				}
+			}
+		}
+
+		public int length
+		{
+			get { return d_file_dirs.length; }
+		}
+
+		public string path(int file)
+		{
+			var d = d_file_dirs[file];
+			return d_dirs[d] + d_dir_nodes[d].names[d_file_entries[file]];
+		}
+
+		// The case folded path of file, built in buffer
+		public unowned string folded(int file, StringBuilder buffer)
+		{
+			var d = d_file_dirs[file];
+
+			buffer.truncate(0);
+			buffer.append(d_folded_dirs[d]);
+			buffer.append(d_dir_nodes[d].folded[d_file_entries[file]]);
+
+			return buffer.str;
+		}
+	}
+
+	private Gee.HashMap<string, Node> d_nodes;
+	private Ggit.OId? d_tree_id;
+	private Files? d_files;
+
+	// Matches of the last query, to narrow down when the query is extended
+	private string? d_last_query;
+	private Files? d_last_files;
+	private int[]? d_last_matches;
+
+	public PathIndex()
+	{
+		d_nodes = new Gee.HashMap<string, Node>();
+	}
+
+	public Ggit.OId? tree_id
+	{
+		get { return d_tree_id; }
+	}
+
+	private static void mark_used(Node node, Gee.HashMap<string, Node> used)
+	{
+		if (used.has_key(node.id))
+		{
+			return;
+		}
+
+		used[node.id] = node;
+
+		foreach (var child in node.children)
+		{
+			if (child != null)
+			{
+				mark_used(child, used);
+			}
+		}
+	}
+
+	private static Node read_node(Ggit.Repository repository,
+	                              Ggit.OId id,
+	                              Gee.HashMap<string, Node> nodes,
+	                              Gee.HashMap<string, Node> used) throws Error
+	{
+		var key = id.to_string();
+		var node = used[key] ?? nodes[key];
+
+		if (node != null)
+		{
+			mark_used(node, used);
+			return node;
+		}
+
+		var tree = repository.lookup<Ggit.Tree>(id);
+		var n = (int)tree.size();
+
+		node = new Node();
+		node.id = key;
+		node.names = new (unowned string)[n];
+		node.folded = new (unowned string)[n];
+		node.children = new Node?[n];
+
+		for (int i = 0; i < n; i++)
+		{
+			var entry = tree.get(i);
+			var name = entry.get_name();
+
+			node.names[i] = name.intern();
+			node.folded[i] = name.ascii_down().intern();
+
+			if (entry.get_file_mode() == Ggit.FileMode.TREE)
+			{
+				node.children[i] = read_node(repository, entry.get_id(), nodes, used);
+			}
+		}
+
+		used[key] = node;
+		return node;
+	}
+
+	/*
+	 * Index the files in tree. Only the trees which were not part of the
+	 * previously indexed tree are read, on a thread.
+	 */
+	public async void update(Ggit.Repository repository, Ggit.Tree tree) throws Error
+	{
+		var id = tree.get_id();
+
+		if (d_tree_id != null && d_tree_id.equal(id))
+		{
+			return;
+		}
+
+		var nodes = d_nodes;
+		var used = new Gee.HashMap<string, Node>();
+		Files? files = null;
+
+		yield Gitg.Async.thread(() => {
+			files = new Files(read_node(repository, id, nodes, used));
+		});
+
+		// Only keep the trees that are part of the indexed tree
+		d_nodes = used;
+		d_tree_id = id;
+		d_files = files;
+	}
+
+	private static bool is_boundary(char c)
+	{
+		return c == '/' || c == '_' || c == '-' || c == '.' || c == ' ';
+	}
+
+	/*
+	 * Score how well query matches path as a subsequence, starting at
+	 * start, or -1 if it does not match. Matches at the start of a word
+	 * and consecutive matches score higher.
+	 */
+	private static int match_from(string path, string query, int start)
+	{
+		int score = 0;
+		int qi = 0;
+		int last = -2;
+
+		for (int i = start; path[i] != '\0' && query[qi] != '\0'; i++)
+		{
+			if (path[i] != query[qi])
+			{
+				continue;
+			}
+
+			score += 1;
+
+			if (i == start || is_boundary(path[i - 1]))
+			{
+				score += 8;
+			}
+
+			if (last == i - 1)
+			{
+				score += 5;
+			}
+
+			last = i;
+			qi++;
+		}
+
+		return query[qi] == '\0' ? score : -1;
+	}
+
+	private static int score(string path, string query)
+	{
+		var slash = path.last_index_of_char('/');
+		var basename = slash + 1;
+
+		// Prefer matching only the file name
+		var ret = match_from(path, query, basename);
+
+		if (ret >= 0)
+		{
+			ret += 20;
+
+			if (basename > 0)
+			{
+				// Unless the directory is part of the query
+				var full = match_from(path, query, 0);
+
+				if (full > ret)
+				{
+					ret = full;
+				}
+			}
+		}
+		else
+		{
+			ret = match_from(path, query, 0);
+
+			if (ret < 0)
+			{
+				return -1;
+			}
+		}
+
+		// Shorter paths first
+		return ret * 256 - int.min(path.length, 255);
+	}
+
+	private static string[] search_files(Files files,
+	                                     string query,
+	                                     int[]? candidates,
+	                                     int max,
+	                                     out int[] matches)
+	{
+		var best = new int[0];
+		var best_scores = new int[0];
+		var found = new int[0];
+		var n = candidates != null ? candidates.length : files.length;
+		var buffer = new StringBuilder();
+
+		for (int c = 0; c < n; c++)
+		{
+			var i = candidates != null ? candidates[c] : c;
+			var s = score(files.folded(i, buffer), query);
+
+			if (s < 0)
+			{
+				continue;
+			}
+
+			found += i;
+
+			if (best.length == max && s <= best_scores[max - 1])
+			{
+				continue;
+			}
+
+			// Insert in the sorted list of best matches
+			var pos = best.length < max ? best.length : max - 1;
+
+			if (best.length < max)
+			{
+				best += i;
+				best_scores += s;
+			}
+
+			while (pos > 0 && best_scores[pos - 1] < s)
+			{
+				best[pos] = best[pos - 1];
+				best_scores[pos] = best_scores[pos - 1];
+				pos--;
+			}
+
+			best[pos] = i;
+			best_scores[pos] = s;
+		}
+
+		var ret = new string[best.length];
+
+		for (int i = 0; i < best.length; i++)
+		{
+			ret[i] = files.path(best[i]);
+		}
+
+		matches = (owned)found;
+		return ret;
+	}
+
+	/*
+	 * Find at most max files matching query, best matches first. Matching
+	 * is case insensitive and runs on a thread.
+	 */
+	public async string[] search(string query, int max)
+	{
+		var files = d_files;
+		var folded = query.ascii_down();
+
+		if (files == null || folded == "")
+		{
+			return new string[0];
+		}
+
+		int[]? candidates = null;
+
+		if (d_last_files == files && d_last_query != null && folded.has_prefix(d_last_query))
+		{
+			candidates = d_last_matches;
+		}
+
+		string[] ret = {};
+		int[] matches = {};
+
+		yield Gitg.Async.thread_try(() => {
+			ret = search_files(files, folded, candidates, max, out matches);
+		});
+
+		d_last_query = folded;
+		d_last_files = files;
+		d_last_matches = (owned)matches;
+
+		return ret;
+	}
+}
+
+}
+
+// ex: ts=4 noet
@@ -22,42 +22,125 @@ namespace GitgFiles
 
 public class TreeStore : Gtk.TreeStore
 {
-	struct Item
+	/*
+	 * Only the entries of the root tree are loaded when the tree is set.
+	 * Directories get a placeholder child (a row without a name) until
+	 * they are expanded, after which their entries are read on a thread
+	 * and replace the placeholder.
+	 *
+	 * When another tree of the same repository is set, only the rows of
+	 * loaded directories which differ between the shown tree and the new
+	 * tree are inserted, removed or changed. Subtrees with the same id are
+	 * not looked at.
+	 *
+	 * Rows are sorted on a collation key which is computed along with the
+	 * entry, on the thread, and stored in the row. Entries of a directory
+	 * are sorted on the thread as well, so that inserting them in order
+	 * finds each row in its place without moving it.
+	 */
+	class Entry
 	{
-		string root;
-		Ggit.TreeEntry entry;
+		public Icon icon;
+		public string name;
+		public bool isdir;
+		public Ggit.OId id;
+		public string key;
+
+		public Entry(Ggit.TreeEntry entry)
+		{
+			icon = TreeStore.get_entry_icon(entry);
+			name = entry.get_name();
+			isdir = entry.get_file_mode() == Ggit.FileMode.TREE;
+			id = entry.get_id();
+			key = name.collate_key_for_filename();
+		}
+	}
+
+	enum ChangeType
+	{
+		ADDED,
+		REMOVED,
+		MODIFIED
+	}
+
+	class Change
+	{
+		public ChangeType kind;
+		public string parent;
+		public Entry entry;
+
+		public Change(ChangeType kind, string parent, Ggit.TreeEntry entry)
+		{
+			this.kind = kind;
+			this.parent = parent;
+			this.entry = new Entry(entry);
+		}
 	}
 
-	private uint d_update_id;
 	private Ggit.Tree d_tree;
+	private Ggit.Tree? d_shown;
+	private Ggit.Repository? d_shown_repository;
+	private uint d_generation;
+	private bool d_updating;
+
+	// Full paths of directories being loaded, and of loaded directories
+	private Gee.HashSet<string> d_loading;
+	private Gee.TreeSet<string> d_loaded;
+
+	public Ggit.Repository? repository { get; set; }
+
+	public signal void loaded(Gtk.TreePath? path);
 
 	public Ggit.Tree? tree
 	{
 		get { return d_tree; }
 		set
 		{
+			if (d_tree != null && value != null && d_tree.get_id().equal(value.get_id()))
+			{
+				return;
+			}
+
 			d_tree = value;
-			update();
+
+			if (d_shown != null && d_tree != null &&
+			    d_shown_repository == repository && d_loaded.contains(""))
+			{
+				update_delta.begin((obj, res) => {
+					update_delta.end(res);
+				});
+			}
+			else
+			{
+				update();
+			}
 		}
 	}
 
 	construct
 	{
-		set_column_types(new Type[] {typeof(Icon), typeof(string), typeof(bool), typeof(Ggit.OId)});
+		d_loading = new Gee.HashSet<string>();
+		d_loaded = new Gee.TreeSet<string>();
+
+		set_column_types(new Type[] {typeof(Icon), typeof(string), typeof(bool), typeof(Ggit.OId), typeof(string)});
 
 		set_sort_func(0, (model, a, b) => {
-			string aname;
-			string bname;
+			string? akey;
+			string? bkey;
 			bool aisdir;
 			bool bisdir;
 
-			model.get(a, 1, out aname, 2, out aisdir);
-			model.get(b, 1, out bname, 2, out bisdir);
+			model.get(a, 4, out akey, 2, out aisdir);
+			model.get(b, 4, out bkey, 2, out bisdir);
 
-			if (aisdir == bisdir)
+			if (akey == null || bkey == null)
 			{
-				return strcmp(aname.collate_key_for_filename(),
-				              bname.collate_key_for_filename());
+				// Placeholders go first, they are about to be removed
+				return akey == null ? (bkey == null ? 0 : -1) : 1;
+			}
+			else if (aisdir == bisdir)
+			{
+				return strcmp(akey, bkey);
 			}
 			else if (aisdir)
 			{
@@ -74,11 +157,8 @@ public class TreeStore : Gtk.TreeStore
 
 	protected override void dispose()
 	{
-		if (d_update_id != 0)
-		{
-			Source.remove(d_update_id);
-			d_update_id = 0;
-		}
+		// Drop the results of loads that are still running
+		d_generation++;
 
 		base.dispose();
 	}
@@ -124,7 +204,16 @@ public class TreeStore : Gtk.TreeStore
 		return ret;
 	}
 
-	private Icon get_entry_icon(Ggit.TreeEntry entry)
+	public bool is_placeholder(Gtk.TreeIter iter)
+	{
+		string? name;
+
+		get(iter, 1, out name);
+
+		return name == null;
+	}
+
+	private static Icon get_entry_icon(Ggit.TreeEntry entry)
 	{
 		Icon icon;
 		var isdir = entry.get_file_mode() == Ggit.FileMode.TREE;
@@ -152,80 +241,491 @@ public class TreeStore : Gtk.TreeStore
 
 	private void update()
 	{
-		if (d_update_id != 0)
-		{
-			Source.remove(d_update_id);
-			d_update_id = 0;
-		}
+		d_generation++;
+		d_updating = false;
+
+		d_loading.clear();
+		d_loaded.clear();
 
 		clear();
 
+		d_shown = d_tree;
+		d_shown_repository = repository;
+
 		if (d_tree == null)
 		{
 			return;
 		}
 
-		List<Item?>? items = null;
+		load_entries.begin(d_tree, null, (obj, res) => {
+			load_entries.end(res);
+		});
+	}
 
-		try
+	/*
+	 * Load the entries of the directory at iter, if that did not happen
+	 * yet. Call this before the directory is expanded.
+	 */
+	public void load(Gtk.TreeIter iter)
+	{
+		Gtk.TreeIter child;
+
+		if (!get_isdir(iter) || !iter_children(out child, iter) || !is_placeholder(child))
 		{
-			d_tree.walk(Ggit.TreeWalkMode.PRE, (root, entry) => {
-				var item = Item();
-				item.root = root;
-				item.entry = entry;
-				items.prepend(item);
-				return 0;
-			});
-		} catch (Error e) { }
+			return;
+		}
 
-		if (items == null)
+		if (!d_loading.add(get_full_path(iter)) || d_updating)
 		{
+			// Started again when the update is done
 			return;
 		}
 
-		items.reverse();
+		load_entries.begin(null, new Gtk.TreeRowReference(this, get_path(iter)), (obj, res) => {
+			load_entries.end(res);
+		});
+	}
+
+	private async bool ensure_loaded(Gtk.TreeIter iter)
+	{
+		var reference = new Gtk.TreeRowReference(this, get_path(iter));
+
+		while (true)
+		{
+			Gtk.TreeIter row;
+			Gtk.TreeIter child;
 
-		var paths = new HashTable<string, Gtk.TreePath>(str_hash, str_equal);
-		d_update_id = Idle.add(() => {
-			if (items == null)
+			if (!reference.valid())
 			{
-				d_update_id = 0;
 				return false;
 			}
 
-			Item item = items.data;
-			items.remove_link(items);
+			get_iter(out row, reference.get_path());
+
+			if (!iter_children(out child, row) || !is_placeholder(child))
+			{
+				return true;
+			}
+
+			// Woken up by any load, check again
+			var id = loaded.connect((path) => {
+				ensure_loaded.callback();
+			});
+
+			load(row);
+			yield;
 
-			var root = item.root;
-			var entry = item.entry;
-			var isdir = entry.get_file_mode() == Ggit.FileMode.TREE;
+			disconnect(id);
+		}
+	}
+
+	/*
+	 * Load the directories leading to the file at path, a path in the
+	 * tree separated by slashes, and return the path of its row.
+	 */
+	public async Gtk.TreePath? reveal(string path)
+	{
+		Gtk.TreeIter? parent = null;
 
-			Gtk.TreeIter? parent = null;
+		foreach (var name in path.split("/"))
+		{
+			Gtk.TreeIter iter;
+			bool found = false;
 
-			if (root != "")
+			if (parent != null && !(yield ensure_loaded(parent)))
 			{
-				get_iter(out parent, paths.lookup(root));
+				return null;
 			}
 
-			Icon icon = get_entry_icon(entry);
+			if (iter_children(out iter, parent))
+			{
+				do
+				{
+					if (!is_placeholder(iter) && get_name(iter) == name)
+					{
+						found = true;
+						break;
+					}
+				} while (iter_next(ref iter));
+			}
+
+			if (!found)
+			{
+				return null;
+			}
+
+			parent = iter;
+		}
+
+		return parent != null ? get_path(parent) : null;
+	}
 
+	private async void load_entries(Ggit.Tree? tree, Gtk.TreeRowReference? parent)
+	{
+		var generation = d_generation;
+		var repository = this.repository;
+		var full_path = "";
+		Ggit.OId? id = null;
+
+		if (parent != null)
+		{
 			Gtk.TreeIter iter;
-			append(out iter, parent);
-			set(iter,
-			    0, icon,
-			    1, entry.get_name(),
-			    2, isdir,
-			    3, entry.get_id());
 
-			if (isdir)
+			get_iter(out iter, parent.get_path());
+			id = get_id(iter);
+			full_path = get_full_path(iter);
+		}
+
+		var entries = new Gee.ArrayList<Entry>();
+
+		yield Gitg.Async.thread_try(() => {
+			var t = tree ?? repository.lookup<Ggit.Tree>(id);
+			var n = t.size();
+
+			for (uint i = 0; i < n; i++)
+			{
+				entries.add(new Entry(t.get(i)));
+			}
+
+			entries.sort(compare_entries);
+		});
+
+		if (generation != d_generation || (parent != null && !parent.valid()))
+		{
+			return;
+		}
+
+		Gtk.TreeIter? piter = null;
+		Gtk.TreeIter placeholder = Gtk.TreeIter();
+		Gtk.TreePath? path = null;
+
+		if (parent != null)
+		{
+			path = parent.get_path();
+
+			get_iter(out piter, path);
+			iter_children(out placeholder, piter);
+		}
+
+		d_loading.remove(full_path);
+		d_loaded.add(full_path);
+
+		foreach (var e in entries)
+		{
+			insert_entry(piter, e);
+		}
+
+		// Removed last, so that an expanded parent never loses all its
+		// children and collapses
+		if (piter != null)
+		{
+			remove(ref placeholder);
+		}
+
+		loaded(path);
+	}
+
+	// The order of the rows, directories first
+	private static int compare_entries(Entry a, Entry b)
+	{
+		if (a.isdir != b.isdir)
+		{
+			return a.isdir ? -1 : 1;
+		}
+
+		return strcmp(a.key, b.key);
+	}
+
+	private Gtk.TreeIter insert_entry(Gtk.TreeIter? parent, Entry e)
+	{
+		Gtk.TreeIter iter;
+
+		insert_with_values(out iter, parent, -1,
+		                   0, e.icon,
+		                   1, e.name,
+		                   2, e.isdir,
+		                   3, e.id,
+		                   4, e.key);
+
+		if (e.isdir)
+		{
+			Gtk.TreeIter child;
+			insert_with_values(out child, iter, -1, 2, true);
+		}
+
+		return iter;
+	}
+
+	/*
+	 * Collect the changes between old and tree, descending only into
+	 * directories that are loaded and whose ids differ.
+	 */
+	private static void diff_trees(Ggit.Repository repository,
+	                               Ggit.Tree old,
+	                               Ggit.Tree tree,
+	                               string path,
+	                               Gee.Set<string> loaded,
+	                               ref Change[] changes) throws Error
+	{
+		var entries = new Gee.HashMap<string, Ggit.TreeEntry>();
+		var n = old.size();
+
+		for (uint i = 0; i < n; i++)
+		{
+			var entry = old.get(i);
+			entries[entry.get_name()] = entry;
+		}
+
+		n = tree.size();
+
+		for (uint i = 0; i < n; i++)
+		{
+			var entry = tree.get(i);
+			Ggit.TreeEntry? prev;
+
+			if (!entries.unset(entry.get_name(), out prev))
+			{
+				changes += new Change(ChangeType.ADDED, path, entry);
+				continue;
+			}
+
+			var mode = entry.get_file_mode();
+
+			if (mode == prev.get_file_mode() && entry.get_id().equal(prev.get_id()))
+			{
+				continue;
+			}
+
+			var isdir = mode == Ggit.FileMode.TREE;
+
+			if (isdir != (prev.get_file_mode() == Ggit.FileMode.TREE))
+			{
+				changes += new Change(ChangeType.REMOVED, path, prev);
+				changes += new Change(ChangeType.ADDED, path, entry);
+				continue;
+			}
+
+			changes += new Change(ChangeType.MODIFIED, path, entry);
+
+			var child = Path.build_filename(path, entry.get_name());
+
+			if (isdir && loaded.contains(child))
+			{
+				diff_trees(repository,
+				           repository.lookup<Ggit.Tree>(prev.get_id()),
+				           repository.lookup<Ggit.Tree>(entry.get_id()),
+				           child,
+				           loaded,
+				           ref changes);
+			}
+		}
+
+		foreach (var prev in entries.values)
+		{
+			changes += new Change(ChangeType.REMOVED, path, prev);
+		}
+	}
+
+	private async void update_delta()
+	{
+		var generation = ++d_generation;
+		var repository = this.repository;
+		var old = d_shown;
+		var tree = d_tree;
+
+		var loaded = new Gee.HashSet<string>();
+		loaded.add_all(d_loaded);
+
+		// Loads that are running now are dropped, they are started again
+		// on the new tree when the update is done
+		d_updating = true;
+
+		var changes = new Change[0];
+
+		try
+		{
+			yield Gitg.Async.thread(() => {
+				diff_trees(repository, old, tree, "", loaded, ref changes);
+			});
+		}
+		catch (Error e)
+		{
+			if (generation == d_generation)
+			{
+				update();
+			}
+
+			return;
+		}
+
+		if (generation != d_generation)
+		{
+			return;
+		}
+
+		// Children of each directory by name, collected when first needed
+		var rows = new Gee.HashMap<string, Gee.HashMap<string, Gtk.TreeIter?>>();
+		var added = new Gee.HashSet<string>();
+
+		foreach (var change in changes)
+		{
+			Gtk.TreeIter? parent;
+
+			if (!find_directory(change.parent, rows, out parent))
+			{
+				continue;
+			}
+
+			var children = children_by_name(change.parent, parent, rows);
+			var name = change.entry.name;
+
+			switch (change.kind)
+			{
+			case ChangeType.ADDED:
+				children[name] = insert_entry(parent, change.entry);
+				added.add(change.parent);
+				break;
+			case ChangeType.REMOVED:
+				Gtk.TreeIter? removed;
+
+				if (children.unset(name, out removed))
+				{
+					Gtk.TreeIter row = removed;
+
+					remove(ref row);
+					forget_loaded(Path.build_filename(change.parent, name));
+				}
+
+				break;
+			case ChangeType.MODIFIED:
+				Gtk.TreeIter? modified = children[name];
+
+				if (modified != null)
+				{
+					set(modified, 3, change.entry.id);
+				}
+
+				break;
+			}
+		}
+
+		d_shown = tree;
+		d_updating = false;
+
+		foreach (var path in added)
+		{
+			Gtk.TreeIter? iter;
+
+			if (find_directory(path, rows, out iter))
 			{
-				string path = root + entry.get_name() + Path.DIR_SEPARATOR_S;
+				loaded(iter != null ? get_path(iter) : null);
+			}
+		}
 
-				paths.insert(path, get_path(iter));
+		var loading = d_loading.to_array();
+		d_loading.clear();
+
+		foreach (var path in loading)
+		{
+			Gtk.TreeIter? iter;
+
+			if (find_directory(path, rows, out iter, false) && iter != null)
+			{
+				load(iter);
 			}
+		}
+	}
+
+	private Gee.HashMap<string, Gtk.TreeIter?> children_by_name(string path,
+	                                                             Gtk.TreeIter? parent,
+	                                                             Gee.HashMap<string, Gee.HashMap<string, Gtk.TreeIter?>> rows)
+	{
+		var ret = rows[path];
+
+		if (ret != null)
+		{
+			return ret;
+		}
+
+		ret = new Gee.HashMap<string, Gtk.TreeIter?>();
+		rows[path] = ret;
+
+		Gtk.TreeIter iter;
+
+		if (iter_children(out iter, parent))
+		{
+			do
+			{
+				if (!is_placeholder(iter))
+				{
+					ret[get_name(iter)] = iter;
+				}
+			} while (iter_next(ref iter));
+		}
+
+		return ret;
+	}
+
+	/*
+	 * Find the row of the directory at path, null for the root. Unless
+	 * any is set, the directory also needs to be loaded.
+	 */
+	private bool find_directory(string path,
+	                            Gee.HashMap<string, Gee.HashMap<string, Gtk.TreeIter?>> rows,
+	                            out Gtk.TreeIter? iter,
+	                            bool loaded = true)
+	{
+		iter = null;
 
+		if (path == "")
+		{
 			return true;
-		});
+		}
+
+		if (loaded && !d_loaded.contains(path))
+		{
+			return false;
+		}
+
+		var parent_path = Path.get_dirname(path);
+
+		if (parent_path == ".")
+		{
+			parent_path = "";
+		}
+
+		Gtk.TreeIter? parent;
+
+		if (!find_directory(parent_path, rows, out parent))
+		{
+			return false;
+		}
+
+		iter = children_by_name(parent_path, parent, rows)[Path.get_basename(path)];
+		return iter != null;
+	}
+
+	private void forget_loaded(string path)
+	{
+		d_loaded.remove(path);
+
+		var prefix = path + Path.DIR_SEPARATOR_S;
+		var remove = new string[0];
+
+		foreach (var p in d_loaded.tail_set(prefix))
+		{
+			if (!p.has_prefix(prefix))
+			{
+				break;
+			}
+
+			remove += p;
+		}
+
+		foreach (var p in remove)
+		{
+			d_loaded.remove(p);
+		}
 	}
 }
 
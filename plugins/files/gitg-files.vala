@@ -28,6 +28,8 @@ namespace GitgFiles
 		public GitgExt.History? history { owned get; construct set; }
 
 		private TreeStore d_model;
+		private Gtk.TreeView d_tree_view;
+		private Gee.HashSet<string> d_expanded;
 		private Gtk.Paned d_paned;
 		private Gtk.SourceView d_source;
 		private Settings? d_stylesettings;
@@ -41,9 +43,31 @@ namespace GitgFiles
 		private Gitg.WhenMapped d_whenMapped;
 		private Gitg.FontManager d_font_manager;
 
+		// Text is inserted in chunks of this size, images are scaled down
+		// to fit in MAX_IMAGE_SIZE pixels
+		private const int CHUNK_SIZE = 256 * 1024;
+		private const int MAX_IMAGE_SIZE = 4096;
+		private const uint DEFAULT_PREVIEW_LIMIT = 16;
+
+		private Cancellable? d_cancel_load;
+
+		private const int MAX_MATCHES = 100;
+
+		private PathIndex d_index;
+		private Gtk.SearchEntry d_search_entry;
+		private Gtk.ScrolledWindow d_scrolled_matches;
+		private Gtk.TreeView d_matches_view;
+		private Gtk.ListStore d_matches;
+		private uint d_search_generation;
+		private bool d_indexing;
+
 		construct
 		{
 			d_model = new TreeStore();
+			d_model.loaded.connect(expand_remembered);
+
+			d_expanded = new Gee.HashSet<string>();
+			d_index = new PathIndex();
 
 			history.selection_changed.connect(on_selection_changed);
 			Hdy.StyleManager.get_default ().notify["dark"].connect (() => {
@@ -85,7 +109,13 @@ namespace GitgFiles
 		{
 			history.foreach_selected((commit) => {
 				d_whenMapped.update(() => {
+					d_model.repository = application.repository;
 					d_model.tree = commit.get_tree();
+
+					if (d_search_entry != null && d_search_entry.text != "")
+					{
+						on_search_changed();
+					}
 				}, this);
 
 				return false;
@@ -121,10 +151,39 @@ namespace GitgFiles
 			                                  "scrolled_window_files",
 			                                  "tree_view_files",
 			                                  "source_view_file",
-			                                  "scrolled_window_file");
+			                                  "scrolled_window_file",
+			                                  "search_entry_files",
+			                                  "scrolled_window_matches",
+			                                  "tree_view_matches");
 
 			var tv = ret["tree_view_files"] as Gtk.TreeView;
 			tv.model = d_model;
+			d_tree_view = tv;
+
+			tv.test_expand_row.connect((iter, path) => {
+				d_model.load(iter);
+				return false;
+			});
+
+			tv.row_expanded.connect((iter, path) => {
+				d_expanded.add(d_model.get_full_path(iter));
+				expand_remembered(path);
+			});
+
+			tv.row_collapsed.connect((iter, path) => {
+				d_expanded.remove(d_model.get_full_path(iter));
+			});
+
+			// Rows are kept when another commit is selected, show the
+			// new content of the selected file when it changed
+			d_model.row_changed.connect((path, iter) => {
+				var selection = tv.get_selection();
+
+				if (selection.iter_is_selected(iter))
+				{
+					selection_changed(selection);
+				}
+			});
 
 			tv.get_selection().changed.connect(selection_changed);
 			tv.row_activated.connect(open_file_externally);
@@ -154,11 +213,60 @@ namespace GitgFiles
 					return false;
 			});
 			d_scrolled_files = ret["scrolled_window_files"] as Gtk.ScrolledWindow;
+
+			d_search_entry = ret["search_entry_files"] as Gtk.SearchEntry;
+			d_scrolled_matches = ret["scrolled_window_matches"] as Gtk.ScrolledWindow;
+			d_matches_view = ret["tree_view_matches"] as Gtk.TreeView;
+
+			d_matches = new Gtk.ListStore(1, typeof(string));
+			d_matches_view.model = d_matches;
+
+			d_search_entry.search_changed.connect(on_search_changed);
+
+			d_search_entry.stop_search.connect(() => {
+				d_search_entry.text = "";
+			});
+
+			d_search_entry.activate.connect(() => {
+				Gtk.TreeIter iter;
+
+				if (d_matches.get_iter_first(out iter))
+				{
+					reveal_match(iter);
+				}
+			});
+
+			d_search_entry.key_press_event.connect((event) => {
+				if (event.keyval == Gdk.Key.Down && d_scrolled_matches.visible)
+				{
+					d_matches_view.grab_focus();
+					return true;
+				}
+
+				return false;
+			});
+
+			d_matches_view.row_activated.connect((path, column) => {
+				Gtk.TreeIter iter;
+
+				if (d_matches.get_iter(out iter, path))
+				{
+					reveal_match(iter);
+				}
+			});
+
+			// Typing in the tree starts finding a file
+			tv.enable_search = false;
+
+			tv.key_press_event.connect((event) => {
+				return d_search_entry.handle_event(event);
+			});
 			d_source = ret["source_view_file"] as Gtk.SourceView;
 			d_paned = ret["paned_files"] as Gtk.Paned;
 			d_scrolled = ret["scrolled_window_file"] as Gtk.ScrolledWindow;
 
 			d_font_manager = new Gitg.FontManager(d_source, true);
+			((Gtk.SourceBuffer)d_source.get_buffer()).max_undo_levels = 0;
 
 			d_imagevp = new Gtk.Viewport(null, null);
 			d_image = new Gtk.Image();
@@ -194,6 +302,168 @@ namespace GitgFiles
 			}
 		}
 
+		private void on_search_changed()
+		{
+			d_search_generation++;
+
+			if (d_search_entry.text == "")
+			{
+				d_matches.clear();
+				d_scrolled_matches.hide();
+				d_scrolled_files.show();
+				return;
+			}
+
+			d_scrolled_files.hide();
+			d_scrolled_matches.show();
+
+			search.begin((obj, res) => {
+				search.end(res);
+			});
+		}
+
+		/*
+		 * Show the files matching the text of the search entry. The files of
+		 * the shown tree are indexed first when needed, searches started
+		 * meanwhile are taken over when the index is ready.
+		 */
+		private async void search()
+		{
+			if (d_indexing)
+			{
+				return;
+			}
+
+			// The shown tree can change while it is being indexed, index
+			// again until the index is of the shown tree
+			while (true)
+			{
+				var tree = d_model.tree;
+
+				if (tree == null)
+				{
+					return;
+				}
+
+				if (d_index.tree_id != null && d_index.tree_id.equal(tree.get_id()))
+				{
+					break;
+				}
+
+				d_indexing = true;
+
+				try
+				{
+					yield d_index.update(d_model.repository, tree);
+				}
+				catch (Error e)
+				{
+					stderr.printf("Failed to index files: %s\n", e.message);
+
+					d_indexing = false;
+					return;
+				}
+
+				d_indexing = false;
+			}
+
+			var generation = d_search_generation;
+			var text = d_search_entry.text;
+
+			if (text == "")
+			{
+				return;
+			}
+
+			var matches = yield d_index.search(text, MAX_MATCHES);
+
+			if (generation != d_search_generation)
+			{
+				return;
+			}
+
+			d_matches.clear();
+
+			foreach (var path in matches)
+			{
+				Gtk.TreeIter iter;
+				d_matches.insert_with_values(out iter, -1, 0, path);
+			}
+
+			Gtk.TreeIter first;
+
+			if (d_matches.get_iter_first(out first))
+			{
+				d_matches_view.get_selection().select_iter(first);
+			}
+		}
+
+		private void reveal_match(Gtk.TreeIter iter)
+		{
+			string path;
+
+			d_matches.get(iter, 0, out path);
+			d_search_entry.text = "";
+
+			d_model.reveal.begin(path, (obj, res) => {
+				var row = d_model.reveal.end(res);
+
+				if (row == null)
+				{
+					return;
+				}
+
+				var parent = row.copy();
+
+				if (parent.up() && parent.get_depth() > 0)
+				{
+					d_tree_view.expand_to_path(parent);
+				}
+
+				d_tree_view.set_cursor(row, null, false);
+				d_tree_view.scroll_to_cell(row, null, true, 0.5f, 0);
+				d_tree_view.grab_focus();
+			});
+		}
+
+		/*
+		 * Expand the loaded directories below path (or the root) which were
+		 * expanded before, also for the tree of a previously selected commit.
+		 */
+		private void expand_remembered(Gtk.TreePath? path)
+		{
+			Gtk.TreeIter? parent = null;
+			Gtk.TreeIter iter;
+
+			if (d_tree_view == null || d_expanded.size == 0)
+			{
+				return;
+			}
+
+			if (path != null)
+			{
+				if (!d_model.get_iter(out parent, path) || !d_tree_view.is_row_expanded(path))
+				{
+					return;
+				}
+			}
+
+			if (!d_model.iter_children(out iter, parent))
+			{
+				return;
+			}
+
+			do
+			{
+				if (!d_model.is_placeholder(iter) &&
+				    d_model.get_isdir(iter) &&
+				    d_expanded.contains(d_model.get_full_path(iter)))
+				{
+					d_tree_view.expand_row(d_model.get_path(iter), false);
+				}
+			} while (d_model.iter_next(ref iter));
+		}
+
 		private void set_viewer(Gtk.Widget? wid)
 		{
 			var child = d_scrolled.get_child();
@@ -217,62 +487,199 @@ namespace GitgFiles
 			Gtk.TreeModel mod;
 			Gtk.TreeIter iter;
 
+			if (d_cancel_load != null)
+			{
+				d_cancel_load.cancel();
+				d_cancel_load = null;
+			}
+
 			var buf = d_source.get_buffer() as Gtk.SourceBuffer;
 			buf.set_text("");
 
 			if (!selection.get_selected(out mod, out iter) || d_model.get_isdir(iter))
 			{
+				// Also the case for placeholders of unloaded directories
 				set_viewer(d_source);
 				return;
 			}
 
-			var id = d_model.get_id(iter);
-			Ggit.Blob blob;
+			d_cancel_load = new Cancellable();
+
+			load_blob.begin(d_model.get_id(iter), d_model.get_full_path(iter), d_cancel_load, (obj, res) => {
+				load_blob.end(res);
+			});
+		}
+
+		private size_t preview_limit()
+		{
+			var limit = DEFAULT_PREVIEW_LIMIT;
+
+			if (d_stylesettings != null)
+			{
+				limit = d_stylesettings.get_uint("file-preview-limit");
+			}
+
+			return limit == 0 ? size_t.MAX : (size_t)limit * 1024 * 1024;
+		}
+
+		/*
+		 * Split the first length bytes of content into valid UTF-8 strings
+		 * of about CHUNK_SIZE bytes, without splitting characters.
+		 */
+		private static string[] split_text(uint8[] content, int length)
+		{
+			var ret = new string[0];
+			uint8* data = content;
+			int offset = 0;
+
+			while (offset < length)
+			{
+				var end = int.min(offset + CHUNK_SIZE, length);
+
+				for (int i = 0; i < 3 && end < length && end > offset + 1 && (content[end] & 0xc0) == 0x80; i++)
+				{
+					end--;
+				}
+
+				unowned string text = (string)(data + offset);
+				ret += text.make_valid(end - offset);
+
+				offset = end;
+			}
 
+			return ret;
+		}
+
+		private static Gdk.Pixbuf? decode_image(uint8[] content, string mtype, Cancellable cancellable)
+		{
 			try
 			{
-				blob = application.repository.lookup<Ggit.Blob>(id);
+				var loader = new Gdk.PixbufLoader.with_mime_type(mtype);
+
+				loader.size_prepared.connect((width, height) => {
+					if (width > MAX_IMAGE_SIZE || height > MAX_IMAGE_SIZE)
+					{
+						var scale = double.min((double)MAX_IMAGE_SIZE / width,
+						                       (double)MAX_IMAGE_SIZE / height);
+
+						loader.set_size(int.max((int)(width * scale), 1),
+						                int.max((int)(height * scale), 1));
+					}
+				});
+
+				for (int offset = 0; offset < content.length; offset += CHUNK_SIZE)
+				{
+					if (cancellable.is_cancelled())
+					{
+						loader.close();
+						return null;
+					}
+
+					var end = int.min(offset + CHUNK_SIZE, content.length);
+
+					if (!loader.write(content[offset:end]))
+					{
+						break;
+					}
+				}
+
+				if (loader.close())
+				{
+					return loader.get_pixbuf();
+				}
+			} catch {}
+
+			return null;
+		}
+
+		/*
+		 * Show the blob with the given id in the viewer. The blob is read and
+		 * its content prepared on a thread. Text is limited to the preview
+		 * limit and inserted in chunks, so that the view stays responsive
+		 * and is highlighted while it fills up. Loading stops when
+		 * cancellable is cancelled, which happens when the selection changes.
+		 */
+		private async void load_blob(Ggit.OId id, string fname, Cancellable cancellable)
+		{
+			var repository = application.repository;
+			var limit = preview_limit();
+
+			string? ct = null;
+			string[]? chunks = null;
+			Gdk.Pixbuf? pixbuf = null;
+			size_t size = 0;
+
+			yield Gitg.Async.thread_try(() => {
+				var blob = repository.lookup<Ggit.Blob>(id);
+				unowned uint8[] content = blob.get_raw_content();
+
+				size = content.length;
+				ct = ContentType.guess(fname, content[0:int.min(content.length, 4096)], null);
+
+				if (ContentType.is_a(ct, "image/*"))
+				{
+					pixbuf = decode_image(content, ContentType.get_mime_type(ct), cancellable);
+				}
+				else if (ContentType.is_a(ct, "text/plain"))
+				{
+					chunks = split_text(content, (int)size_t.min(size, limit));
+				}
+			});
+
+			if (cancellable.is_cancelled())
+			{
+				return;
 			}
-			catch
+
+			if (pixbuf != null)
 			{
-				set_viewer(d_source);
+				d_image.pixbuf = pixbuf;
+				set_viewer(d_imagevp);
 				return;
 			}
 
-			var fname = d_model.get_full_path(iter);
-			unowned uint8[] content = blob.get_raw_content();
+			if (chunks == null)
+			{
+				set_viewer(ct != null && ContentType.is_a(ct, "image/*") ? d_imagevp : null);
+				d_image.pixbuf = null;
+				return;
+			}
+
+			var manager = Gtk.SourceLanguageManager.get_default();
+			var buf = d_source.get_buffer() as Gtk.SourceBuffer;
 
-			var ct = ContentType.guess(fname, content, null);
-			Gtk.Widget? wid = null;
+			buf.language = manager.guess_language(fname, ct);
+			set_viewer(d_source);
 
-			if (ContentType.is_a(ct, "image/*"))
+			for (int i = 0; i < chunks.length; i++)
 			{
-				wid = d_imagevp;
-				var mtype = ContentType.get_mime_type(ct);
+				Gtk.TextIter end;
 
-				d_image.pixbuf = null;
+				buf.get_end_iter(out end);
+				buf.insert(ref end, chunks[i], -1);
 
-				try
+				if (i + 1 < chunks.length)
 				{
-					var loader = new Gdk.PixbufLoader.with_mime_type(mtype);
+					Idle.add(load_blob.callback);
+					yield;
 
-					if (loader.write(content) && loader.close())
+					if (cancellable.is_cancelled())
 					{
-						d_image.pixbuf = loader.get_pixbuf();
+						return;
 					}
-				} catch {}
+				}
 			}
-			else if (ContentType.is_a(ct, "text/plain"))
-			{
-				var manager = Gtk.SourceLanguageManager.get_default();
 
-				buf.set_text((string)content);
-				buf.language = manager.guess_language(fname, ct);
+			if (size > limit)
+			{
+				Gtk.TextIter end;
 
-				wid = d_source;
+				buf.get_end_iter(out end);
+				buf.insert(ref end,
+				           "\n\n" + _("Only the first %s of %s are shown").printf(format_size(limit),
+				                                                               format_size(size)),
+				           -1);
 			}
-
-			set_viewer(wid);
 		}
 
 		private void open_file_externally(Gtk.TreePath path, Gtk.TreeViewColumn? column)
@@ -26,7 +26,8 @@ class LibGitg.Test.Main
 		m.add(new Stage(),
 		      new Date(),
 		      new Commit(),
-		      new Encoding());
+		      new Encoding(),
+		      new AvatarCache());
 
 		m.run();
 	}
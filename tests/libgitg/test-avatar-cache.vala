@@ -0,0 +1,177 @@
+/*
+ * This file is part of gitg
+ *
+ * Copyright (C) 2026 - Alberto Fanjul
+ *
+ * gitg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gitg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gitg. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+using Gitg.Test.Assert;
+
+class LibGitg.Test.AvatarCache : Gitg.Test.Test
+{
+	private File d_dir;
+
+	/**
+	 * Avatars are served from a local directory standing in for gravatar.
+	 */
+	protected override void set_up()
+	{
+		try
+		{
+			d_dir = File.new_for_path(DirUtils.make_tmp("gitg-test-avatars-XXXXXX"));
+			d_dir.get_child("server").make_directory();
+		}
+		catch (Error e)
+		{
+			assert_no_error(e);
+		}
+	}
+
+	protected override void tear_down()
+	{
+		remove_recursively(d_dir);
+	}
+
+	private void remove_recursively(File f)
+	{
+		try
+		{
+			var info = f.query_info("standard::*", FileQueryInfoFlags.NOFOLLOW_SYMLINKS);
+
+			if (info.get_file_type() == FileType.DIRECTORY)
+			{
+				var e = f.enumerate_children("standard::*", FileQueryInfoFlags.NOFOLLOW_SYMLINKS);
+
+				while ((info = e.next_file()) != null)
+				{
+					remove_recursively(f.get_child(info.get_name()));
+				}
+			}
+
+			f.delete();
+		}
+		catch (Error e)
+		{
+			stderr.printf("Failed to remove %s: %s\n", f.get_path(), e.message);
+		}
+	}
+
+	private File server_file(string email)
+	{
+		var id = Checksum.compute_for_string(ChecksumType.MD5, email.down());
+		return d_dir.get_child("server").get_child(@"$id.png");
+	}
+
+	private void serve(string email)
+	{
+		var pixbuf = new Gdk.Pixbuf(Gdk.Colorspace.RGB, false, 8, 8, 8);
+		pixbuf.fill(0xff0000ff);
+
+		try
+		{
+			uint8[] buffer;
+
+			pixbuf.save_to_buffer(out buffer, "png");
+			server_file(email).replace_contents(buffer, null, false, FileCreateFlags.NONE, null);
+		}
+		catch (Error e)
+		{
+			assert_no_error(e);
+		}
+	}
+
+	private Gitg.AvatarCache create_cache()
+	{
+		return new Gitg.AvatarCache.with_locations(d_dir.get_child("server").get_uri() + "/{id}.png",
+		                                           d_dir.get_child("cache"));
+	}
+
+	private Gdk.Pixbuf? load(Gitg.AvatarCache cache, string email)
+	{
+		var loop = new MainLoop();
+		Gdk.Pixbuf? ret = null;
+
+		cache.load.begin(email, 50, null, (obj, res) => {
+			ret = cache.load.end(res);
+			loop.quit();
+		});
+
+		loop.run();
+		return ret;
+	}
+
+	protected virtual signal void test_load_from_disk()
+	{
+		serve("a@example.com");
+
+		var pixbuf = load(create_cache(), "a@example.com");
+
+		assert(pixbuf != null);
+		assert_inteq(pixbuf.width, 50);
+
+		// Served from the disk cache by a new cache
+		try
+		{
+			server_file("a@example.com").delete();
+		}
+		catch (Error e)
+		{
+			assert_no_error(e);
+		}
+
+		assert(load(create_cache(), "a@example.com") != null);
+	}
+
+	protected virtual signal void test_missing_cached()
+	{
+		assert(load(create_cache(), "b@example.com") == null);
+
+		// Not looked up again until it expires
+		serve("b@example.com");
+		assert(load(create_cache(), "b@example.com") == null);
+	}
+
+	protected virtual signal void test_coalesce()
+	{
+		serve("c@example.com");
+
+		var cache = create_cache();
+		var loop = new MainLoop();
+		var pixbufs = new Gdk.Pixbuf?[2];
+		var done = 0;
+
+		for (var i = 0; i < 2; i++)
+		{
+			var n = i;
+
+			cache.load.begin("c@example.com", 50, null, (obj, res) => {
+				pixbufs[n] = cache.load.end(res);
+
+				if (++done == 2)
+				{
+					loop.quit();
+				}
+			});
+		}
+
+		loop.run();
+
+		// Both requests were served by the same load
+		assert(pixbufs[0] != null);
+		assert(pixbufs[0] == pixbufs[1]);
+	}
+}
+
+// ex:set ts=4 noet
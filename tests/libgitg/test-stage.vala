@@ -197,6 +197,220 @@ class LibGitg.Test.Stage : Gitg.Test.Repository
 
 		loop.run();
 	}
+
+	/**
+	 * test staging and deleting several files in the index at once.
+	 */
+	protected virtual signal void test_stage_paths()
+	{
+		var stage = d_repository.stage;
+
+		var loop = new MainLoop();
+
+		stage.stage_paths.begin(new string[] {"a", "b"}, new string[] {"c"}, null, null, (obj, res) => {
+			try
+			{
+				stage.stage_paths.end(res);
+			} catch (Error e) { Assert.assert_no_error(e); }
+
+			var m = new Gee.HashMap<string, Ggit.StatusFlags>();
+
+			m["a"] = Ggit.StatusFlags.INDEX_MODIFIED;
+			m["b"] = Ggit.StatusFlags.INDEX_MODIFIED;
+			m["c"] = Ggit.StatusFlags.INDEX_DELETED;
+
+			check_file_status(loop, m);
+		});
+
+		loop.run();
+	}
+
+	/**
+	 * test that a cancelled batch leaves the index untouched.
+	 */
+	protected virtual signal void test_stage_paths_cancelled()
+	{
+		var stage = d_repository.stage;
+
+		var loop = new MainLoop();
+		var cancellable = new Cancellable();
+
+		cancellable.cancel();
+
+		stage.stage_paths.begin(new string[] {"a"}, new string[] {"c"}, cancellable, null, (obj, res) => {
+			try
+			{
+				stage.stage_paths.end(res);
+				assert_not_reached();
+			} catch (Error e) { assert(e is IOError.CANCELLED); }
+
+			var m = new Gee.HashMap<string, Ggit.StatusFlags>();
+
+			m["a"] = Ggit.StatusFlags.WORKING_TREE_MODIFIED;
+			m["b"] = Ggit.StatusFlags.WORKING_TREE_MODIFIED | Ggit.StatusFlags.INDEX_MODIFIED;
+			m["c"] = Ggit.StatusFlags.WORKING_TREE_DELETED;
+
+			check_file_status(loop, m);
+		});
+
+		loop.run();
+	}
+
+	/**
+	 * test staging several patches of the same file at once.
+	 */
+	protected virtual signal void test_stage_patches()
+	{
+		var stage = d_repository.stage;
+
+		var loop = new MainLoop();
+
+		// "hello world\n" in the index, "changed world\n" in the working
+		// directory, replace "hello " by "changed " in two patch sets
+		var add = new Gitg.PatchSet();
+		add.filename = "a";
+		add.patches = new Gitg.PatchSet.Patch[] {
+			Gitg.PatchSet.Patch() { type = Gitg.PatchSet.Type.ADD, old_offset = 6, new_offset = 0, length = 8 }
+		};
+
+		var remove = new Gitg.PatchSet();
+		remove.filename = "a";
+		remove.patches = new Gitg.PatchSet.Patch[] {
+			Gitg.PatchSet.Patch() { type = Gitg.PatchSet.Type.REMOVE, old_offset = 0, new_offset = 0, length = 6 }
+		};
+
+		stage.stage_patches.begin(new Gitg.PatchSet[] {add, remove}, (obj, res) => {
+			try
+			{
+				stage.stage_patches.end(res);
+			} catch (Error e) { Assert.assert_no_error(e); }
+
+			var m = new Gee.HashMap<string, Ggit.StatusFlags>();
+
+			m["a"] = Ggit.StatusFlags.INDEX_MODIFIED;
+			m["b"] = Ggit.StatusFlags.WORKING_TREE_MODIFIED | Ggit.StatusFlags.INDEX_MODIFIED;
+			m["c"] = Ggit.StatusFlags.WORKING_TREE_DELETED;
+
+			check_file_status(loop, m);
+		});
+
+		loop.run();
+	}
+
+	private void add_submodule(string path, string? ignore = null)
+	{
+		try
+		{
+			var wd = d_repository.get_workdir();
+			var dir = wd.get_child(path);
+			var sub = Ggit.Repository.init_repository(dir, false);
+
+			FileUtils.set_contents(dir.get_child("file").get_path(), "submodule file\n");
+
+			var index = sub.get_index();
+			index.add_path("file");
+			index.write();
+
+			var tree = sub.lookup<Ggit.Tree>(index.write_tree());
+			var sig = get_verified_committer();
+
+			sub.create_commit("HEAD", sig, sig, null, "submodule", tree, new Ggit.Commit[] {});
+
+			var gitmodules = @"[submodule \"$path\"]\n\tpath = $path\n\turl = ./$path\n";
+
+			if (ignore != null)
+			{
+				gitmodules += @"\tignore = $ignore\n";
+			}
+
+			FileUtils.set_contents(wd.get_child(".gitmodules").get_path(), gitmodules);
+
+			var parent_index = d_repository.get_index();
+			parent_index.add_path(".gitmodules");
+			parent_index.add_path(path);
+			parent_index.write();
+		}
+		catch (Error e)
+		{
+			Assert.assert_no_error(e);
+		}
+	}
+
+	private Ggit.SubmoduleStatus submodule_flags(string path)
+	{
+		var loop = new MainLoop();
+		var e = d_repository.stage.file_status(null);
+		Ggit.SubmoduleStatus ret = 0;
+
+		e.next_items.begin(-1, (obj, res) => {
+			foreach (var item in e.next_items.end(res))
+			{
+				var sub = item as Gitg.StageStatusSubmodule;
+
+				if (sub != null && sub.path == path)
+				{
+					ret = sub.flags;
+				}
+			}
+
+			loop.quit();
+		});
+
+		loop.run();
+		return ret;
+	}
+
+	private void edit_submodule_file(string path)
+	{
+		try
+		{
+			var file = d_repository.get_workdir().get_child(path).get_child("file");
+			FileUtils.set_contents(file.get_path(), "changed submodule file\n");
+		}
+		catch (Error e)
+		{
+			Assert.assert_no_error(e);
+		}
+
+		// Done by the working directory monitor of the commit view
+		d_repository.stage.invalidate_submodule_status(path);
+	}
+
+	/**
+	 * test that editing a file in a submodule is noticed after the status
+	 * of the submodule was cached.
+	 */
+	protected virtual signal void test_submodule_workdir_status()
+	{
+		add_submodule("sub");
+
+		var flags = submodule_flags("sub");
+
+		assert((flags & Ggit.SubmoduleStatus.IN_WD) != 0);
+		assert((flags & Ggit.SubmoduleStatus.WD_WD_MODIFIED) == 0);
+
+		edit_submodule_file("sub");
+
+		flags = submodule_flags("sub");
+		assert((flags & Ggit.SubmoduleStatus.WD_WD_MODIFIED) != 0);
+	}
+
+	/**
+	 * test that submodules configured to ignore their dirty working
+	 * directory are not shown as modified.
+	 */
+	protected virtual signal void test_submodule_ignore_dirty()
+	{
+		add_submodule("sub", "dirty");
+
+		var flags = submodule_flags("sub");
+		assert((flags & Ggit.SubmoduleStatus.IN_WD) != 0);
+
+		edit_submodule_file("sub");
+
+		flags = submodule_flags("sub");
+		assert((flags & Ggit.SubmoduleStatus.WD_WD_MODIFIED) == 0);
+	}
 }
 
 // ex:set ts=4 noet